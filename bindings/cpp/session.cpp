@@ -18,6 +18,7 @@
 #include "callback_p.h"
 #include "functional_p.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <sstream>
 #include <functional>
@@ -1792,6 +1793,11 @@ int session::state_num(void)
 	return dnet_state_num(m_data->session_ptr);
 }
 
+int session::state_lanes(const address &addr)
+{
+	return dnet_state_lanes(m_data->session_ptr, &addr.to_raw());
+}
+
 async_generic_result session::request_cmd(const transport_control &ctl)
 {
 	return send_to_each_backend(*this, ctl);
@@ -2777,9 +2783,105 @@ async_read_result session::bulk_read(const std::vector<key> &keys)
 	return bulk_read(ios);
 }
 
+/*
+ * Records of BULK_WRITE command which are sent to the same backend.
+ * Batch is sent once it has DNET_BULK_WRITE_BATCH_SIZE bytes or DNET_BULK_WRITE_BATCH_RECORDS records,
+ * larger records are sent alone.
+ */
+#define DNET_BULK_WRITE_BATCH_SIZE	(4 * 1024 * 1024)
+#define DNET_BULK_WRITE_BATCH_RECORDS	1024
+
+struct bulk_write_batch
+{
+	net_state_id state;
+	dnet_id id;
+	uint64_t count;
+	std::vector<char> records;
+};
+
+/*
+ * Completes BULK_WRITE batch. Servers which do not know this command reply -ENOTSUP,
+ * records of the batch are written by separate WRITE commands then.
+ */
+struct bulk_write_callback
+{
+	session sess;
+	std::shared_ptr<bulk_write_batch> batch;
+	async_result_handler<callback_result_entry> handler;
+
+	void operator() (const std::vector<callback_result_entry> &result, const error_info &error)
+	{
+		bool not_supported = (error.code() == -ENOTSUP);
+
+		for (auto it = result.begin(); it != result.end(); ++it) {
+			if (it->status() == -ENOTSUP)
+				not_supported = true;
+		}
+
+		if (!not_supported) {
+			for (auto it = result.begin(); it != result.end(); ++it)
+				handler.process(*it);
+			handler.complete(error);
+			return;
+		}
+
+		std::vector<async_generic_result> results;
+		results.reserve(batch->count);
+
+		for (size_t offset = 0; offset < batch->records.size();) {
+			dnet_io_control control;
+			memset(&control, 0, sizeof(control));
+
+			memcpy(&control.io, batch->records.data() + offset, sizeof(dnet_io_attr));
+			dnet_convert_io_attr(&control.io);
+
+			control.fd = -1;
+			control.cmd = DNET_CMD_WRITE;
+			control.cflags = sess.get_cflags() | DNET_FLAGS_NEED_ACK;
+			control.data = batch->records.data() + offset + sizeof(dnet_io_attr);
+			dnet_setup_id(&control.id, batch->id.group_id, control.io.id);
+
+			offset += sizeof(dnet_io_attr) + control.io.size;
+
+			results.emplace_back(send_to_groups(sess, control));
+		}
+
+		aggregated(sess, results.begin(), results.end()).connect(handler);
+	}
+};
+
+static async_generic_result send_bulk_write_batch(session &sess, const std::shared_ptr<bulk_write_batch> &batch)
+{
+	dnet_io_control control;
+	memset(&control, 0, sizeof(control));
+
+	control.fd = -1;
+	control.cmd = DNET_CMD_BULK_WRITE;
+	control.cflags = sess.get_cflags() | DNET_FLAGS_NEED_ACK;
+	control.id = batch->id;
+
+	control.io.flags = sess.get_ioflags();
+	control.io.num = batch->count;
+	control.io.size = batch->records.size();
+	memcpy(control.io.id, batch->id.id, DNET_ID_SIZE);
+	memcpy(control.io.parent, batch->id.id, DNET_ID_SIZE);
+
+	/* records are copied into the send queue before send_to_single_state() returns */
+	control.data = batch->records.data();
+
+	session fallback_sess = sess.clean_clone();
+	fallback_sess.set_groups(std::vector<int>(1, batch->id.group_id));
+
+	async_generic_result result(sess);
+	bulk_write_callback callback = { fallback_sess, batch, result };
+	callback.handler.set_total(1);
+	send_to_single_state(sess, control).connect(callback);
+	return result;
+}
+
 async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, const std::vector<argument_data> &data)
 {
-	if (ios.size() != data.size()) {
+	if (ios.size() != data.size() || ios.empty()) {
 		error_info error = create_error(-EINVAL, "BULK_WRITE: ios doesn't meet data: io.size: %zd, data.size: %zd",
 			ios.size(), data.size());
 		if (get_exceptions_policy() & throw_at_start) {
@@ -2792,22 +2894,76 @@ async_write_result session::bulk_write(const std::vector<dnet_io_attr> &ios, con
 		}
 	}
 
-	std::vector<async_write_result> results;
+	dnet_raw_id id;
+	memcpy(id.id, ios[0].id, DNET_ID_SIZE);
 
-	{
-		session_scope scope(*this);
+	DNET_SESSION_GET_GROUPS(async_write_result);
 
-		// Ensure checkers and filters will work only for aggregated request
-		set_filter(filters::all_with_ack);
-		set_checker(checkers::no_check);
-		set_exceptions_policy(no_exceptions);
+	dnet_node *node = get_native_node();
+
+	dnet_time timestamp;
+	get_timestamp(&timestamp);
+	if (dnet_time_is_empty(&timestamp))
+		dnet_current_time(&timestamp);
+
+	std::vector<async_generic_result> results;
+	session sess = clean_clone();
+
+	for (auto group = groups.begin(); group != groups.end(); ++group) {
+		std::vector<std::shared_ptr<bulk_write_batch>> batches;
+
+		for (size_t i = 0; i < ios.size(); ++i) {
+			dnet_id key_id;
+			dnet_setup_id(&key_id, *group, ios[i].id);
+
+			net_state_id state(node, &key_id);
+			if (!state) {
+				error_info error = create_error(-ENXIO, key_id, "BULK_WRITE: could not find network state");
+				async_generic_result result(sess);
+				async_result_handler<callback_result_entry> handler(result);
+				handler.complete(error);
+				results.emplace_back(std::move(result));
+				continue;
+			}
+
+			auto batch = std::find_if(batches.begin(), batches.end(), [&state] (const std::shared_ptr<bulk_write_batch> &b) {
+				return b->state == state;
+			});
+			if (batch != batches.end() && (*batch)->count &&
+					((*batch)->count >= DNET_BULK_WRITE_BATCH_RECORDS ||
+					 (*batch)->records.size() + sizeof(dnet_io_attr) + data[i].size() > DNET_BULK_WRITE_BATCH_SIZE)) {
+				results.emplace_back(send_bulk_write_batch(sess, *batch));
+				batches.erase(batch);
+				batch = batches.end();
+			}
+			if (batch == batches.end()) {
+				batches.emplace_back(std::make_shared<bulk_write_batch>());
+				batch = batches.end() - 1;
+				(*batch)->state = std::move(state);
+				(*batch)->id = key_id;
+				(*batch)->count = 0;
+			}
 
-		for(size_t i = 0; i < ios.size(); ++i) {
-			results.emplace_back(std::move(write_data(ios[i], data[i])));
+			dnet_io_attr io = ios[i];
+			io.size = data[i].size();
+			io.flags |= get_ioflags();
+			io.user_flags |= get_user_flags();
+			if (dnet_time_is_empty(&io.timestamp))
+				io.timestamp = timestamp;
+			dnet_convert_io_attr(&io);
+
+			const char *record = reinterpret_cast<const char *>(&io);
+			const char *record_data = reinterpret_cast<const char *>(data[i].data());
+			(*batch)->records.insert((*batch)->records.end(), record, record + sizeof(io));
+			(*batch)->records.insert((*batch)->records.end(), record_data, record_data + data[i].size());
+			++(*batch)->count;
 		}
+
+		for (auto batch = batches.begin(); batch != batches.end(); ++batch)
+			results.emplace_back(send_bulk_write_batch(sess, *batch));
 	}
 
-	return aggregated(*this, results.begin(), results.end());
+	return async_result_cast<write_result_entry>(*this, aggregated(sess, results.begin(), results.end()));
 }
 
 async_remove_result session::bulk_remove(const std::vector<key> &keys)
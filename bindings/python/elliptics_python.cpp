@@ -103,6 +103,7 @@ enum elliptics_config_flags {
 	config_flags_mix_states			= DNET_CFG_MIX_STATES,
 	config_flags_no_csum			= DNET_CFG_NO_CSUM,
 	config_flags_randomize_states		= DNET_CFG_RANDOMIZE_STATES,
+	config_flags_sharded_request_queue	= DNET_CFG_SHARDED_REQUEST_QUEUE,
 };
 
 enum elliptics_node_status_flags {
@@ -118,6 +119,7 @@ dnet_config* dnet_config_init() {
 	config->check_timeout = 20;
 	config->io_thread_num = 1;
 	config->net_thread_num = 1;
+	config->net_lanes = 1;
 	config->nonblocking_io_thread_num = 1;
 	return config;
 }
@@ -343,6 +345,8 @@ BOOST_PYTHON_MODULE(core)
 		               "Number of IO threads in processing pool dedicated to nonblocking operations")
 		.def_readwrite("net_thread_num", &dnet_config::net_thread_num,
 		               "Number of threads in network processing pool")
+		.def_readwrite("net_lanes", &dnet_config::net_lanes,
+		               "Number of TCP connections to every remote node, bulk requests are sent over extra ones")
 		.def_readwrite("flags", &dnet_config::flags,
 		               "Bit set of elliptics.config_flags")
 		.def_readwrite("client_prio", &dnet_config::client_prio,
@@ -507,13 +511,15 @@ BOOST_PYTHON_MODULE(core)
 	    "no_route_list\n    Do not request route table from remote nodes\n"
 	    "mix_states\n    Mix states according to their weights before reading data\n"
 	    "no_csum\n    Globally disable checksum verification and update\n"
-	    "randomize_states\n    Randomize states for read requests\n\n"
+	    "randomize_states\n    Randomize states for read requests\n"
+	    "sharded_request_queue\n    Use sharded request queue in IO pools\n\n"
 	    "config.flags = elliptics.config_flags.mix_stats | elliptics.config_flags.randomize_states\n"
 	    )
 		.value("no_route_list", config_flags_no_route_list)
 		.value("mix_states", config_flags_mix_states)
 		.value("no_csum", config_flags_no_csum)
 		.value("randomize_states", config_flags_randomize_states)
+		.value("sharded_request_queue", config_flags_sharded_request_queue)
 	;
 
 	bp::enum_<elliptics_node_status_flags>("status_flags",
@@ -0,0 +1,92 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "admission.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace ioremap { namespace cache {
+
+tinylfu_admission_t::tinylfu_admission_t(size_t width) : m_width(1), m_additions(0) {
+	while (m_width < width)
+		m_width <<= 1;
+
+	m_sample_size = 10 * m_width;
+	m_counters.reset(new std::atomic<uint8_t>[depth * m_width]);
+
+	for (size_t i = 0; i < depth * m_width; ++i) {
+		m_counters[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+const char *tinylfu_admission_t::name() const {
+	return "tinylfu";
+}
+
+void tinylfu_admission_t::record(const unsigned char *id) {
+	for (size_t row = 0; row < depth; ++row) {
+		std::atomic<uint8_t> &counter = m_counters[index(id, row)];
+		uint8_t value = counter.load(std::memory_order_relaxed);
+
+		while (value < max_frequency &&
+				!counter.compare_exchange_weak(value, value + 1, std::memory_order_relaxed)) {
+		}
+	}
+
+	if (m_additions.fetch_add(1, std::memory_order_relaxed) + 1 == m_sample_size)
+		age();
+}
+
+bool tinylfu_admission_t::admit(const unsigned char *candidate, const unsigned char *victim) {
+	return frequency(candidate) > frequency(victim);
+}
+
+size_t tinylfu_admission_t::frequency(const unsigned char *id) const {
+	size_t result = max_frequency;
+
+	for (size_t row = 0; row < depth; ++row) {
+		result = std::min<size_t>(result, m_counters[index(id, row)].load(std::memory_order_relaxed));
+	}
+
+	return result;
+}
+
+/*
+ * IDs are already uniformly distributed, so every row of the sketch is indexed by its own word of ID.
+ * Words used by cache_manager and shard hash index (the first, the second and the last ones) are skipped.
+ */
+size_t tinylfu_admission_t::index(const unsigned char *id, size_t row) const {
+	uint64_t word;
+	memcpy(&word, id + (row + 2) * sizeof(uint64_t), sizeof(word));
+	return row * m_width + (word & (m_width - 1));
+}
+
+void tinylfu_admission_t::age() {
+	for (size_t i = 0; i < depth * m_width; ++i) {
+		m_counters[i].store(m_counters[i].load(std::memory_order_relaxed) >> 1, std::memory_order_relaxed);
+	}
+
+	m_additions.store(m_sample_size / 2, std::memory_order_relaxed);
+}
+
+std::unique_ptr<admission_policy_t> create_admission_policy(const std::string &name, size_t width) {
+	if (name == "none")
+		return std::unique_ptr<admission_policy_t>();
+	if (name == "tinylfu")
+		return std::unique_ptr<admission_policy_t>(new tinylfu_admission_t(width));
+
+	throw std::invalid_argument("unknown cache admission policy: " + name + ", supported: none, tinylfu");
+}
+
+}} /* namespace ioremap::cache */
@@ -0,0 +1,89 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <memory>
+#include <string>
+#include <cstdint>
+#if __GNUC__ == 4 && __GNUC_MINOR__ < 5
+#  include <cstdatomic>
+#else
+#  include <atomic>
+#endif
+
+namespace ioremap { namespace cache {
+
+/*
+ * Admission policy decides whether new object may enter the cache
+ * when it would push out another object.
+ * Methods may be called concurrently: record() is called by cache hits under shared lock.
+ */
+class admission_policy_t {
+public:
+	virtual ~admission_policy_t() {}
+
+	virtual const char *name() const = 0;
+
+	// records access to object with @id
+	virtual void record(const unsigned char *id) = 0;
+
+	// returns true if object with @candidate id is worth keeping instead of @victim
+	virtual bool admit(const unsigned char *candidate, const unsigned char *victim) = 0;
+};
+
+/*
+ * TinyLFU admission: access frequencies are estimated by count-min sketch of 4-bit counters,
+ * candidate is admitted only if it is used more often than the object it would evict.
+ * All counters are halved after every @sample_size recorded accesses,
+ * so frequencies reflect recent history and objects which were hot long ago fade out.
+ */
+class tinylfu_admission_t : public admission_policy_t {
+public:
+	// @width is number of counters in each row of the sketch, it is rounded up to the power of 2
+	tinylfu_admission_t(size_t width);
+
+	virtual const char *name() const;
+	virtual void record(const unsigned char *id);
+	virtual bool admit(const unsigned char *candidate, const unsigned char *victim);
+
+	size_t frequency(const unsigned char *id) const;
+
+private:
+	enum {
+		depth = 4,
+		max_frequency = 15
+	};
+
+	size_t index(const unsigned char *id, size_t row) const;
+
+	void age();
+
+	size_t m_width;
+	size_t m_sample_size;
+	std::unique_ptr<std::atomic<uint8_t>[]> m_counters;
+	std::atomic<size_t> m_additions;
+};
+
+/*
+ * Creates admission policy by its name from config:
+ *  "none" - every object is admitted, returns empty pointer
+ *  "tinylfu" - @tinylfu_admission_t with sketch of @width counters per row
+ *
+ * Throws std::invalid_argument if @name is unknown.
+ */
+std::unique_ptr<admission_policy_t> create_admission_policy(const std::string &name, size_t width);
+
+}}
+
+#endif // ADMISSION_HPP
@@ -17,9 +17,12 @@
 
 #include "cache.hpp"
 #include "slru_cache.hpp"
+#include "write_behind.hpp"
 
 #include <fstream>
 
+#include <sys/stat.h>
+
 #include "boost/lexical_cast.hpp"
 
 #include "monitor/monitor.h"
@@ -34,6 +37,22 @@
 
 namespace ioremap { namespace cache {
 
+/*
+ * Shard is only a lock, an index and a set of pages, so there may be hundreds of them.
+ * Shard is picked by mask of the key hash, so configured number of shards
+ * is rounded up to a power of two and limited by DNET_CACHE_SHARDS_MAX.
+ */
+#define DNET_CACHE_SHARDS_MAX 1024
+
+static size_t cache_shards_number(size_t shards) {
+	shards = std::min<size_t>(shards, DNET_CACHE_SHARDS_MAX);
+
+	size_t number = 1;
+	while (number < shards)
+		number <<= 1;
+	return number;
+}
+
 std::unique_ptr<cache_config> cache_config::parse(const elliptics::config::config &cache)
 {
 	auto size = cache.at("size");
@@ -44,13 +63,54 @@ std::unique_ptr<cache_config> cache_config::parse(const elliptics::config::confi
 	cache_config config;
 	config.size = size.as<size_t>();
 	config.count = cache.at<size_t>("shards", DNET_DEFAULT_CACHES_NUMBER);
+	if (config.count == 0) {
+		throw elliptics::config::config_error(cache.path() + ".shards must be non-zero");
+	}
 	config.sync_timeout = cache.at<unsigned>("sync_timeout", DNET_DEFAULT_CACHE_SYNC_TIMEOUT_SEC);
+	config.sync_threads = cache.at<unsigned>("sync_threads", DNET_DEFAULT_CACHE_SYNC_THREADS);
+	config.sync_batch = cache.at<unsigned>("sync_batch", DNET_DEFAULT_CACHE_SYNC_BATCH);
+	config.sync_rate = cache.at<unsigned>("sync_rate", 0);
+	if (config.sync_threads == 0 || config.sync_batch == 0) {
+		throw elliptics::config::config_error(cache.path() + ".sync_threads and sync_batch must be non-zero");
+	}
 	config.pages_proportions = cache.at("pages_proportions", std::vector<size_t>(DNET_DEFAULT_CACHE_PAGES_NUMBER, 1));
+	config.slab_allocator = cache.at<bool>("slab_allocator", false);
+
+	config.snapshot = cache.at<bool>("snapshot", false);
+	config.snapshot_interval = cache.at<unsigned>("snapshot_interval", 0);
+	config.admission = cache.at<std::string>("admission", "none");
+	try {
+		create_admission_policy(config.admission, 1);
+	} catch (std::invalid_argument &e) {
+		throw elliptics::config::config_error(cache.path() + ".admission: " + e.what());
+	}
+	config.compression = cache.at<std::string>("compression", "none");
+	config.compressed_pages = cache.at<unsigned>("compressed_pages", 1);
+	try {
+		create_compression_codec(config.compression);
+	} catch (std::invalid_argument &e) {
+		throw elliptics::config::config_error(cache.path() + ".compression: " + e.what());
+	}
+	if (config.compression != "none" && config.compressed_pages >= config.pages_proportions.size()) {
+		throw elliptics::config::config_error(cache.path() + ".compressed_pages must be less than number of pages_proportions");
+	}
 	return blackhole::utils::make_unique<cache_config>(config);
 }
 
-cache_manager::cache_manager(dnet_backend_io *backend, dnet_node *n, const cache_config &config) : m_node(n) {
-	size_t caches_number = config.count;
+cache_manager::cache_manager(dnet_backend_io *backend, dnet_node *n, const cache_config &config) :
+	m_backend(backend),
+	m_node(n),
+	m_slab(config.slab_allocator ? std::make_shared<slab_allocator_t>() : std::shared_ptr<slab_allocator_t>()),
+	m_snapshot_path(config.snapshot_path),
+	m_snapshot_interval(config.snapshot_interval) {
+	size_t caches_number = cache_shards_number(config.count);
+	if (caches_number != config.count) {
+		dnet_log(m_node, DNET_LOG_NOTICE, "cache: backend: %zu: number of shards %zu is changed to %zu, "
+				"it must be a power of two not greater than %d",
+				m_backend->backend_id, config.count, caches_number, DNET_CACHE_SHARDS_MAX);
+	}
+	m_shard_mask = caches_number - 1;
+	dnet_cmd_stat_names_init(&m_cmd_stat_names, "cache");
 	m_cache_pages_number = config.pages_proportions.size();
 	m_max_cache_size = config.size;
 	size_t max_size = m_max_cache_size / caches_number;
@@ -66,11 +126,29 @@ cache_manager::cache_manager(dnet_backend_io *backend, dnet_node *n, const cache
 	}
 
 	for (size_t i = 0; i < caches_number; ++i) {
-		m_caches.emplace_back(std::make_shared<slru_cache_t>(backend, n, pages_max_sizes, config.sync_timeout));
+		m_caches.emplace_back(std::make_shared<slru_cache_t>(backend, n, m_slab, pages_max_sizes, config));
+	}
+
+	if (!m_snapshot_path.empty()) {
+		restore_snapshot();
+
+		if (m_snapshot_interval) {
+			m_snapshot_thread = std::thread(std::bind(&cache_manager::snapshot_check, this));
+		}
 	}
+
+	m_write_behind.reset(new write_behind_t(backend, n, m_caches, config));
 }
 
 cache_manager::~cache_manager() {
+	if (m_snapshot_thread.joinable()) {
+		m_snapshot_thread.join();
+	}
+
+	save_snapshot();
+
+	// write-behind must be stopped before shards are destroyed, remaining dirty objects are synced by shards
+	m_write_behind.reset();
 }
 
 int cache_manager::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data) {
@@ -113,6 +191,14 @@ void cache_manager::clear() {
 	}
 }
 
+size_t cache_manager::shards_number() const {
+	return m_caches.size();
+}
+
+const char *cache_manager::cmd_stat_name(int cmd) const {
+	return dnet_cmd_stat_name(&m_cmd_stat_names, cmd);
+}
+
 size_t cache_manager::cache_size() const {
 	return m_max_cache_size;
 }
@@ -131,12 +217,28 @@ cache_stats cache_manager::get_total_cache_stats() const {
 		stats.number_of_objects_marked_for_deletion += page_stats.number_of_objects_marked_for_deletion;
 		stats.size_of_objects_marked_for_deletion += page_stats.size_of_objects_marked_for_deletion;
 		stats.size_of_objects += page_stats.size_of_objects;
+		stats.hits += page_stats.hits;
+		stats.misses += page_stats.misses;
+		stats.admitted += page_stats.admitted;
+		stats.rejected += page_stats.rejected;
+		stats.admission = page_stats.admission;
+		stats.compressed_objects += page_stats.compressed_objects;
+		stats.compressed_size += page_stats.compressed_size;
+		stats.compressed_raw_size += page_stats.compressed_raw_size;
+		stats.compressions += page_stats.compressions;
+		stats.decompressions += page_stats.decompressions;
+		stats.compress_time += page_stats.compress_time;
+		stats.decompress_time += page_stats.decompress_time;
+		stats.compression = page_stats.compression;
 
 		for (size_t j = 0; j < m_cache_pages_number; ++j) {
 			stats.pages_sizes[j] += page_stats.pages_sizes[j];
 			stats.pages_max_sizes[j] += page_stats.pages_max_sizes[j];
 		}
 	}
+	if (m_slab) {
+		stats.slab = m_slab->stats();
+	}
 	return stats;
 }
 
@@ -174,6 +276,10 @@ std::string cache_manager::stat_json() const {
 	total_cache.AddMember("size_stats", size_stats, allocator);
 	doc.AddMember("total_cache", total_cache, allocator);
 
+	rapidjson::Value write_behind(rapidjson::kObjectType);
+	m_write_behind->to_json(write_behind, allocator);
+	doc.AddMember("write_behind", write_behind, allocator);
+
 	rapidjson::Value caches(rapidjson::kObjectType);
 	get_caches_size_stats_json(caches, allocator);
 	doc.AddMember("caches", caches, allocator);
@@ -184,16 +290,167 @@ std::string cache_manager::stat_json() const {
 	return buffer.GetString();
 }
 
+const snapshot_stats &cache_manager::restore_stats() const {
+	return m_restore_stats;
+}
+
+void cache_manager::save_snapshot() {
+	if (m_snapshot_path.empty()) {
+		return;
+	}
+
+	elliptics_timer timer;
+
+	std::vector<snapshot_section_t> sections;
+	size_t objects = 0;
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		sections.emplace_back(m_caches[i]->snapshot());
+		objects += sections.back().size();
+	}
+
+	try {
+		write_snapshot(m_snapshot_path, sections);
+		dnet_log(m_node, DNET_LOG_INFO, "cache: snapshot: backend: %zu: written %zu objects to %s, elapsed: %lld ms",
+				m_backend->backend_id, objects, m_snapshot_path.c_str(), timer.elapsed());
+	} catch (const std::exception &e) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: failed to write snapshot: %s",
+				m_backend->backend_id, e.what());
+	}
+}
+
+/*
+ * Object from snapshot is restored only if it still exists on disk
+ * and was not overwritten since snapshot was taken
+ */
+static bool snapshot_entry_is_actual(local_session &sess, const snapshot_entry &entry) {
+	dnet_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	memcpy(cmd.id.id, entry.id.id, DNET_ID_SIZE);
+	cmd.cmd = DNET_CMD_LOOKUP;
+	cmd.flags = DNET_FLAGS_NOCACHE;
+
+	int err = 0;
+	ioremap::elliptics::data_pointer data = sess.lookup(cmd, &err);
+	if (err) {
+		return false;
+	}
+
+	try {
+		dnet_time timestamp = entry.timestamp;
+		auto info = data.skip<dnet_addr>().data<dnet_file_info>();
+		return dnet_time_cmp(&info->mtime, &timestamp) <= 0;
+	} catch (const std::exception &) {
+		return false;
+	}
+}
+
+void cache_manager::restore_snapshot() {
+	elliptics_timer timer;
+
+	struct stat st;
+	if (stat(m_snapshot_path.c_str(), &st) && errno == ENOENT) {
+		dnet_log(m_node, DNET_LOG_INFO, "cache: snapshot: backend: %zu: there is no snapshot %s",
+				m_backend->backend_id, m_snapshot_path.c_str());
+		return;
+	}
+
+	std::unique_ptr<snapshot_reader> reader;
+	try {
+		reader.reset(new snapshot_reader(m_snapshot_path));
+	} catch (const std::exception &e) {
+		dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: failed to load snapshot: %s",
+				m_backend->backend_id, e.what());
+		return;
+	}
+
+	const size_t sections = reader->sections();
+	const size_t threads_number = std::min<size_t>(sections, std::max(1u, std::thread::hardware_concurrency()));
+
+	std::atomic<size_t> next_section(0);
+	std::atomic<size_t> restored_objects(0), restored_size(0), skipped_objects(0);
+
+	// sections are read in parallel, every object is put into the shard it belongs to now,
+	// so snapshot remains valid after number of shards is changed
+	auto restore_sections = [&] () {
+		local_session sess(m_backend, m_node);
+
+		for (size_t section = next_section++; section < sections && !need_exit(); section = next_section++) {
+			try {
+				reader->read_section(section, [&] (const snapshot_entry &entry, const char *data) {
+					if (need_exit() || !snapshot_entry_is_actual(sess, entry) ||
+							!m_caches[idx(entry.id.id)]->restore(entry, data)) {
+						++skipped_objects;
+						return;
+					}
+
+					++restored_objects;
+					restored_size += entry.size;
+				});
+			} catch (const std::exception &e) {
+				dnet_log(m_node, DNET_LOG_ERROR, "cache: snapshot: backend: %zu: failed to restore section %zu: %s",
+						m_backend->backend_id, section, e.what());
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < threads_number; ++i) {
+		threads.emplace_back(restore_sections);
+	}
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		it->join();
+	}
+
+	m_restore_stats.restored_objects = restored_objects;
+	m_restore_stats.restored_size = restored_size;
+	m_restore_stats.skipped_objects = skipped_objects;
+	m_restore_stats.restore_time = timer.elapsed();
+
+	dnet_log(m_node, DNET_LOG_INFO, "cache: snapshot: backend: %zu: restored %zu objects (%zu bytes), "
+			"skipped %zu objects, elapsed: %lld ms",
+			m_backend->backend_id, m_restore_stats.restored_objects, m_restore_stats.restored_size,
+			m_restore_stats.skipped_objects, m_restore_stats.restore_time);
+}
+
+void cache_manager::snapshot_check() {
+	dnet_set_name("dnet_cache_snap_%zu", m_backend->backend_id);
+
+	time_t next_snapshot = time(NULL) + m_snapshot_interval;
+
+	while (!need_exit()) {
+		if (time(NULL) >= next_snapshot) {
+			save_snapshot();
+			next_snapshot = time(NULL) + m_snapshot_interval;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+	}
+}
+
+bool cache_manager::need_exit() const {
+	return dnet_need_exit(m_node) || m_backend->need_exit;
+}
+
+/*
+ * Number of shards is a power of two, so shard is picked by mask instead of division.
+ * Words of the key are mixed by multiplication first, so keys which differ only
+ * in a few bits (like sequential raw ids) are still spread over all shards.
+ */
 size_t cache_manager::idx(const unsigned char *id) {
-	size_t i = *(size_t *)id;
-	size_t j = *(size_t *)(id + DNET_ID_SIZE - sizeof(size_t));
-	return (i ^ j) % m_caches.size();
+	uint64_t i = *(uint64_t *)id;
+	uint64_t j = *(uint64_t *)(id + DNET_ID_SIZE - sizeof(uint64_t));
+	return ((i ^ j) * 0x9e3779b97f4a7c15ULL >> 32) & m_shard_mask;
 }
 
 }} /* namespace ioremap::cache */
 
 using namespace ioremap::cache;
 
+static void dnet_cache_read_data_destroy(void *priv)
+{
+	delete (std::shared_ptr<raw_data_t> *)priv;
+}
+
 int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io, char *data)
 {
 	struct dnet_node *n = st->n;
@@ -209,7 +466,7 @@ int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st
 	cache_manager *cache = (cache_manager *)backend->cache;
 	std::shared_ptr<raw_data_t> d;
 
-	FORMATTED(HANDY_TIMER_SCOPE, ("cache.%s", dnet_cmd_string(cmd->cmd)));
+	HANDY_TIMER_SCOPE(cache->cmd_stat_name(cmd->cmd));
 
 	try {
 		switch (cmd->cmd) {
@@ -257,7 +514,25 @@ int dnet_cmd_cache_io(struct dnet_backend_io *backend, struct dnet_net_state *st
 				io->total_size = d->size();
 
 				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-				err = dnet_send_read_data(st, cmd, io, (char *)d->data().data() + io->offset, -1, io->offset, 0);
+
+				/*!
+				 * Cached buffer is queued without copying, reply pins it until it is sent,
+				 * writes copy pinned chunks instead of modifying them.
+				 * Only requested slice is gathered into a new buffer if it crosses the border of chunks.
+				 */
+				if (const char *slice = d->contiguous(io->offset, io->size)) {
+					err = dnet_send_read_data_nocopy(st, cmd, io, (char *)slice,
+							dnet_cache_read_data_destroy, new std::shared_ptr<raw_data_t>(d));
+				} else {
+					char *buffer = (char *)malloc(io->size);
+					if (!buffer) {
+						err = -ENOMEM;
+						break;
+					}
+
+					d->read(io->offset, io->size, buffer);
+					err = dnet_send_read_data_nocopy(st, cmd, io, buffer, free, buffer);
+				}
 				break;
 			case DNET_CMD_DEL:
 				err = cache->remove(cmd->id.id, io);
@@ -42,44 +42,22 @@
 #include "monitor/rapidjson/writer.h"
 #include "monitor/rapidjson/stringbuffer.h"
 
-#include "treap.hpp"
+#include "timer_wheel.hpp"
+#include "hash_index.hpp"
+#include "slab_allocator.hpp"
+#include "admission.hpp"
+#include "snapshot.hpp"
+#include "raw_data.hpp"
+#include "compression.hpp"
 
 namespace ioremap { namespace cache {
 
-class raw_data_t {
-public:
-	raw_data_t(const char *data, size_t size) {
-		m_data.reserve(size);
-		m_data.insert(m_data.begin(), data, data + size);
-	}
-
-	std::vector<char> &data(void) {
-		return m_data;
-	}
-
-	size_t size(void) {
-		return m_data.size();
-	}
-
-private:
-	std::vector<char> m_data;
-};
-
 struct data_lru_tag_t;
 typedef boost::intrusive::list_base_hook<boost::intrusive::tag<data_lru_tag_t>,
 boost::intrusive::link_mode<boost::intrusive::safe_link>, boost::intrusive::optimize_size<true>
 > lru_list_base_hook_t;
 
-class data_t;
-
-template<>
-struct treap_node_traits<data_t>
-{
-	typedef const uint8_t* key_type;
-	typedef size_t priority_type;
-};
-
-class data_t : public lru_list_base_hook_t, public treap_node_t<data_t> {
+class data_t : public lru_list_base_hook_t, public timer_wheel_node_t {
 public:
 	enum class sync_state_t : char {
 		NOT_SYNCING,
@@ -90,22 +68,25 @@ public:
 	data_t(const unsigned char *id) :
 		m_lifetime(0), m_synctime(0), m_user_flags(0),
 		m_remove_from_disk(false), m_remove_from_cache(false),
-		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING) {
+		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING),
+		m_referenced(false), m_compressed(false), m_raw_size(0) {
 		memcpy(m_id.id, id, DNET_ID_SIZE);
 		dnet_empty_time(&m_timestamp);
 	}
 
-	data_t(const unsigned char *id, size_t lifetime, const char *data, size_t size, bool remove_from_disk) :
+	data_t(const unsigned char *id, size_t lifetime, const char *data, size_t size, bool remove_from_disk,
+			const cache_allocator<char> &allocator = cache_allocator<char>()) :
 		m_lifetime(0), m_synctime(0), m_user_flags(0),
 		m_remove_from_disk(remove_from_disk), m_remove_from_cache(false),
-		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING) {
+		m_only_append(false), m_removed_from_page(true), m_sync_state(sync_state_t::NOT_SYNCING),
+		m_referenced(false), m_compressed(false), m_raw_size(0) {
 		memcpy(m_id.id, id, DNET_ID_SIZE);
 		dnet_empty_time(&m_timestamp);
 
 		if (lifetime)
 			m_lifetime = lifetime + time(NULL);
 
-		m_data.reset(new raw_data_t(data, size));
+		m_data = std::allocate_shared<raw_data_t>(cache_allocator<raw_data_t>(allocator), data, size, allocator);
 	}
 
 	data_t(const data_t &other) = delete;
@@ -125,6 +106,44 @@ public:
 		return m_data;
 	}
 
+	/*
+	 * Returns data for modification.
+	 * Data returned by data() is never modified while it is pinned by someone else
+	 * (for example, by a read reply which is still in the send queue),
+	 * such data is copied and replaced first. Copy shares chunks with the pinned data,
+	 * so only chunks which are modified later are really copied. Must be called under exclusive cache lock.
+	 */
+	raw_data_t &writable_data(void) {
+		if (m_data.use_count() > 1)
+			m_data = std::allocate_shared<raw_data_t>(cache_allocator<raw_data_t>(m_data->get_allocator()), *m_data);
+		return *m_data;
+	}
+
+	/*
+	 * Objects of the cold pages may keep their data compressed,
+	 * such data must be decompressed before it is read or modified
+	 */
+	bool compressed(void) const {
+		return m_compressed;
+	}
+
+	// size of the original data, it differs from data()->size() for compressed objects
+	size_t raw_size(void) const {
+		return m_compressed ? m_raw_size : m_data->size();
+	}
+
+	void set_data(const std::shared_ptr<raw_data_t> &data) {
+		m_data = data;
+		m_compressed = false;
+		m_raw_size = 0;
+	}
+
+	void set_compressed_data(const std::shared_ptr<raw_data_t> &data, size_t raw_size) {
+		m_data = data;
+		m_compressed = true;
+		m_raw_size = raw_size;
+	}
+
 	size_t lifetime(void) const {
 		return m_lifetime;
 	}
@@ -234,16 +253,29 @@ public:
 		m_removed_from_page = removed_from_page;
 	}
 
+	/*
+	 * CLOCK reference bit, it is set by cache hits which do not hold exclusive lock
+	 * and gives the object second chance before it is moved out of its page
+	 */
+	bool referenced() const {
+		return m_referenced.load(std::memory_order_relaxed);
+	}
+
+	void set_referenced(bool referenced) {
+		m_referenced.store(referenced, std::memory_order_relaxed);
+	}
+
 	size_t size(void) const {
 		return capacity() + overhead_size();
 	}
 
 	size_t overhead_size(void) const {
-		return sizeof(*this) + sizeof(*m_data);
+		const cache_allocator<char> allocator = m_data->get_allocator();
+		return allocator.real_size(sizeof(*this)) + allocator.real_size(sizeof(*m_data));
 	}
 
 	size_t capacity(void) const {
-		return m_data->data().capacity();
+		return m_data->allocated_size();
 	}
 
 	friend bool operator< (const data_t &a, const data_t &b) {
@@ -258,34 +290,6 @@ public:
 		return dnet_id_cmp_str(a.id().id, b.id().id) == 0;
 	}
 
-	// treap_node_t
-	typedef treap_node_traits<data_t>::key_type key_type;
-	typedef treap_node_traits<data_t>::priority_type priority_type;
-
-	key_type get_key() const {
-		return m_id.id;
-	}
-
-	priority_type get_priority() const {
-		return eventtime();
-	}
-
-	inline static int key_compare(const key_type &lhs, const key_type &rhs) {
-		return dnet_id_cmp_str(lhs, rhs);
-	}
-
-	inline static int priority_compare(const priority_type &lhs, const priority_type &rhs) {
-		if (lhs < rhs) {
-			return 1;
-		}
-
-		if (lhs > rhs) {
-			return -1;
-		}
-
-		return 0;
-	}
-
 private:
 	size_t m_lifetime;
 	size_t m_synctime;
@@ -296,7 +300,10 @@ private:
 	bool m_only_append;
 	bool m_removed_from_page;
 	sync_state_t m_sync_state;
+	std::atomic<bool> m_referenced;
+	bool m_compressed;
 	char m_cache_page_number;
+	size_t m_raw_size;
 	struct dnet_raw_id m_id;
 	std::shared_ptr<raw_data_t> m_data;
 };
@@ -305,7 +312,7 @@ struct record_info {
 	record_info(data_t* obj) {
 		only_append = obj->only_append();
 		memcpy(id.id, obj->id().id, DNET_ID_SIZE);
-		data = obj->data()->data();
+		data = obj->data()->flatten();
 		user_flags = obj->user_flags();
 		timestamp = obj->timestamp();
 		is_synced = false;
@@ -331,19 +338,17 @@ struct record_id_less {
 
 typedef boost::intrusive::list<data_t, boost::intrusive::base_hook<lru_list_base_hook_t> > lru_list_t;
 
-struct eventtime_less {
-	bool operator() (const data_t &x, const data_t &y) const {
-		return x.eventtime() < y.eventtime()
-				|| (x.eventtime() == y.eventtime() && ((&x) < (&y)));
-	}
-};
+typedef timer_wheel<data_t> timer_wheel_t;
 
-typedef treap<data_t> treap_t;
+typedef hash_index<data_t> hash_index_t;
 
 struct cache_stats {
 	cache_stats():
 		number_of_objects(0), size_of_objects(0),
-		number_of_objects_marked_for_deletion(0), size_of_objects_marked_for_deletion(0) {}
+		number_of_objects_marked_for_deletion(0), size_of_objects_marked_for_deletion(0),
+		hits(0), misses(0), admitted(0), rejected(0), admission("none"),
+		compressed_objects(0), compressed_size(0), compressed_raw_size(0),
+		compressions(0), decompressions(0), compress_time(0), decompress_time(0), compression("none") {}
 
 	std::size_t number_of_objects;
 	std::size_t size_of_objects;
@@ -353,11 +358,60 @@ struct cache_stats {
 	std::vector<size_t> pages_sizes;
 	std::vector<size_t> pages_max_sizes;
 
+	// usage of slab allocator shared by all shards, it is reported only in total stats,
+	// classes are empty if slab allocator is disabled
+	slab_stats slab;
+
+	// reads served from cache and reads which did not find object in cache
+	std::size_t hits;
+	std::size_t misses;
+	// new objects which were allowed or denied to push out other objects by admission policy
+	std::size_t admitted;
+	std::size_t rejected;
+	std::string admission;
+
+	// objects of the cold pages kept compressed: bytes they occupy and size of their original data
+	std::size_t compressed_objects;
+	std::size_t compressed_size;
+	std::size_t compressed_raw_size;
+	// codec calls and time spent in them in microseconds
+	std::size_t compressions;
+	std::size_t decompressions;
+	std::size_t compress_time;
+	std::size_t decompress_time;
+	std::string compression;
+
 	rapidjson::Value& to_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const {
 		stat_value.AddMember("size", size_of_objects, allocator)
 				  .AddMember("removing_size", size_of_objects_marked_for_deletion, allocator)
 				  .AddMember("objects", number_of_objects, allocator)
-				  .AddMember("removing_objects", number_of_objects_marked_for_deletion, allocator);
+				  .AddMember("removing_objects", number_of_objects_marked_for_deletion, allocator)
+				  .AddMember("hits", hits, allocator)
+				  .AddMember("misses", misses, allocator)
+				  .AddMember("hit_ratio", (hits + misses) ? hits * 1.0 / (hits + misses) : 0.0, allocator);
+
+		rapidjson::Value admission_policy;
+		admission_policy.SetString(admission.c_str(), allocator);
+
+		rapidjson::Value admission_stat(rapidjson::kObjectType);
+		admission_stat.AddMember("policy", admission_policy, allocator)
+			      .AddMember("admitted", admitted, allocator)
+			      .AddMember("rejected", rejected, allocator);
+		stat_value.AddMember("admission", admission_stat, allocator);
+
+		rapidjson::Value compression_codec;
+		compression_codec.SetString(compression.c_str(), allocator);
+
+		rapidjson::Value compression_stat(rapidjson::kObjectType);
+		compression_stat.AddMember("codec", compression_codec, allocator)
+				.AddMember("objects", compressed_objects, allocator)
+				.AddMember("size", compressed_size, allocator)
+				.AddMember("raw_size", compressed_raw_size, allocator)
+				.AddMember("compressions", compressions, allocator)
+				.AddMember("decompressions", decompressions, allocator)
+				.AddMember("compress_time", compress_time, allocator)
+				.AddMember("decompress_time", decompress_time, allocator);
+		stat_value.AddMember("compression", compression_stat, allocator);
 
 		rapidjson::Value pages_sizes_stat(rapidjson::kArrayType);
 		for (auto it = pages_sizes.begin(), end = pages_sizes.end(); it != end; ++it) {
@@ -370,11 +424,42 @@ struct cache_stats {
 			pages_max_sizes_stat.PushBack(*it, allocator);
 		}
 		stat_value.AddMember("pages_max_sizes", pages_max_sizes_stat, allocator);
+
+		if (!slab.classes.empty()) {
+			size_t wasted_size = 0, free_size = 0;
+
+			rapidjson::Value slab_classes_stat(rapidjson::kArrayType);
+			for (auto it = slab.classes.begin(), end = slab.classes.end(); it != end; ++it) {
+				if (!it->slots)
+					continue;
+
+				wasted_size += it->wasted_size();
+				free_size += it->free_size();
+
+				rapidjson::Value class_stat(rapidjson::kObjectType);
+				class_stat.AddMember("slot_size", it->slot_size, allocator)
+					  .AddMember("slots", it->slots, allocator)
+					  .AddMember("used_slots", it->used_slots, allocator)
+					  .AddMember("used_size", it->used_size, allocator)
+					  .AddMember("wasted_size", it->wasted_size(), allocator);
+				slab_classes_stat.PushBack(class_stat, allocator);
+			}
+
+			rapidjson::Value slab_stat(rapidjson::kObjectType);
+			slab_stat.AddMember("pages_size", slab.pages_size, allocator)
+				 .AddMember("wasted_size", wasted_size, allocator)
+				 .AddMember("free_size", free_size, allocator)
+				 .AddMember("large_objects", slab.large_number, allocator)
+				 .AddMember("large_size", slab.large_size, allocator)
+				 .AddMember("classes", slab_classes_stat, allocator);
+			stat_value.AddMember("slab", slab_stat, allocator);
+		}
 		return stat_value;
 	}
 };
 
 class slru_cache_t;
+class write_behind_t;
 
 class cache_manager {
 	public:
@@ -398,6 +483,11 @@ class cache_manager {
 
 		void clear();
 
+		size_t shards_number() const;
+
+		// name of timer of cache command, it is built once on construction
+		const char *cmd_stat_name(int cmd) const;
+
 		size_t cache_size() const;
 
 		size_t cache_pages_number() const;
@@ -416,13 +506,35 @@ class cache_manager {
 
 		std::string stat_json() const;
 
+		// returns results of restoring cache from snapshot on start
+		const snapshot_stats &restore_stats() const;
+
+		// writes clean objects of all shards into snapshot file if snapshot is enabled
+		void save_snapshot();
+
 	private:
+		dnet_backend_io *m_backend;
 		dnet_node *m_node;
+		// slab allocator is shared by all shards, so adding a shard does not add slab pages
+		std::shared_ptr<slab_allocator_t> m_slab;
 		std::vector<std::shared_ptr<slru_cache_t>> m_caches;
+		size_t m_shard_mask;
+		dnet_cmd_stat_names m_cmd_stat_names;
 		size_t m_max_cache_size;
 		size_t m_cache_pages_number;
+		std::string m_snapshot_path;
+		unsigned m_snapshot_interval;
+		std::thread m_snapshot_thread;
+		snapshot_stats m_restore_stats;
+		std::unique_ptr<write_behind_t> m_write_behind;
 
 		size_t idx(const unsigned char *id);
+
+		bool need_exit() const;
+
+		void restore_snapshot();
+
+		void snapshot_check();
 };
 
 template <typename T>
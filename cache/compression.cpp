@@ -0,0 +1,81 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "compression.hpp"
+
+#include <stdexcept>
+
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/detail/config/zlib.hpp>
+
+namespace ioremap { namespace cache {
+
+/*
+ * Sink which appends everything written into it to the chunked data
+ */
+class raw_data_sink {
+public:
+	typedef char char_type;
+	typedef boost::iostreams::sink_tag category;
+
+	raw_data_sink(raw_data_t &data) : m_data(&data) {}
+
+	std::streamsize write(const char *data, std::streamsize size) {
+		m_data->append(data, size);
+		return size;
+	}
+
+private:
+	raw_data_t *m_data;
+};
+
+// passes chunks of @data through @filter into @out without gathering them into one buffer
+template<typename Filter>
+static void filter_chunks(const Filter &filter, const raw_data_t &data, raw_data_t &out) {
+	boost::iostreams::filtering_ostream stream;
+	stream.push(filter);
+	stream.push(raw_data_sink(out));
+
+	data.for_each(0, data.size(), [&stream] (const char *chunk, size_t size) {
+		stream.write(chunk, size);
+	});
+
+	// stream catches errors of the filter, they are reported by its state
+	if (!stream.good())
+		throw std::runtime_error("cache codec failed");
+
+	stream.reset();
+}
+
+const char *zlib_codec_t::name() const {
+	return "zlib";
+}
+
+void zlib_codec_t::compress(const raw_data_t &data, raw_data_t &out) const {
+	filter_chunks(boost::iostreams::zlib_compressor(boost::iostreams::zlib::best_speed), data, out);
+}
+
+void zlib_codec_t::decompress(const raw_data_t &data, raw_data_t &out) const {
+	filter_chunks(boost::iostreams::zlib_decompressor(), data, out);
+}
+
+std::unique_ptr<compression_codec_t> create_compression_codec(const std::string &name) {
+	if (name == "none")
+		return std::unique_ptr<compression_codec_t>();
+	if (name == "zlib")
+		return std::unique_ptr<compression_codec_t>(new zlib_codec_t);
+
+	throw std::invalid_argument("unknown cache compression codec: " + name + ", supported: none, zlib");
+}
+
+}} /* namespace ioremap::cache */
@@ -0,0 +1,62 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef COMPRESSION_HPP
+#define COMPRESSION_HPP
+
+#include <memory>
+#include <string>
+
+#include "raw_data.hpp"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Codec of objects kept in the cold pages of the cache.
+ * Codec has no state, so it may be used concurrently from different threads.
+ */
+class compression_codec_t {
+public:
+	virtual ~compression_codec_t() {}
+
+	virtual const char *name() const = 0;
+
+	// appends compressed @data to @out
+	virtual void compress(const raw_data_t &data, raw_data_t &out) const = 0;
+
+	// appends decompressed @data to @out
+	virtual void decompress(const raw_data_t &data, raw_data_t &out) const = 0;
+};
+
+/*
+ * zlib with the fastest compression level, cached objects are compressed
+ * by the background thread and decompressed by reads, so speed matters more than ratio
+ */
+class zlib_codec_t : public compression_codec_t {
+public:
+	virtual const char *name() const;
+	virtual void compress(const raw_data_t &data, raw_data_t &out) const;
+	virtual void decompress(const raw_data_t &data, raw_data_t &out) const;
+};
+
+/*
+ * Creates codec by its name from config:
+ *  "none" - objects are never compressed, returns empty pointer
+ *  "zlib" - @zlib_codec_t
+ *
+ * Throws std::invalid_argument if @name is unknown.
+ */
+std::unique_ptr<compression_codec_t> create_compression_codec(const std::string &name);
+
+}}
+
+#endif // COMPRESSION_HPP
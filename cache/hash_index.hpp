@@ -0,0 +1,164 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef HASH_INDEX_HPP
+#define HASH_INDEX_HPP
+
+#include <vector>
+#include <stdexcept>
+
+#include "elliptics/id_compare.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Open-addressing hash index of objects by their DNET_ID_SIZE-bytes IDs.
+ * Linear probing is used, erased slots are filled by backward shifting,
+ * so there are no tombstones and lookups never degrade after removals.
+ *
+ * Node type must provide id() returning struct dnet_raw_id.
+ * Index is not synchronized: lookups may run concurrently with each other,
+ * but not with insertions or removals.
+ */
+template<typename node_type>
+class hash_index {
+public:
+	typedef node_type* p_node_type;
+
+	hash_index(): m_size(0) {
+		m_slots.resize(initial_capacity);
+	}
+
+	p_node_type find(const unsigned char *id) const {
+		const uint64_t h = hash(id);
+		const size_t mask = m_slots.size() - 1;
+
+		for (size_t i = h & mask; m_slots[i].node; i = (i + 1) & mask) {
+			if (m_slots[i].hash == h && dnet_id_equal_raw(m_slots[i].node->id().id, id))
+				return m_slots[i].node;
+		}
+
+		return NULL;
+	}
+
+	void insert(p_node_type node) {
+		if (!node) {
+			throw std::logic_error("insert: can't insert NULL");
+		}
+
+		if ((m_size + 1) * 4 > m_slots.size() * 3)
+			rehash(m_slots.size() * 2);
+
+		insert_slot(hash(node->id().id), node);
+		++m_size;
+	}
+
+	void erase(p_node_type node) {
+		const uint64_t h = hash(node->id().id);
+		const size_t mask = m_slots.size() - 1;
+		size_t i = h & mask;
+
+		while (m_slots[i].node != node) {
+			if (!m_slots[i].node) {
+				throw std::logic_error("erase: element does not exist");
+			}
+			i = (i + 1) & mask;
+		}
+
+		/*
+		 * Shift back following elements of the probe sequence
+		 * which would become unreachable after @i is emptied
+		 */
+		for (size_t j = i;;) {
+			m_slots[i].node = NULL;
+
+			size_t k;
+			do {
+				j = (j + 1) & mask;
+				if (!m_slots[j].node) {
+					--m_size;
+					return;
+				}
+
+				k = m_slots[j].hash & mask;
+			} while ((i <= j) ? (i < k && k <= j) : (i < k || k <= j));
+
+			m_slots[i] = m_slots[j];
+			i = j;
+		}
+	}
+
+	// calls @func for every node, @func must not modify the index
+	template<typename Func>
+	void for_each(Func func) const {
+		for (auto it = m_slots.begin(), end = m_slots.end(); it != end; ++it) {
+			if (it->node)
+				func(it->node);
+		}
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	bool empty() const {
+		return !m_size;
+	}
+
+private:
+	enum {
+		initial_capacity = 64
+	};
+
+	struct slot_t {
+		slot_t(): hash(0), node(NULL) {}
+
+		uint64_t hash;
+		p_node_type node;
+	};
+
+	/*
+	 * IDs are already uniformly distributed, cache_manager selects shard by the first
+	 * and the last words of ID, so the second word is used to place ID inside the shard.
+	 */
+	static uint64_t hash(const unsigned char *id) {
+		return dnet_id_prefix(id + sizeof(uint64_t));
+	}
+
+	void insert_slot(uint64_t h, p_node_type node) {
+		const size_t mask = m_slots.size() - 1;
+		size_t i = h & mask;
+
+		while (m_slots[i].node)
+			i = (i + 1) & mask;
+
+		m_slots[i].hash = h;
+		m_slots[i].node = node;
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<slot_t> slots(capacity);
+		m_slots.swap(slots);
+
+		for (auto it = slots.begin(), end = slots.end(); it != end; ++it) {
+			if (it->node)
+				insert_slot(it->hash, it->node);
+		}
+	}
+
+	std::vector<slot_t> m_slots;
+	size_t m_size;
+};
+
+}}
+
+#endif // HASH_INDEX_HPP
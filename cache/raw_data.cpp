@@ -0,0 +1,179 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "raw_data.hpp"
+
+#include <cstring>
+
+namespace ioremap { namespace cache {
+
+raw_data_t::raw_data_t(const char *data, size_t size, const cache_allocator<char> &allocator) :
+	m_allocator(allocator),
+	m_chunks(allocator),
+	m_size(0) {
+	m_chunks.reserve((size + chunk_size - 1) / chunk_size);
+
+	for (size_t offset = 0; offset < size; offset += chunk_size) {
+		const size_t part = std::min<size_t>(size - offset, chunk_size);
+
+		m_chunks.push_back(create_chunk(part));
+		m_chunks.back()->insert(m_chunks.back()->end(), data + offset, data + offset + part);
+	}
+
+	m_size = size;
+}
+
+/*
+ * Copy keeps capacity of the original table of chunks, so cache accounting
+ * does not change when pinned data is copied before modification
+ */
+raw_data_t::raw_data_t(const raw_data_t &other) :
+	m_allocator(other.m_allocator),
+	m_chunks(other.m_allocator),
+	m_size(other.m_size) {
+	m_chunks.reserve(other.m_chunks.capacity());
+	m_chunks.insert(m_chunks.end(), other.m_chunks.begin(), other.m_chunks.end());
+}
+
+size_t raw_data_t::allocated_size(void) const {
+	size_t size = m_allocator.real_size(m_chunks.capacity() * sizeof(chunk_t));
+
+	for (auto it = m_chunks.begin(), end = m_chunks.end(); it != end; ++it) {
+		size += m_allocator.real_size(sizeof(cache_buffer_t)) + m_allocator.real_size((*it)->capacity());
+	}
+
+	return size;
+}
+
+const char *raw_data_t::contiguous(size_t offset, size_t size) const {
+	if (!size) {
+		return "";
+	}
+
+	const size_t index = offset / chunk_size;
+	if (index != (offset + size - 1) / chunk_size) {
+		return NULL;
+	}
+
+	return m_chunks[index]->data() + offset % chunk_size;
+}
+
+void raw_data_t::read(size_t offset, size_t size, char *out) const {
+	for_each(offset, size, [&out] (const char *data, size_t part) {
+		memcpy(out, data, part);
+		out += part;
+	});
+}
+
+std::vector<char> raw_data_t::flatten(void) const {
+	std::vector<char> result(m_size);
+	read(0, m_size, result.data());
+	return result;
+}
+
+void raw_data_t::append(const char *data, size_t size) {
+	append_chunks(data, size);
+}
+
+void raw_data_t::write(size_t offset, const char *data, size_t size) {
+	resize(offset + size);
+
+	while (size) {
+		const size_t index = offset / chunk_size;
+		const size_t position = offset % chunk_size;
+		const size_t part = std::min<size_t>(size, chunk_size - position);
+
+		memcpy(writable_chunk(index, 0).data() + position, data, part);
+
+		offset += part;
+		data += part;
+		size -= part;
+	}
+}
+
+void raw_data_t::resize(size_t size) {
+	if (size >= m_size) {
+		append_chunks(NULL, size - m_size);
+		return;
+	}
+
+	const size_t chunks = (size + chunk_size - 1) / chunk_size;
+	m_chunks.resize(chunks);
+
+	if (chunks) {
+		const size_t tail = size - (chunks - 1) * chunk_size;
+		if (m_chunks.back()->size() != tail) {
+			writable_chunk(chunks - 1, 0).resize(tail);
+		}
+	}
+
+	m_size = size;
+}
+
+void raw_data_t::shrink_to_fit(void) {
+	if (m_chunks.empty() || m_chunks.back()->capacity() == m_chunks.back()->size()) {
+		return;
+	}
+
+	const cache_buffer_t &last = *m_chunks.back();
+	chunk_t chunk = create_chunk(last.size());
+	chunk->insert(chunk->end(), last.begin(), last.end());
+	m_chunks.back() = chunk;
+}
+
+raw_data_t::chunk_t raw_data_t::create_chunk(size_t capacity) const {
+	chunk_t chunk = std::allocate_shared<cache_buffer_t>(cache_allocator<cache_buffer_t>(m_allocator), m_allocator);
+	chunk->reserve(capacity);
+	return chunk;
+}
+
+cache_buffer_t &raw_data_t::writable_chunk(size_t index, size_t capacity) {
+	chunk_t &chunk = m_chunks[index];
+
+	if (chunk.use_count() > 1) {
+		chunk_t copy = create_chunk(std::max(capacity, chunk->size()));
+		copy->insert(copy->end(), chunk->begin(), chunk->end());
+		chunk = copy;
+	} else if (chunk->capacity() < capacity) {
+		chunk->reserve(capacity);
+	}
+
+	return *chunk;
+}
+
+void raw_data_t::append_chunks(const char *data, size_t size) {
+	while (size) {
+		if (m_chunks.empty() || m_chunks.back()->size() == chunk_size) {
+			m_chunks.push_back(create_chunk(0));
+		}
+
+		const size_t index = m_chunks.size() - 1;
+		const size_t used = m_chunks[index]->size();
+		const size_t part = std::min<size_t>(size, chunk_size - used);
+
+		// the last chunk grows geometrically, but never beyond the chunk size
+		const size_t capacity = std::min<size_t>(chunk_size, std::max(used + part, 2 * m_chunks[index]->capacity()));
+		cache_buffer_t &chunk = writable_chunk(index, capacity);
+
+		if (data) {
+			chunk.insert(chunk.end(), data, data + part);
+			data += part;
+		} else {
+			chunk.resize(used + part);
+		}
+
+		m_size += part;
+		size -= part;
+	}
+}
+
+}} /* namespace ioremap::cache */
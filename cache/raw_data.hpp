@@ -0,0 +1,114 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef RAW_DATA_HPP
+#define RAW_DATA_HPP
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+#include "slab_allocator.hpp"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Data of cached object kept as a sequence of chunks, every chunk except the last one is full.
+ *
+ * Copy shares chunks with the original, chunk is copied only when it is modified while shared.
+ * So data pinned by a reader is never changed, and modification of pinned data copies
+ * only the chunks it touches instead of the whole object. Appends fill the last chunk
+ * and add new ones, so growing object is never moved.
+ *
+ * Objects which fit into one chunk are kept contiguous, the same as before chunking.
+ */
+class raw_data_t {
+public:
+	enum {
+		chunk_size = 64 * 1024
+	};
+
+	raw_data_t(const char *data, size_t size, const cache_allocator<char> &allocator = cache_allocator<char>());
+
+	raw_data_t(const raw_data_t &other);
+
+	raw_data_t &operator =(const raw_data_t &other) = delete;
+
+	size_t size(void) const {
+		return m_size;
+	}
+
+	cache_allocator<char> get_allocator(void) const {
+		return m_allocator;
+	}
+
+	// number of bytes which chunks really occupy in memory
+	size_t allocated_size(void) const;
+
+	/*
+	 * Returns pointer to [@offset, @offset + @size) if it lies inside one chunk,
+	 * returns NULL if range crosses the border of chunks.
+	 */
+	const char *contiguous(size_t offset, size_t size) const;
+
+	// copies [@offset, @offset + @size) into @out
+	void read(size_t offset, size_t size, char *out) const;
+
+	// returns the whole data in one buffer
+	std::vector<char> flatten(void) const;
+
+	// calls @func(data, size) for every piece of [@offset, @offset + @size) in order
+	template<typename Func>
+	void for_each(size_t offset, size_t size, Func func) const {
+		while (size) {
+			const size_t index = offset / chunk_size;
+			const size_t position = offset % chunk_size;
+			const size_t part = std::min<size_t>(size, chunk_size - position);
+
+			func(m_chunks[index]->data() + position, part);
+
+			offset += part;
+			size -= part;
+		}
+	}
+
+	void append(const char *data, size_t size);
+
+	// data becomes @offset + @size bytes long and [@offset, @offset + @size) is replaced by @data
+	void write(size_t offset, const char *data, size_t size);
+
+	// truncates data or extends it by zeroes
+	void resize(size_t size);
+
+	// releases spare capacity of the last chunk
+	void shrink_to_fit(void);
+
+private:
+	typedef std::shared_ptr<cache_buffer_t> chunk_t;
+
+	chunk_t create_chunk(size_t capacity) const;
+
+	// returns chunk which is not shared with anybody and may be modified
+	cache_buffer_t &writable_chunk(size_t index, size_t capacity);
+
+	// appends @size bytes of @data, or zeroes if @data is NULL
+	void append_chunks(const char *data, size_t size);
+
+	cache_allocator<char> m_allocator;
+	std::vector<chunk_t, cache_allocator<chunk_t>> m_chunks;
+	size_t m_size;
+};
+
+}}
+
+#endif // RAW_DATA_HPP
@@ -0,0 +1,236 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "slab_allocator.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace ioremap { namespace cache {
+
+// slots are aligned as malloc() result is and are large enough to hold free list link
+#define SLAB_ALIGNMENT 16
+#define SLAB_MIN_SLOT_SIZE 64
+// number of empty pages kept for reuse, other empty pages are returned to the system
+#define SLAB_MAX_FREE_PAGES 4
+
+static size_t slab_align(size_t size) {
+	return (size + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1);
+}
+
+slab_allocator_t::slab_allocator_t(size_t page_size) :
+	m_page_size(slab_align(page_size)),
+	m_large_number(0),
+	m_large_size(0) {
+	for (size_t size = SLAB_MIN_SLOT_SIZE; size < m_page_size; size = slab_align(size + size / 4)) {
+		m_slot_sizes.push_back(size);
+	}
+	m_slot_sizes.push_back(m_page_size);
+
+	for (auto it = m_slot_sizes.begin(), end = m_slot_sizes.end(); it != end; ++it) {
+		m_classes.emplace_back(*it);
+	}
+}
+
+slab_allocator_t::~slab_allocator_t() {
+	for (auto it = m_pages.begin(), end = m_pages.end(); it != end; ++it) {
+		free(it->first);
+	}
+	for (auto it = m_free_pages.begin(), end = m_free_pages.end(); it != end; ++it) {
+		free(*it);
+	}
+}
+
+void *slab_allocator_t::allocate(size_t size) {
+	const size_t index = class_index(size);
+
+	if (index == m_classes.size()) {
+		void *ptr = malloc(size);
+		if (!ptr)
+			throw std::bad_alloc();
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		++m_large_number;
+		m_large_size += size;
+		return ptr;
+	}
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	slab_class &cls = m_classes[index];
+
+	if (!cls.partial_pages && !allocate_page(index))
+		throw std::bad_alloc();
+
+	slab_page *page = cls.partial_pages;
+	void *ptr = page->free_slots;
+	page->free_slots = *static_cast<void **>(ptr);
+	++page->used_slots;
+	if (!page->free_slots)
+		unlink_page(cls, page);
+
+	++cls.used_slots;
+	cls.used_size += size;
+	return ptr;
+}
+
+void slab_allocator_t::deallocate(void *ptr, size_t size) {
+	if (!ptr)
+		return;
+
+	const size_t index = class_index(size);
+
+	if (index == m_classes.size()) {
+		free(ptr);
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		--m_large_number;
+		m_large_size -= size;
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(m_lock);
+	slab_class &cls = m_classes[index];
+
+	auto it = m_pages.upper_bound(static_cast<char *>(ptr));
+	--it;
+	slab_page *page = &it->second;
+
+	if (!page->free_slots)
+		link_page(cls, page);
+
+	*static_cast<void **>(ptr) = page->free_slots;
+	page->free_slots = ptr;
+	--page->used_slots;
+
+	--cls.used_slots;
+	cls.used_size -= size;
+
+	if (!page->used_slots)
+		release_page(it);
+}
+
+size_t slab_allocator_t::real_size(size_t size) const {
+	if (!size)
+		return 0;
+
+	const size_t index = class_index(size);
+	if (index == m_slot_sizes.size())
+		return size;
+
+	return m_slot_sizes[index];
+}
+
+slab_stats slab_allocator_t::stats() const {
+	slab_stats stats;
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	stats.pages_size = (m_pages.size() + m_free_pages.size()) * m_page_size;
+	stats.large_number = m_large_number;
+	stats.large_size = m_large_size;
+
+	stats.classes.resize(m_classes.size());
+	for (size_t i = 0; i < m_classes.size(); ++i) {
+		const slab_class &cls = m_classes[i];
+		slab_class_stats &cls_stats = stats.classes[i];
+
+		cls_stats.slot_size = cls.slot_size;
+		cls_stats.slots = cls.slots;
+		cls_stats.used_slots = cls.used_slots;
+		cls_stats.used_size = cls.used_size;
+	}
+
+	return stats;
+}
+
+size_t slab_allocator_t::class_index(size_t size) const {
+	return std::lower_bound(m_slot_sizes.begin(), m_slot_sizes.end(), size) - m_slot_sizes.begin();
+}
+
+bool slab_allocator_t::allocate_page(size_t index) {
+	slab_class &cls = m_classes[index];
+	char *data;
+
+	if (!m_free_pages.empty()) {
+		data = m_free_pages.back();
+		m_free_pages.pop_back();
+	} else {
+		data = static_cast<char *>(malloc(m_page_size));
+		if (!data)
+			return false;
+	}
+
+	slab_page *page;
+	try {
+		page = &m_pages[data];
+	} catch (...) {
+		free(data);
+		return false;
+	}
+
+	page->class_index = index;
+	page->used_slots = 0;
+	page->free_slots = NULL;
+
+	const size_t slots = m_page_size / cls.slot_size;
+	for (size_t i = slots; i > 0; --i) {
+		void *slot = data + (i - 1) * cls.slot_size;
+		*static_cast<void **>(slot) = page->free_slots;
+		page->free_slots = slot;
+	}
+
+	link_page(cls, page);
+	cls.slots += slots;
+	return true;
+}
+
+void slab_allocator_t::release_page(std::map<char *, slab_page>::iterator it) {
+	slab_class &cls = m_classes[it->second.class_index];
+	char *data = it->first;
+
+	unlink_page(cls, &it->second);
+	cls.slots -= m_page_size / cls.slot_size;
+	m_pages.erase(it);
+
+	if (m_free_pages.size() < SLAB_MAX_FREE_PAGES) {
+		try {
+			m_free_pages.push_back(data);
+			return;
+		} catch (...) {
+		}
+	}
+
+	free(data);
+}
+
+void slab_allocator_t::link_page(slab_class &cls, slab_page *page) {
+	page->prev = NULL;
+	page->next = cls.partial_pages;
+	if (cls.partial_pages)
+		cls.partial_pages->prev = page;
+	cls.partial_pages = page;
+}
+
+void slab_allocator_t::unlink_page(slab_class &cls, slab_page *page) {
+	if (page->prev)
+		page->prev->next = page->next;
+	else
+		cls.partial_pages = page->next;
+
+	if (page->next)
+		page->next->prev = page->prev;
+
+	page->prev = page->next = NULL;
+}
+
+}} /* namespace ioremap::cache */
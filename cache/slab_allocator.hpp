@@ -0,0 +1,237 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace ioremap { namespace cache {
+
+/*
+ * Usage of one size class of slab allocator
+ */
+struct slab_class_stats {
+	slab_class_stats(): slot_size(0), slots(0), used_slots(0), used_size(0) {}
+
+	// size of every slot in this class
+	size_t slot_size;
+	// number of slots carved from allocated pages
+	size_t slots;
+	// number of slots given to users
+	size_t used_slots;
+	// number of bytes requested by users of used slots
+	size_t used_size;
+
+	// bytes lost to rounding requested sizes up to slot size
+	size_t wasted_size() const {
+		return used_slots * slot_size - used_size;
+	}
+
+	// bytes of allocated pages which are not used by anyone
+	size_t free_size() const {
+		return (slots - used_slots) * slot_size;
+	}
+};
+
+struct slab_stats {
+	slab_stats(): pages_size(0), large_number(0), large_size(0) {}
+
+	// total size of pages allocated for slots, free pages kept for reuse included
+	size_t pages_size;
+	// allocations which are too large for any class are served by the system heap
+	size_t large_number;
+	size_t large_size;
+
+	std::vector<slab_class_stats> classes;
+
+	// sums usage of allocators which share the same size classes
+	void add(const slab_stats &other) {
+		pages_size += other.pages_size;
+		large_number += other.large_number;
+		large_size += other.large_size;
+
+		if (classes.size() < other.classes.size())
+			classes.resize(other.classes.size());
+
+		for (size_t i = 0; i < other.classes.size(); ++i) {
+			classes[i].slot_size = other.classes[i].slot_size;
+			classes[i].slots += other.classes[i].slots;
+			classes[i].used_slots += other.classes[i].used_slots;
+			classes[i].used_size += other.classes[i].used_size;
+		}
+	}
+};
+
+/*
+ * Size-classed slab allocator for cache objects.
+ *
+ * Memory is requested from the system by pages of fixed size, every page is carved
+ * into slots of one size class. Sizes of neighbour classes differ by 1/4,
+ * so no allocation wastes more than ~20% of its slot, and freed slots are reused
+ * by objects of similar size instead of fragmenting the system heap.
+ * Page whose slots are all freed leaves its class: a few such pages are kept for reuse by any class,
+ * the rest are returned to the system, so memory follows changes of object sizes.
+ *
+ * Allocator is thread-safe: buffers pinned by in-flight replies are freed outside of cache locks.
+ */
+class slab_allocator_t {
+public:
+	slab_allocator_t(size_t page_size = 1024 * 1024);
+	~slab_allocator_t();
+
+	void *allocate(size_t size);
+	void deallocate(void *ptr, size_t size);
+
+	// number of bytes which are really occupied by allocation of @size bytes
+	size_t real_size(size_t size) const;
+
+	slab_stats stats() const;
+
+private:
+	struct slab_page {
+		size_t class_index;
+		size_t used_slots;
+		void *free_slots;
+		// neighbours in list of class pages which have free slots
+		slab_page *prev;
+		slab_page *next;
+	};
+
+	struct slab_class {
+		slab_class(size_t size): slot_size(size), partial_pages(NULL), slots(0), used_slots(0), used_size(0) {}
+
+		size_t slot_size;
+		// pages which have free slots, allocations are served by the first one
+		slab_page *partial_pages;
+		size_t slots;
+		size_t used_slots;
+		size_t used_size;
+	};
+
+	slab_allocator_t(const slab_allocator_t &) = delete;
+	slab_allocator_t &operator =(const slab_allocator_t &) = delete;
+
+	// returns index of the smallest class which fits @size or number of classes if there is no such
+	size_t class_index(size_t size) const;
+
+	bool allocate_page(size_t index);
+	void release_page(std::map<char *, slab_page>::iterator page);
+
+	static void link_page(slab_class &cls, slab_page *page);
+	static void unlink_page(slab_class &cls, slab_page *page);
+
+	const size_t m_page_size;
+	// slot sizes of all classes in ascending order, never changed after construction
+	std::vector<size_t> m_slot_sizes;
+
+	mutable std::mutex m_lock;
+	std::vector<slab_class> m_classes;
+	// pages given to classes by their addresses, slot is found by the page which starts before it
+	std::map<char *, slab_page> m_pages;
+	// empty pages kept for reuse by any class
+	std::vector<char *> m_free_pages;
+	size_t m_large_number;
+	size_t m_large_size;
+};
+
+/*
+ * Standard allocator which takes memory from @slab_allocator_t or from the system heap if slab is not set.
+ * Allocator shares ownership of the slab, so buffers may outlive the cache which created them.
+ */
+template <typename T>
+class cache_allocator {
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T &reference;
+	typedef const T &const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <typename U>
+	struct rebind {
+		typedef cache_allocator<U> other;
+	};
+
+	cache_allocator() {}
+
+	explicit cache_allocator(const std::shared_ptr<slab_allocator_t> &slab): m_slab(slab) {}
+
+	template <typename U>
+	cache_allocator(const cache_allocator<U> &other): m_slab(other.slab()) {}
+
+	pointer allocate(size_type n, const void * = 0) {
+		if (m_slab)
+			return static_cast<pointer>(m_slab->allocate(n * sizeof(T)));
+		return static_cast<pointer>(::operator new(n * sizeof(T)));
+	}
+
+	void deallocate(pointer p, size_type n) {
+		if (m_slab)
+			m_slab->deallocate(p, n * sizeof(T));
+		else
+			::operator delete(p);
+	}
+
+	size_type real_size(size_type n) const {
+		if (m_slab)
+			return m_slab->real_size(n * sizeof(T));
+		return n * sizeof(T);
+	}
+
+	size_type max_size() const {
+		return std::numeric_limits<size_type>::max() / sizeof(T);
+	}
+
+	template <typename U, typename... Args>
+	void construct(U *p, Args&&... args) {
+		::new((void *)p) U(std::forward<Args>(args)...);
+	}
+
+	template <typename U>
+	void destroy(U *p) {
+		p->~U();
+	}
+
+	const std::shared_ptr<slab_allocator_t> &slab() const {
+		return m_slab;
+	}
+
+private:
+	std::shared_ptr<slab_allocator_t> m_slab;
+};
+
+template <typename T, typename U>
+inline bool operator ==(const cache_allocator<T> &lhs, const cache_allocator<U> &rhs) {
+	return lhs.slab() == rhs.slab();
+}
+
+template <typename T, typename U>
+inline bool operator !=(const cache_allocator<T> &lhs, const cache_allocator<U> &rhs) {
+	return lhs.slab() != rhs.slab();
+}
+
+// buffer of cached object's data
+typedef std::vector<char, cache_allocator<char>> cache_buffer_t;
+
+}}
+
+#endif // SLAB_ALLOCATOR_HPP
@@ -21,6 +21,7 @@
 #include "slru_cache.hpp"
 #include "library/request_queue.h"
 #include <cassert>
+#include <algorithm>
 
 #include "monitor/measure_points.h"
 
@@ -41,27 +42,71 @@
 	#define TIMER_STOP(...)
 #endif
 
+// Maximum number of cache hits waiting for promotion to hotter page,
+// hits which do not fit are not promoted, but they still set CLOCK reference bit.
+#define DNET_CACHE_PROMOTIONS_MAX 1024
+
+// Bounds of admission sketch width, it is chosen by number of 4 KiB objects fitting into the cache
+#define DNET_CACHE_ADMISSION_WIDTH_MIN 1024
+#define DNET_CACHE_ADMISSION_WIDTH_MAX (1 << 22)
+#define DNET_CACHE_ADMISSION_OBJECT_SIZE 4096
+
+// Maximum number of demoted objects waiting for compression,
+// objects which do not fit stay uncompressed until they are demoted again
+#define DNET_CACHE_COMPRESSIONS_MAX 16384
+
+// Compressed data is kept only if it saves at least 1/8 of the original size
+#define DNET_CACHE_COMPRESSION_MIN_GAIN 8
+
+// Maximum number of expired objects handled by write-behind pass under one hold of the cache lock
+#define DNET_CACHE_LIFE_CHECK_BATCH 1024
+
 namespace ioremap { namespace cache {
 
 // public:
 
-slru_cache_t::slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n,
-	const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout) :
+static size_t admission_width(const std::vector<size_t> &cache_pages_max_sizes) {
+	size_t size = 0;
+	for (auto it = cache_pages_max_sizes.begin(), end = cache_pages_max_sizes.end(); it != end; ++it) {
+		size += *it;
+	}
+
+	return std::min<size_t>(std::max<size_t>(size / DNET_CACHE_ADMISSION_OBJECT_SIZE, DNET_CACHE_ADMISSION_WIDTH_MIN),
+		DNET_CACHE_ADMISSION_WIDTH_MAX);
+}
+
+slru_cache_t::slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n, const std::shared_ptr<slab_allocator_t> &slab,
+	const std::vector<size_t> &cache_pages_max_sizes, const cache_config &config) :
 	m_backend(backend),
 	m_node(n),
+	m_allocator(slab),
 	m_cache_pages_number(cache_pages_max_sizes.size()),
 	m_cache_pages_max_sizes(cache_pages_max_sizes),
+	m_cache_pages_proportions(config.pages_proportions),
 	m_cache_pages_sizes(m_cache_pages_number, 0),
+	m_evicted_size(0),
 	m_cache_pages_lru(new lru_list_t[m_cache_pages_number]),
+	m_admission(create_admission_policy(config.admission, admission_width(cache_pages_max_sizes))),
+	m_hits(0),
+	m_misses(0),
+	m_codec(create_compression_codec(config.compression)),
+	m_first_compressed_page(m_codec ? m_cache_pages_number - std::min<size_t>(config.compressed_pages, m_cache_pages_number)
+		: m_cache_pages_number),
+	m_compressions_number(0),
+	m_decompressions_number(0),
+	m_compress_time(0),
+	m_decompress_time(0),
+	m_timers(time(NULL)),
 	m_clear_occured(false),
-	m_sync_timeout(sync_timeout) {
-	m_lifecheck = std::thread(std::bind(&slru_cache_t::life_check, this));
+	m_clears_running(0),
+	m_sync_timeout(config.sync_timeout) {
+	m_cache_stats.admission = config.admission;
+	m_cache_stats.compression = config.compression;
 }
 
 slru_cache_t::~slru_cache_t() {
 	TIMER_SCOPE("dtor");
 	dnet_log(m_node, DNET_LOG_NOTICE, "cache: disable: backend: %zu: destructing SLRU cache\n", m_backend->backend_id);
-	m_lifecheck.join();
 	dnet_log(m_node, DNET_LOG_NOTICE, "cache: disable: backend: %zu: clearing\n", m_backend->backend_id);
 	clear();
 	dnet_log(m_node, DNET_LOG_NOTICE, "cache: disable: backend: %zu: destructed\n", m_backend->backend_id);
@@ -78,13 +123,21 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	const bool append = (io->flags & DNET_IO_FLAGS_APPEND);
 
 	TIMER_START("write.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE WRITE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "%s: CACHE WRITE: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("write.lock");
 
+	promote_scheduled();
+
 	TIMER_START("write.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = m_index.find(id);
 	TIMER_STOP("write.find");
 
+	it = decompress_element(guard, id, it);
+
+	if (m_admission && (it || cache)) {
+		m_admission->record(id);
+	}
+
 	if (!it && !cache) {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: not a cache call", dnet_dump_id_str(id));
 		return -ENOTSUP;
@@ -104,12 +157,11 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 				it->set_synctime(time(NULL) + m_sync_timeout);
 
 				if (previous_eventtime != it->eventtime()) {
-					TIMER_SCOPE("write.decrease_key");
-					m_treap.decrease_key(it);
+					TIMER_SCOPE("write.reschedule");
+					m_timers.schedule(it, it->eventtime());
 				}
 			}
 
-			auto &raw = it->data()->data();
 			size_t page_number = it->cache_page_number();
 			size_t new_page_number = page_number;
 			size_t new_size = it->size() + io->size;
@@ -126,7 +178,7 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 				m_cache_stats.size_of_objects_marked_for_deletion -= it->size();
 			}
 			m_cache_stats.size_of_objects -= it->size();
-			raw.insert(raw.end(), data, data + io->size);
+			it->writable_data().append(data, io->size);
 			m_cache_stats.size_of_objects += it->size();
 			if (it->remove_from_cache()) {
 				m_cache_stats.size_of_objects_marked_for_deletion += it->size();
@@ -169,6 +221,14 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 				return err;
 		}
 
+		// New object which is not worth pushing out others is written directly to the backend
+		if (!it && !cache_only && !lifetime && !remove_from_disk &&
+				!(io->flags & (DNET_IO_FLAGS_COMPARE_AND_SWAP | DNET_IO_FLAGS_CAS_TIMESTAMP)) &&
+				!admit(id, size)) {
+			dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: object is not admitted", dnet_dump_id_str(id));
+			return -ENOTSUP;
+		}
+
 		// Create empty data for code simplifyng
 		if (!it) {
 			it = create_data(id, 0, 0, remove_from_disk);
@@ -184,8 +244,10 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 		// Data is already in memory, so it's free to use it
 		// raw.size() is zero only if there is no such file on the server
 		if (raw.size() != 0) {
+			const std::vector<char> buffer = raw.flatten();
+
 			struct dnet_raw_id csum;
-			dnet_transform_node(m_node, raw.data().data(), raw.size(), csum.id, sizeof(csum.id));
+			dnet_transform_node(m_node, buffer.data(), buffer.size(), csum.id, sizeof(csum.id));
 
 			if (memcmp(csum.id, io->parent, DNET_ID_SIZE)) {
 				dnet_log(m_node, DNET_LOG_ERROR, "%s: cas: cache checksum mismatch", dnet_dump_id(&cmd->id));
@@ -242,11 +304,11 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	m_cache_stats.size_of_objects -= it->size();
 
 	TIMER_START("write.modify");
+	raw_data_t &new_raw = it->writable_data();
 	if (append) {
-		raw.data().insert(raw.data().end(), data, data + size);
+		new_raw.append(data, size);
 	} else {
-		raw.data().resize(new_data_size);
-		memcpy(raw.data().data() + io->offset, data, size);
+		new_raw.write(io->offset, data, size);
 	}
 	TIMER_STOP("write.modify");
 	m_cache_stats.size_of_objects += it->size();
@@ -267,15 +329,15 @@ int slru_cache_t::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *c
 	}
 
 	if (previous_eventtime != it->eventtime()) {
-		TIMER_SCOPE("write.decrease_key");
-		m_treap.decrease_key(it);
+		TIMER_SCOPE("write.reschedule");
+		m_timers.schedule(it, it->eventtime());
 	}
 
 	it->set_timestamp(io->timestamp);
 	it->set_user_flags(io->user_flags);
 
 	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-	return dnet_send_file_info_ts_without_fd(st, cmd, raw.data().data() + io->offset, io->size, &io->timestamp);
+	return dnet_send_file_info_ts_without_fd(st, cmd, data, io->size, &io->timestamp);
 }
 
 std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io) {
@@ -285,25 +347,89 @@ std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd
 	const bool cache_only = (io->flags & DNET_IO_FLAGS_CACHE_ONLY);
 	(void) cmd;
 
+	{
+		TIMER_START("read.shared_lock");
+		boost::shared_lock<boost::shared_mutex> guard(m_lock);
+		TIMER_STOP("read.shared_lock");
+
+		TIMER_START("read.find");
+		data_t* it = m_index.find(id);
+		TIMER_STOP("read.find");
+
+		// Cache hit is served under shared lock, object is only marked as referenced
+		// and promoted to hotter page later by the next exclusive lock holder
+		if (m_admission) {
+			m_admission->record(id);
+		}
+
+		if (it && !it->only_append() && !it->remove_from_cache() && !it->is_removed_from_page() && !it->compressed()) {
+			m_hits.fetch_add(1, std::memory_order_relaxed);
+			it->set_referenced(true);
+			if (it->cache_page_number() != get_next_page_number(it->cache_page_number())) {
+				schedule_promotion(id);
+			}
+
+			io->timestamp = it->timestamp();
+			io->user_flags = it->user_flags();
+			return it->data();
+		}
+
+		if (!it && !(cache && !cache_only)) {
+			m_misses.fetch_add(1, std::memory_order_relaxed);
+			return std::shared_ptr<raw_data_t>();
+		}
+	}
+
 	TIMER_START("read.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE READ: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "%s: CACHE READ: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("read.lock");
 
+	promote_scheduled();
+
 	bool new_page = false;
 
 	TIMER_START("read.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = m_index.find(id);
 	TIMER_STOP("read.find");
 
+	it = decompress_element(guard, id, it);
+
 	if (it && it->only_append()) {
 		sync_after_append(guard, true, &*it);
 		it = NULL;
 	}
 
+	if (it) {
+		m_hits.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		m_misses.fetch_add(1, std::memory_order_relaxed);
+	}
+
 	if (!it && cache && !cache_only) {
-		int err = 0;
-		it = populate_from_disk(guard, id, false, &err);
-		new_page = true;
+		ioremap::elliptics::data_pointer data;
+		uint64_t user_flags = 0;
+		dnet_time timestamp;
+
+		int err = read_from_disk(guard, id, data, &user_flags, &timestamp);
+		if (err) {
+			return std::shared_ptr<raw_data_t>();
+		}
+
+		// Object could be created while the lock was released
+		it = m_index.find(id);
+		if (!it) {
+			// Object which is not worth pushing out others is served without caching
+			if (!admit(id, data.size())) {
+				io->timestamp = timestamp;
+				io->user_flags = user_flags;
+				return std::make_shared<raw_data_t>(reinterpret_cast<char *>(data.data()), data.size());
+			}
+
+			it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), false);
+			it->set_user_flags(user_flags);
+			it->set_timestamp(timestamp);
+			new_page = true;
+		}
 	}
 
 	if (it) {
@@ -337,11 +463,11 @@ int slru_cache_t::remove(const unsigned char *id, dnet_io_attr *io) {
 	int err = -ENOENT;
 
 	TIMER_START("remove.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE REMOVE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "%s: CACHE REMOVE: %p", dnet_dump_id_str(id), this);
 	TIMER_STOP("remove.lock");
 
 	TIMER_START("remove.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = m_index.find(id);
 	TIMER_STOP("remove.find");
 
 	if (it) {
@@ -353,8 +479,8 @@ int slru_cache_t::remove(const unsigned char *id, dnet_io_attr *io) {
 			it->clear_synctime();
 
 			if (previous_eventtime != it->eventtime()) {
-				TIMER_SCOPE("remove.decrease_key");
-				m_treap.decrease_key(it);
+				TIMER_SCOPE("remove.reschedule");
+				m_timers.schedule(it, it->eventtime());
 			}
 		}
 		if (it->is_syncing()) {
@@ -388,11 +514,11 @@ int slru_cache_t::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 	int err = 0;
 
 	TIMER_START("lookup.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE LOOKUP: %p", dnet_dump_id_str(id), this);
+	boost::shared_lock<boost::shared_mutex> guard(m_lock);
 	TIMER_STOP("lookup.lock");
 
 	TIMER_START("lookup.find");
-	data_t* it = m_treap.find(id);
+	data_t* it = m_index.find(id);
 	TIMER_STOP("lookup.find");
 
 	if (!it) {
@@ -428,40 +554,219 @@ int slru_cache_t::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 void slru_cache_t::clear() {
 	TIMER_SCOPE("clear");
 
-	std::vector<size_t> cache_pages_max_sizes = m_cache_pages_max_sizes;
-
 	TIMER_START("clear.lock");
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE CLEAR: %p", this);
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE CLEAR: %p", this);
 	TIMER_STOP("clear.lock");
 	m_clear_occured = true;
 
+	// budgets are read under the lock, rebalancing changes them at runtime
+	if (!m_clears_running++)
+		m_clear_max_sizes = m_cache_pages_max_sizes;
+
 	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
 		m_cache_pages_max_sizes[page_number] = 0;
 		resize_page((unsigned char *) "", page_number, 0);
 	}
 
-	while (!m_treap.empty()) {
-		data_t *obj = m_treap.top();
+	/*
+	 * Objects taken by write-behind are left for the end: syncing them releases the lock,
+	 * and nobody else erases them meanwhile, so pointers collected before stay valid.
+	 * New objects may be added while the lock is released, they are handled by the next round.
+	 */
+	std::vector<data_t *> objects;
+	while (!m_index.empty()) {
+		objects.clear();
+		m_index.for_each([&objects] (data_t *obj) {
+			objects.push_back(obj);
+		});
+
+		auto syncing = std::partition(objects.begin(), objects.end(), [] (data_t *obj) {
+			return !obj->is_syncing();
+		});
+
+		for (auto it = objects.begin(); it != objects.end(); ++it) {
+			data_t *obj = *it;
+
+			if (it >= syncing)
+				sync_if_required(obj, guard);
+			obj->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
+
+			erase_element(obj);
+		}
+	}
+
+	if (!--m_clears_running)
+		m_cache_pages_max_sizes = m_clear_max_sizes;
+}
+
+snapshot_section_t slru_cache_t::snapshot() {
+	TIMER_SCOPE("snapshot");
+
+	snapshot_section_t objects;
+	// compressed objects are decompressed without lock
+	std::vector<size_t> compressed;
+
+	{
+		TIMER_START("snapshot.lock");
+		boost::shared_lock<boost::shared_mutex> guard(m_lock);
+		TIMER_STOP("snapshot.lock");
+
+		for (size_t page_number = m_cache_pages_number; page_number-- > 0;) {
+			for (auto it = m_cache_pages_lru[page_number].begin(), end = m_cache_pages_lru[page_number].end(); it != end; ++it) {
+				// dirty objects may be lost before they are synced, so disk would have older version,
+				// objects with lifetime or marked for removal would outlive their deadline
+				if (it->synctime() || it->is_syncing() || it->lifetime() || it->only_append() ||
+						it->remove_from_cache() || it->remove_from_disk()) {
+					continue;
+				}
+
+				if (it->compressed()) {
+					compressed.push_back(objects.size());
+				}
+
+				objects.emplace_back();
+				snapshot_object &object = objects.back();
+				object.id = it->id();
+				object.page = page_number;
+				object.timestamp = it->timestamp();
+				object.user_flags = it->user_flags();
+				object.data = it->data();
+			}
+		}
+	}
+
+	for (auto it = compressed.begin(); it != compressed.end(); ++it) {
+		snapshot_object &object = objects[*it];
+		object.data = decompress(object.data);
+	}
 
-		sync_if_required(obj, guard);
-		obj->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
+	return objects;
+}
 
-		erase_element(obj);
+bool slru_cache_t::restore(const snapshot_entry &entry, const char *data) {
+	TIMER_SCOPE("restore");
+
+	TIMER_START("restore.lock");
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "%s: CACHE RESTORE: %p", dnet_dump_id_str(entry.id.id), this);
+	TIMER_STOP("restore.lock");
+
+	if (m_index.find(entry.id.id)) {
+		return false;
 	}
 
-	m_cache_pages_max_sizes = cache_pages_max_sizes;
+	// number of pages could be changed since snapshot was written
+	const size_t last_page_number = m_cache_pages_number - 1;
+	const size_t page_number = std::min<size_t>(entry.page, last_page_number);
+
+	data_t *it = create_data(entry.id.id, data, entry.size, false);
+	it->set_user_flags(entry.user_flags);
+	it->set_timestamp(entry.timestamp);
+
+	move_data_between_pages(entry.id.id, last_page_number, page_number, it);
+
+	if (page_number >= m_first_compressed_page)
+		schedule_compression(it);
+	return true;
 }
 
 cache_stats slru_cache_t::get_cache_stats() const {
 	m_cache_stats.pages_sizes = m_cache_pages_sizes;
 	m_cache_stats.pages_max_sizes = m_cache_pages_max_sizes;
+	m_cache_stats.hits = m_hits.load(std::memory_order_relaxed);
+	m_cache_stats.misses = m_misses.load(std::memory_order_relaxed);
+	m_cache_stats.compressions = m_compressions_number.load(std::memory_order_relaxed);
+	m_cache_stats.decompressions = m_decompressions_number.load(std::memory_order_relaxed);
+	m_cache_stats.compress_time = m_compress_time.load(std::memory_order_relaxed);
+	m_cache_stats.decompress_time = m_decompress_time.load(std::memory_order_relaxed);
 	return m_cache_stats;
 }
 
+shard_usage slru_cache_t::take_usage() {
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE USAGE: %p", this);
+
+	shard_usage usage;
+	usage.max_size = 0;
+	usage.size = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		usage.max_size += m_cache_pages_max_sizes[i];
+		usage.size += m_cache_pages_sizes[i];
+	}
+	usage.evicted = m_evicted_size;
+	m_evicted_size = 0;
+	return usage;
+}
+
+void slru_cache_t::set_max_size(size_t max_size) {
+	TIMER_SCOPE("set_max_size");
+
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE SET MAX SIZE: %p", this);
+
+	size_t proportions_sum = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		proportions_sum += m_cache_pages_proportions[i];
+	}
+
+	// cache is being cleared with zero budgets and the lock released while syncing, new budgets are applied after it
+	if (m_clears_running) {
+		for (size_t i = 0; i < m_cache_pages_number; ++i) {
+			m_clear_max_sizes[i] = max_size * (m_cache_pages_proportions[i] * 1.0 / proportions_sum);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		m_cache_pages_max_sizes[i] = max_size * (m_cache_pages_proportions[i] * 1.0 / proportions_sum);
+	}
+
+	// objects evicted here do not count as lack of space, otherwise shrunk shard would grow back
+	const size_t evicted_size = m_evicted_size;
+
+	// hotter pages are shrunk first, objects demoted from them are evicted from colder pages
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		if (m_cache_pages_sizes[i] > m_cache_pages_max_sizes[i] && !m_cache_pages_lru[i].empty()) {
+			// id is copied, the object itself may be evicted
+			const dnet_raw_id id = m_cache_pages_lru[i].front().id();
+			resize_page(id.id, i, 0);
+		}
+	}
+
+	m_evicted_size = evicted_size;
+}
+
 // private:
 
+void slru_cache_t::schedule_promotion(const unsigned char *id) {
+	std::unique_lock<std::mutex> guard(m_promotions_lock, std::try_to_lock);
+	if (!guard.owns_lock() || m_promotions.size() >= DNET_CACHE_PROMOTIONS_MAX) {
+		return;
+	}
+
+	m_promotions.emplace_back();
+	memcpy(m_promotions.back().id, id, DNET_ID_SIZE);
+}
+
+void slru_cache_t::promote_scheduled() {
+	TIMER_SCOPE("promote_scheduled");
+
+	std::vector<dnet_raw_id> promotions;
+	{
+		std::unique_lock<std::mutex> guard(m_promotions_lock);
+		promotions.swap(m_promotions);
+	}
+
+	for (auto it = promotions.begin(), end = promotions.end(); it != end; ++it) {
+		data_t *data = m_index.find(it->id);
+		// compressed object is decompressed and promoted by the next read
+		if (!data || data->is_removed_from_page() || data->compressed()) {
+			continue;
+		}
 
-void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex> &guard) {
+		size_t page_number = data->cache_page_number();
+		move_data_between_pages(it->id, page_number, get_next_page_number(page_number), data);
+	}
+}
+
+void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<boost::shared_mutex> &guard) {
 	TIMER_SCOPE("sync_if_required");
 
 	if (it && it->is_syncing()) {
@@ -469,12 +774,12 @@ void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex
 		memset(&id, 0, sizeof(id));
 		memcpy(id.id, it->id().id, DNET_ID_SIZE);
 
-		std::vector<char> data;
+		std::shared_ptr<raw_data_t> data;
 		uint64_t user_flags;
 		dnet_time timestamp;
 
 		bool only_append = it->only_append();
-		data = it->data()->data();
+		data = it->data();
 		user_flags = it->user_flags();
 		timestamp = it->timestamp();
 
@@ -482,7 +787,7 @@ void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex
 
 		// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
 		if (it->is_syncing()) {
-			sync_element(id, only_append, data, user_flags, timestamp);
+			sync_element(id, only_append, *data, user_flags, timestamp);
 			it->set_sync_state(data_t::sync_state_t::ERASE_PHASE);
 		}
 
@@ -490,6 +795,84 @@ void slru_cache_t::sync_if_required(data_t* it, elliptics_unique_lock<std::mutex
 	}
 }
 
+void slru_cache_t::schedule_compression(data_t *obj) {
+	if (obj->compressed() || m_compressions.size() >= DNET_CACHE_COMPRESSIONS_MAX) {
+		return;
+	}
+
+	m_compressions.push_back(obj->id());
+}
+
+/*
+ * Only clean objects are compressed: dirty ones are going to be written to the backend
+ * and then to be erased or modified, so compressing them is a waste of time
+ */
+bool slru_cache_t::can_be_compressed(data_t *obj) const {
+	return !obj->compressed() && obj->cache_page_number() >= m_first_compressed_page &&
+		!obj->synctime() && !obj->will_be_erased() && !obj->only_append() &&
+		!obj->remove_from_cache() && !obj->is_removed_from_page();
+}
+
+std::shared_ptr<raw_data_t> slru_cache_t::decompress(const std::shared_ptr<raw_data_t> &data) {
+	TIMER_SCOPE("decompress");
+
+	elliptics_timer timer;
+
+	auto raw = std::allocate_shared<raw_data_t>(cache_allocator<raw_data_t>(m_allocator), nullptr, 0, m_allocator);
+	m_codec->decompress(*data, *raw);
+
+	m_decompress_time.fetch_add(timer.elapsed<std::chrono::microseconds>(), std::memory_order_relaxed);
+	m_decompressions_number.fetch_add(1, std::memory_order_relaxed);
+	return raw;
+}
+
+/*
+ * Data is decompressed with the lock released, so object is looked up again after that,
+ * it could be erased or replaced meanwhile. Returns object found by @id.
+ */
+data_t* slru_cache_t::decompress_element(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id, data_t *obj) {
+	while (obj && obj->compressed()) {
+		std::shared_ptr<raw_data_t> data = obj->data();
+
+		guard.unlock();
+		std::shared_ptr<raw_data_t> raw = decompress(data);
+		guard.lock();
+
+		obj = m_index.find(id);
+		if (obj && obj->data() == data) {
+			replace_data(obj, raw, false, 0);
+		}
+	}
+
+	return obj;
+}
+
+void slru_cache_t::replace_data(data_t *obj, const std::shared_ptr<raw_data_t> &data, bool compressed, size_t raw_size) {
+	const size_t page_number = obj->cache_page_number();
+
+	if (obj->compressed()) {
+		m_cache_stats.compressed_objects--;
+		m_cache_stats.compressed_size -= obj->capacity();
+		m_cache_stats.compressed_raw_size -= obj->raw_size();
+	}
+	m_cache_pages_sizes[page_number] -= obj->size();
+	m_cache_stats.size_of_objects -= obj->size();
+
+	if (compressed) {
+		obj->set_compressed_data(data, raw_size);
+	} else {
+		obj->set_data(data);
+	}
+
+	m_cache_pages_sizes[page_number] += obj->size();
+	m_cache_stats.size_of_objects += obj->size();
+	if (obj->compressed()) {
+		m_cache_stats.compressed_objects++;
+		m_cache_stats.compressed_size += obj->capacity();
+		m_cache_stats.compressed_raw_size += obj->raw_size();
+	}
+}
+
 void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_number, data_t *data) {
 	TIMER_SCOPE("add_to_page");
 
@@ -504,6 +887,7 @@ void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_nu
 	}
 
 	data->set_cache_page_number(page_number);
+	data->set_referenced(false);
 	m_cache_pages_lru[page_number].push_back(*data);
 	m_cache_pages_sizes[page_number] += size;
 }
@@ -531,18 +915,49 @@ data_t* slru_cache_t::create_data(const unsigned char *id, const char *data, siz
 
 	size_t last_page_number = m_cache_pages_number - 1;
 
-	data_t *raw = new data_t(id, 0, data, size, remove_from_disk);
+	cache_allocator<data_t> allocator(m_allocator);
+	data_t *raw = allocator.allocate(1);
+	try {
+		allocator.construct(raw, id, 0, data, size, remove_from_disk, m_allocator);
+	} catch (...) {
+		allocator.deallocate(raw, 1);
+		throw;
+	}
 
 	insert_data_into_page(id, last_page_number, raw);
 
 	m_cache_stats.number_of_objects++;
 	m_cache_stats.size_of_objects += raw->size();
-	m_treap.insert(raw);
+	m_timers.schedule(raw, raw->eventtime());
+	m_index.insert(raw);
 	return raw;
 }
 
-data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err) {
-	TIMER_SCOPE("populate_from_disk");
+bool slru_cache_t::admit(const unsigned char *id, size_t size) {
+	if (!m_admission) {
+		return true;
+	}
+
+	// New objects are placed into the last page, so they compete with the coldest object of that page
+	const size_t last_page_number = m_cache_pages_number - 1;
+	lru_list_t &lru = m_cache_pages_lru[last_page_number];
+
+	if (lru.empty() || m_cache_pages_sizes[last_page_number] + size <= m_cache_pages_max_sizes[last_page_number]) {
+		return true;
+	}
+
+	if (m_admission->admit(id, lru.front().id().id)) {
+		m_cache_stats.admitted++;
+		return true;
+	}
+
+	m_cache_stats.rejected++;
+	return false;
+}
+
+int slru_cache_t::read_from_disk(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id,
+		ioremap::elliptics::data_pointer &data, uint64_t *user_flags, dnet_time *timestamp) {
+	TIMER_SCOPE("read_from_disk");
 
 	if (guard.owns_lock()) {
 		guard.unlock();
@@ -555,17 +970,30 @@ data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guar
 	memset(&raw_id, 0, sizeof(raw_id));
 	memcpy(raw_id.id, id, DNET_ID_SIZE);
 
-	uint64_t user_flags = 0;
-	dnet_time timestamp;
-	dnet_empty_time(&timestamp);
+	*user_flags = 0;
+	dnet_empty_time(timestamp);
+
+	int err = 0;
 
-	TIMER_START("populate_from_disk.local_read");
-	ioremap::elliptics::data_pointer data = sess.read(raw_id, &user_flags, &timestamp, err);
-	TIMER_STOP("populate_from_disk.local_read");
+	TIMER_START("read_from_disk.local_read");
+	data = sess.read(raw_id, user_flags, timestamp, &err);
+	TIMER_STOP("read_from_disk.local_read");
 
-	TIMER_START("populate_from_disk.lock");
+	TIMER_START("read_from_disk.lock");
 	guard.lock();
-	TIMER_STOP("populate_from_disk.lock");
+	TIMER_STOP("read_from_disk.lock");
+
+	return err;
+}
+
+data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err) {
+	TIMER_SCOPE("populate_from_disk");
+
+	ioremap::elliptics::data_pointer data;
+	uint64_t user_flags = 0;
+	dnet_time timestamp;
+
+	*err = read_from_disk(guard, id, data, &user_flags, &timestamp);
 
 	if (*err == 0) {
 		auto it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), remove_from_disk);
@@ -598,9 +1026,20 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 		data_t *raw = &*it;
 		++it;
 
+		// Object was hit since it was placed into the page, give it second chance
+		if (raw->referenced()) {
+			raw->set_referenced(false);
+			m_cache_pages_lru[page_number].erase(m_cache_pages_lru[page_number].iterator_to(*raw));
+			m_cache_pages_lru[page_number].push_back(*raw);
+			continue;
+		}
+
 		// If page is not last move object to previous page
 		if (previous_page_number < m_cache_pages_number) {
 			move_data_between_pages(id, page_number, previous_page_number, raw);
+
+			if (previous_page_number >= m_first_compressed_page)
+				schedule_compression(raw);
 		} else {
 			if (raw->synctime() || raw->remove_from_cache()) {
 				if (!raw->remove_from_cache()) {
@@ -611,14 +1050,16 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 					size_t previous_eventtime = raw->eventtime();
 					raw->set_synctime(1);
 					if (previous_eventtime != raw->eventtime()) {
-						TIMER_SCOPE("resize_page.decrease_key");
-						m_treap.decrease_key(raw);
+						TIMER_SCOPE("resize_page.reschedule");
+						m_timers.schedule(raw, raw->eventtime());
 					}
 				}
 				removed_size += raw->size();
+				m_evicted_size += raw->size();
 				m_cache_pages_lru[page_number].erase(m_cache_pages_lru[page_number].iterator_to(*raw));
 				raw->set_removed_from_page(true);
 			} else {
+				m_evicted_size += raw->size();
 				erase_element(raw);
 			}
 		}
@@ -639,9 +1080,16 @@ void slru_cache_t::erase_element(data_t *obj) {
 	m_cache_stats.number_of_objects--;
 	m_cache_stats.size_of_objects -= obj->size();
 
+	if (obj->compressed()) {
+		m_cache_stats.compressed_objects--;
+		m_cache_stats.compressed_size -= obj->capacity();
+		m_cache_stats.compressed_raw_size -= obj->raw_size();
+	}
+
 	size_t page_number = obj->cache_page_number();
 	remove_data_from_page(obj->id().id, page_number, obj);
-	m_treap.erase(obj);
+	m_timers.cancel(obj);
+	m_index.erase(obj);
 
 	if (obj->synctime()) {
 		sync_element(obj);
@@ -653,21 +1101,38 @@ void slru_cache_t::erase_element(data_t *obj) {
 		m_cache_stats.size_of_objects_marked_for_deletion -= obj->size();
 	}
 
-	delete obj;
+	cache_allocator<data_t> allocator(m_allocator);
+	allocator.destroy(obj);
+	allocator.deallocate(obj, 1);
 }
 
-void slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp) {
+int slru_cache_t::sync_element(local_session &sess, const dnet_id &raw, bool after_append, const raw_data_t &data,
+		uint64_t user_flags, const dnet_time &timestamp) {
 	HANDY_TIMER_SCOPE("slru_cache.sync_element");
 
-	local_session sess(m_backend, m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | (after_append ? DNET_IO_FLAGS_APPEND : 0));
 
-	int err = sess.write(raw, data.data(), data.size(), user_flags, timestamp);
+	// backend is written by one buffer, so chunks of large object are gathered
+	std::vector<char> buffer;
+	const char *contiguous = data.contiguous(0, data.size());
+	if (!contiguous) {
+		buffer = data.flatten();
+		contiguous = buffer.data();
+	}
+
+	int err = sess.write(raw, contiguous, data.size(), user_flags, timestamp);
 	if (err) {
 		dnet_log(m_node, DNET_LOG_ERROR, "%s: CACHE: forced to sync to disk, err: %d", dnet_dump_id_str(raw.id), err);
 	} else {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: forced to sync to disk, err: %d", dnet_dump_id_str(raw.id), err);
 	}
+
+	return err;
+}
+
+void slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const raw_data_t &data, uint64_t user_flags, const dnet_time &timestamp) {
+	local_session sess(m_backend, m_node);
+	sync_element(sess, raw, after_append, data, user_flags, timestamp);
 }
 
 void slru_cache_t::sync_element(data_t *obj) {
@@ -675,12 +1140,10 @@ void slru_cache_t::sync_element(data_t *obj) {
 	memset(&raw, 0, sizeof(struct dnet_id));
 	memcpy(raw.id, obj->id().id, DNET_ID_SIZE);
 
-	auto &data = obj->data()->data();
-
-	sync_element(raw, obj->only_append(), data, obj->user_flags(), obj->timestamp());
+	sync_element(raw, obj->only_append(), *obj->data(), obj->user_flags(), obj->timestamp());
 }
 
-void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj) {
+void slru_cache_t::sync_after_append(elliptics_unique_lock<boost::shared_mutex> &guard, bool lock_guard, data_t *obj) {
 	TIMER_SCOPE("sync_after_append");
 
 	std::shared_ptr<raw_data_t> raw_data = obj->data();
@@ -699,12 +1162,9 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 	guard.unlock();
 
 	local_session sess(m_backend, m_node);
-	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | DNET_IO_FLAGS_APPEND);
-
-	auto &raw = raw_data->data();
 
 	TIMER_START("sync_after_append.local_write");
-	int err = sess.write(id, raw.data(), raw.size(), user_flags, timestamp);
+	int err = sync_element(sess, id, true, *raw_data, user_flags, timestamp);
 	TIMER_STOP("sync_after_append.local_write");
 
 	TIMER_START("sync_after_append.lock");
@@ -715,119 +1175,176 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 	dnet_log(m_node, DNET_LOG_INFO, "%s: CACHE: sync after append, err: %d", dnet_dump_id_str(id.id), err);
 }
 
-void slru_cache_t::life_check(void) {
+void slru_cache_t::prepare_sync(write_behind_pass &pass, std::vector<write_behind_item> &items) {
+	TIMER_SCOPE("life_check");
 
-	dnet_set_name("dnet_cache_%zu", m_backend->backend_id);
+	dnet_id id;
+	memset(&id, 0, sizeof(id));
 
-	while (!need_exit()) {
-		{
-			TIMER_SCOPE("life_check");
+	const size_t time = ::time(NULL);
+	pass.last_time = time;
+
+	/*
+	 * Expired objects are taken by batches, lock is released between them,
+	 * so a lot of objects expiring at once do not stall cache requests
+	 */
+	for (bool first_batch = true; !need_exit(); first_batch = false) {
+		TIMER_START("life_check.lock");
+		elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE LIFE: %p", this);
+		TIMER_STOP("life_check.lock");
+
+		if (first_batch) {
+			promote_scheduled();
+			m_clear_occured = false;
+		}
 
-			std::deque<struct dnet_id> remove;
-			std::deque<data_t*> elements_for_sync;
-			size_t last_time = 0;
-			dnet_id id;
-			memset(&id, 0, sizeof(id));
+		TIMER_SCOPE("life_check.prepare_sync");
+		for (size_t batch = 0; batch < DNET_CACHE_LIFE_CHECK_BATCH; ++batch) {
+			data_t* it = m_timers.pop_expired(time);
+			if (!it)
+				return;
+
+			if (it->eventtime() > time) {
+				m_timers.schedule(it, it->eventtime());
+			} else if (it->eventtime() == it->lifetime()) {
+				if (it->remove_from_disk()) {
+					memset(&id, 0, sizeof(struct dnet_id));
+					dnet_setup_id(&id, 0, (unsigned char *)it->id().id);
+					pass.remove.push_back(id);
+				}
 
-			{
-				TIMER_START("life_check.lock");
-				elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE LIFE: %p", this);
-				TIMER_STOP("life_check.lock");
+				erase_element(it);
+			} else if (it->eventtime() == it->synctime()) {
+				pass.objects.push_back(it);
+
+				items.emplace_back();
+				write_behind_item &item = items.back();
+				item.cache = this;
+				item.object = it;
+				memset(&item.id, 0, sizeof(item.id));
+				memcpy(item.id.id, it->id().id, DNET_ID_SIZE);
+				item.only_append = it->only_append();
+				item.user_flags = it->user_flags();
+				item.timestamp = it->timestamp();
+				item.data = it->data();
+
+				it->clear_synctime();
+				it->set_sync_state(data_t::sync_state_t::SYNC_PHASE);
+
+				TIMER_SCOPE("life_check.reschedule");
+				m_timers.schedule(it, it->eventtime());
+			}
+		}
+	}
+}
 
-				TIMER_SCOPE("life_check.prepare_sync");
-				while (!need_exit() && !m_treap.empty()) {
-					size_t time = ::time(NULL);
-					last_time = time;
+bool slru_cache_t::sync_prepared(local_session &sess, const write_behind_item &item, int *err) {
+	if (m_clear_occured)
+		return false;
 
-					if (m_treap.empty())
-						break;
+	dnet_id id = item.id;
 
-					data_t* it = m_treap.top();
-					if (it->eventtime() > time)
-						break;
+	TIMER_START("life_check.sync_iterate.dnet_oplock");
+	dnet_oplock(m_backend, &id);
+	TIMER_STOP("life_check.sync_iterate.dnet_oplock");
 
-					if (it->eventtime() == it->lifetime())
-					{
-						if (it->remove_from_disk()) {
-							memset(&id, 0, sizeof(struct dnet_id));
-							dnet_setup_id(&id, 0, (unsigned char *)it->id().id);
-							remove.push_back(id);
-						}
+	// object could be synced by clear() or removed meanwhile
+	bool synced = item.object->is_syncing();
+	if (synced) {
+		*err = sync_element(sess, id, item.only_append, *item.data, item.user_flags, item.timestamp);
+		item.object->set_sync_state(data_t::sync_state_t::ERASE_PHASE);
+	}
 
-						erase_element(it);
-					}
-					else if (it->eventtime() == it->synctime())
-					{
-						elements_for_sync.push_back(it);
-
-						size_t previous_eventtime = it->eventtime();
-						it->clear_synctime();
-						it->set_sync_state(data_t::sync_state_t::SYNC_PHASE);
-
-						if (previous_eventtime != it->eventtime()) {
-							TIMER_SCOPE("life_check.decrease_key");
-							m_treap.decrease_key(it);
-						}
-					}
+	dnet_opunlock(m_backend, &id);
+	return synced;
+}
+
+void slru_cache_t::complete_sync(const write_behind_pass &pass) {
+	TIMER_START("life_check.lock");
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE CLEAR PAGES: %p", this);
+	TIMER_STOP("life_check.lock");
+
+	// objects of the pass were already synced and erased by clear()
+	if (!m_clear_occured) {
+		TIMER_SCOPE("life_check.erase_iterate");
+		for (auto it = pass.objects.begin(); it != pass.objects.end(); ++it) {
+			data_t *elem = *it;
+			elem->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
+			if (elem->synctime() <= pass.last_time) {
+				if (elem->only_append() || elem->remove_from_cache()) {
+					erase_element(elem);
 				}
 			}
+		}
+	}
+}
 
-			{
-				TIMER_SCOPE("life_check.sync_iterate");
-				HANDY_GAUGE_SET("slru_cache.life_check.sync_iterate.element_count", elements_for_sync.size());
-				for (auto it = elements_for_sync.begin(); it != elements_for_sync.end(); ++it) {
-					if (m_clear_occured)
-						break;
+void slru_cache_t::compress_demoted() {
+	if (!m_codec) {
+		return;
+	}
 
-					data_t *elem = *it;
-					memcpy(id.id, elem->id().id, DNET_ID_SIZE);
+	TIMER_SCOPE("compress");
 
-					TIMER_START("life_check.sync_iterate.dnet_oplock");
-					dnet_oplock(m_backend, &id);
-					TIMER_STOP("life_check.sync_iterate.dnet_oplock");
+	struct compression_item {
+		dnet_raw_id id;
+		std::shared_ptr<raw_data_t> data;
+		std::shared_ptr<raw_data_t> compressed;
+	};
 
-					// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
-					if (elem->is_syncing()) {
-						sync_element(id, elem->only_append(), elem->data()->data(), elem->user_flags(), elem->timestamp());
-						elem->set_sync_state(data_t::sync_state_t::ERASE_PHASE);
-					}
+	std::vector<compression_item> items;
+	{
+		TIMER_START("compress.lock");
+		elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE COMPRESS: %p", this);
+		TIMER_STOP("compress.lock");
 
-					dnet_opunlock(m_backend, &id);
-				}
-			}
+		std::vector<dnet_raw_id> ids;
+		ids.swap(m_compressions);
 
-			{
-				TIMER_SCOPE("life_check.remove_local");
-				for (std::deque<struct dnet_id>::iterator it = remove.begin(); it != remove.end(); ++it) {
-					dnet_remove_local(m_backend, m_node, &(*it));
-				}
+		for (auto it = ids.begin(); it != ids.end(); ++it) {
+			data_t *obj = m_index.find(it->id);
+			if (!obj || !can_be_compressed(obj)) {
+				continue;
 			}
 
-			{
-				TIMER_START("life_check.lock");
-				elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE CLEAR PAGES: %p", this);
-				TIMER_STOP("life_check.lock");
-
-				if (!m_clear_occured) {
-					TIMER_SCOPE("life_check.erase_iterate");
-					for (std::deque<data_t*>::iterator it = elements_for_sync.begin(); it != elements_for_sync.end(); ++it) {
-						data_t *elem = *it;
-						elem->set_sync_state(data_t::sync_state_t::NOT_SYNCING);
-						if (elem->synctime() <= last_time) {
-							if (elem->only_append() || elem->remove_from_cache()) {
-								erase_element(elem);
-							}
-						}
-					}
-				} else {
-					m_clear_occured = false;
-				}
-			}
+			items.emplace_back();
+			items.back().id = *it;
+			items.back().data = obj->data();
 		}
+	}
+
+	if (items.empty()) {
+		return;
+	}
+
+	for (auto it = items.begin(); it != items.end(); ++it) {
+		elliptics_timer timer;
+
+		auto compressed = std::allocate_shared<raw_data_t>(cache_allocator<raw_data_t>(m_allocator), nullptr, 0, m_allocator);
+		m_codec->compress(*it->data, *compressed);
 
-		std::this_thread::sleep_for( std::chrono::milliseconds(1000) );
+		if (compressed->size() + it->data->size() / DNET_CACHE_COMPRESSION_MIN_GAIN <= it->data->size()) {
+			compressed->shrink_to_fit();
+			it->compressed = compressed;
+		}
+
+		m_compress_time.fetch_add(timer.elapsed<std::chrono::microseconds>(), std::memory_order_relaxed);
+		m_compressions_number.fetch_add(1, std::memory_order_relaxed);
 	}
 
+	TIMER_START("compress.lock");
+	elliptics_unique_lock<boost::shared_mutex> guard(m_lock, m_node, "CACHE COMPRESS: %p", this);
+	TIMER_STOP("compress.lock");
+
+	// object could be modified, promoted or erased while it was compressed
+	for (auto it = items.begin(); it != items.end(); ++it) {
+		data_t *obj = m_index.find(it->id.id);
+		if (!it->compressed || !obj || obj->data() != it->data || !can_be_compressed(obj)) {
+			continue;
+		}
+
+		replace_data(obj, it->compressed, true, it->data->size());
+	}
 }
 
 }}
@@ -18,12 +18,16 @@
 #define SLRU_CACHE_HPP
 
 #include "cache.hpp"
+#include "write_behind.hpp"
+
+#include <boost/thread/shared_mutex.hpp>
 
 namespace ioremap { namespace cache {
 
 class slru_cache_t {
 public:
-	slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes, unsigned sync_timeout);
+	slru_cache_t(struct dnet_backend_io *backend, struct dnet_node *n, const std::shared_ptr<slab_allocator_t> &slab,
+		const std::vector<size_t> &cache_pages_max_sizes, const cache_config &config);
 
 	~slru_cache_t();
 
@@ -37,20 +41,71 @@ public:
 
 	void clear();
 
+	// returns clean objects of the cache from the coldest to the hottest one
+	snapshot_section_t snapshot();
+
+	// puts object read from snapshot into @page, returns false if object is already cached
+	bool restore(const snapshot_entry &entry, const char *data);
+
+	/*
+	 * Write-behind pass: erases objects whose lifetime has come and takes objects
+	 * whose sync time has come into @pass and @items
+	 */
+	void prepare_sync(write_behind_pass &pass, std::vector<write_behind_item> &items);
+
+	// writes object taken by @prepare_sync() to the backend, returns false if object does not need sync anymore
+	bool sync_prepared(local_session &sess, const write_behind_item &item, int *err);
+
+	// releases objects of @pass after they are synced
+	void complete_sync(const write_behind_pass &pass);
+
+	// compresses objects demoted into the compressed pages since the previous call
+	void compress_demoted();
+
+	// returns memory budget and size of the shard and resets counter of evicted objects
+	shard_usage take_usage();
+
+	// changes memory budget of the shard keeping proportions of pages, evicts objects which do not fit anymore
+	void set_max_size(size_t max_size);
+
 	cache_stats get_cache_stats() const;
 
 private:
 	struct dnet_backend_io *m_backend;
 	struct dnet_node *m_node;
-	std::mutex m_lock;
+	cache_allocator<char> m_allocator;
+	boost::shared_mutex m_lock;
 	size_t m_cache_pages_number;
 	std::vector<size_t> m_cache_pages_max_sizes;
+	std::vector<size_t> m_cache_pages_proportions;
 	std::vector<size_t> m_cache_pages_sizes;
+	// size of objects evicted from the last page since the previous @take_usage()
+	size_t m_evicted_size;
 	std::unique_ptr<lru_list_t[]> m_cache_pages_lru;
-	std::thread m_lifecheck;
-	treap_t m_treap;
+	hash_index_t m_index;
+	std::mutex m_promotions_lock;
+	std::vector<dnet_raw_id> m_promotions;
+	std::unique_ptr<admission_policy_t> m_admission;
+	// hits are counted under shared lock
+	std::atomic<size_t> m_hits;
+	std::atomic<size_t> m_misses;
+	std::unique_ptr<compression_codec_t> m_codec;
+	// objects demoted into pages starting from this one are compressed
+	size_t m_first_compressed_page;
+	std::vector<dnet_raw_id> m_compressions;
+	// codec is called without lock
+	std::atomic<size_t> m_compressions_number;
+	std::atomic<size_t> m_decompressions_number;
+	std::atomic<size_t> m_compress_time;
+	std::atomic<size_t> m_decompress_time;
 	mutable cache_stats m_cache_stats;
-	bool m_clear_occured;
+	// lifetime and sync deadlines of objects
+	timer_wheel_t m_timers;
+	// set by clear(), objects taken by write-behind pass are not valid anymore
+	std::atomic<bool> m_clear_occured;
+	// number of running clear() calls and page budgets they restore, set_max_size() updates the latter meanwhile
+	size_t m_clears_running;
+	std::vector<size_t> m_clear_max_sizes;
 	unsigned m_sync_timeout;
 
 	slru_cache_t(const slru_cache_t &) = delete;
@@ -71,7 +126,21 @@ private:
 		return page_number + 1;
 	}
 
-	void sync_if_required(data_t* it, elliptics_unique_lock<std::mutex> &guard);
+	void schedule_promotion(const unsigned char *id);
+
+	void promote_scheduled();
+
+	void sync_if_required(data_t* it, elliptics_unique_lock<boost::shared_mutex> &guard);
+
+	void schedule_compression(data_t *obj);
+
+	bool can_be_compressed(data_t *obj) const;
+
+	std::shared_ptr<raw_data_t> decompress(const std::shared_ptr<raw_data_t> &data);
+
+	data_t* decompress_element(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id, data_t *obj);
+
+	void replace_data(data_t *obj, const std::shared_ptr<raw_data_t> &data, bool compressed, size_t raw_size);
 
 	void insert_data_into_page(const unsigned char *id, size_t page_number, data_t *data);
 
@@ -84,7 +153,12 @@ private:
 
 	data_t* create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk);
 
-	data_t* populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err);
+	bool admit(const unsigned char *id, size_t size);
+
+	int read_from_disk(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id,
+		ioremap::elliptics::data_pointer &data, uint64_t *user_flags, dnet_time *timestamp);
+
+	data_t* populate_from_disk(elliptics_unique_lock<boost::shared_mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err);
 
 	bool have_enough_space(const unsigned char *id, size_t page_number, size_t reserve);
 
@@ -92,13 +166,14 @@ private:
 
 	void erase_element(data_t *obj);
 
-	void sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp);
+	int sync_element(local_session &sess, const dnet_id &raw, bool after_append, const raw_data_t &data,
+		uint64_t user_flags, const dnet_time &timestamp);
 
-	void sync_element(data_t *obj);
+	void sync_element(const dnet_id &raw, bool after_append, const raw_data_t &data, uint64_t user_flags, const dnet_time &timestamp);
 
-	void sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj);
+	void sync_element(data_t *obj);
 
-	void life_check(void);
+	void sync_after_append(elliptics_unique_lock<boost::shared_mutex> &guard, bool lock_guard, data_t *obj);
 };
 
 }}
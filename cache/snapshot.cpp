@@ -0,0 +1,265 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "snapshot.hpp"
+#include "raw_data.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ioremap { namespace cache {
+
+#define SNAPSHOT_MAGIC 0x544e534843414344ULL /* "DCACHSNT" */
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 8
+
+static size_t snapshot_align(size_t size) {
+	return (size + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1);
+}
+
+static std::runtime_error snapshot_error(const std::string &path, const std::string &message, int err) {
+	return std::runtime_error(path + ": " + message + ": " + strerror(err));
+}
+
+/*
+ * Buffered writer of snapshot file, @write_snapshot() writes objects of all sections one by one,
+ * so objects are not copied into one large buffer.
+ */
+class snapshot_file {
+public:
+	snapshot_file(const std::string &path) : m_path(path), m_size(0) {
+		m_fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+		if (m_fd < 0)
+			throw snapshot_error(path, "could not create snapshot", errno);
+
+		m_buffer.reserve(buffer_size);
+	}
+
+	~snapshot_file() {
+		if (m_fd >= 0)
+			close(m_fd);
+	}
+
+	void write(const void *data, size_t size) {
+		const char *ptr = static_cast<const char *>(data);
+
+		if (m_buffer.size() + size > buffer_size) {
+			flush();
+		}
+
+		if (size > buffer_size) {
+			write_all(ptr, size);
+		} else {
+			m_buffer.insert(m_buffer.end(), ptr, ptr + size);
+		}
+
+		m_size += size;
+	}
+
+	void pad() {
+		static const char zeroes[SNAPSHOT_ALIGNMENT] = {0};
+		write(zeroes, snapshot_align(m_size) - m_size);
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	void sync() {
+		flush();
+
+		if (fsync(m_fd))
+			throw snapshot_error(m_path, "could not sync snapshot", errno);
+
+		int fd = m_fd;
+		m_fd = -1;
+
+		if (close(fd))
+			throw snapshot_error(m_path, "could not close snapshot", errno);
+	}
+
+private:
+	enum {
+		buffer_size = 1024 * 1024
+	};
+
+	void flush() {
+		write_all(m_buffer.data(), m_buffer.size());
+		m_buffer.clear();
+	}
+
+	void write_all(const char *data, size_t size) {
+		while (size) {
+			ssize_t written = ::write(m_fd, data, size);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				throw snapshot_error(m_path, "could not write snapshot", errno);
+			}
+
+			data += written;
+			size -= written;
+		}
+	}
+
+	std::string m_path;
+	int m_fd;
+	size_t m_size;
+	std::vector<char> m_buffer;
+};
+
+void write_snapshot(const std::string &path, const std::vector<snapshot_section_t> &sections) {
+	std::vector<snapshot_section> table(sections.size());
+
+	size_t offset = sizeof(snapshot_header) + sections.size() * sizeof(snapshot_section);
+	for (size_t i = 0; i < sections.size(); ++i) {
+		table[i].offset = offset;
+		table[i].size = 0;
+		table[i].objects = sections[i].size();
+
+		for (auto it = sections[i].begin(), end = sections[i].end(); it != end; ++it) {
+			table[i].size += sizeof(snapshot_entry) + snapshot_align(it->data->size());
+		}
+
+		offset += table[i].size;
+	}
+
+	const std::string tmp_path = path + ".tmp";
+
+	try {
+		snapshot_file file(tmp_path);
+
+		snapshot_header header;
+		memset(&header, 0, sizeof(header));
+		header.magic = SNAPSHOT_MAGIC;
+		header.version = SNAPSHOT_VERSION;
+		header.sections = sections.size();
+
+		file.write(&header, sizeof(header));
+		file.write(table.data(), table.size() * sizeof(snapshot_section));
+
+		for (auto section = sections.begin(); section != sections.end(); ++section) {
+			for (auto it = section->begin(), end = section->end(); it != end; ++it) {
+				snapshot_entry entry;
+				memset(&entry, 0, sizeof(entry));
+				entry.id = it->id;
+				entry.timestamp = it->timestamp;
+				entry.user_flags = it->user_flags;
+				entry.size = it->data->size();
+				entry.page = it->page;
+
+				file.write(&entry, sizeof(entry));
+				it->data->for_each(0, it->data->size(), [&file] (const char *data, size_t size) {
+					file.write(data, size);
+				});
+				file.pad();
+			}
+		}
+
+		if (file.size() != offset)
+			throw std::runtime_error(tmp_path + ": snapshot size mismatch");
+
+		file.sync();
+
+		if (rename(tmp_path.c_str(), path.c_str()))
+			throw snapshot_error(path, "could not rename " + tmp_path, errno);
+	} catch (...) {
+		unlink(tmp_path.c_str());
+		throw;
+	}
+}
+
+snapshot_reader::snapshot_reader(const std::string &path) :
+	m_data(NULL), m_size(0), m_sections(NULL), m_sections_number(0) {
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw snapshot_error(path, "could not open snapshot", errno);
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		int err = errno;
+		close(fd);
+		throw snapshot_error(path, "could not stat snapshot", err);
+	}
+
+	m_size = st.st_size;
+	if (m_size < sizeof(snapshot_header)) {
+		close(fd);
+		throw std::runtime_error(path + ": snapshot is too small");
+	}
+
+	void *data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, fd, 0);
+	int err = errno;
+	close(fd);
+
+	if (data == MAP_FAILED)
+		throw snapshot_error(path, "could not map snapshot", err);
+
+	m_data = static_cast<const char *>(data);
+	madvise(data, m_size, MADV_SEQUENTIAL);
+
+	const snapshot_header *header = reinterpret_cast<const snapshot_header *>(m_data);
+	if (header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION) {
+		munmap(data, m_size);
+		throw std::runtime_error(path + ": unsupported snapshot format");
+	}
+
+	m_sections_number = header->sections;
+	m_sections = reinterpret_cast<const snapshot_section *>(header + 1);
+
+	bool valid = m_sections_number <= (m_size - sizeof(snapshot_header)) / sizeof(snapshot_section);
+	for (size_t i = 0; valid && i < m_sections_number; ++i) {
+		const snapshot_section &section = m_sections[i];
+		valid = section.offset <= m_size && section.size <= m_size - section.offset;
+	}
+
+	if (!valid) {
+		munmap(data, m_size);
+		throw std::runtime_error(path + ": snapshot is corrupted");
+	}
+}
+
+snapshot_reader::~snapshot_reader() {
+	munmap(const_cast<char *>(m_data), m_size);
+}
+
+size_t snapshot_reader::sections() const {
+	return m_sections_number;
+}
+
+void snapshot_reader::read_section(size_t section, const handler_t &handler) const {
+	const char *ptr = m_data + m_sections[section].offset;
+	const char *end = ptr + m_sections[section].size;
+
+	for (size_t i = 0; i < m_sections[section].objects; ++i) {
+		if ((size_t)(end - ptr) < sizeof(snapshot_entry))
+			throw std::runtime_error("snapshot section is corrupted");
+
+		const snapshot_entry &entry = *reinterpret_cast<const snapshot_entry *>(ptr);
+		ptr += sizeof(snapshot_entry);
+
+		if (entry.size > (size_t)(end - ptr) || (size_t)(end - ptr) < snapshot_align(entry.size))
+			throw std::runtime_error("snapshot section is corrupted");
+
+		handler(entry, ptr);
+		ptr += snapshot_align(entry.size);
+	}
+}
+
+}} /* namespace ioremap::cache */
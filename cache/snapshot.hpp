@@ -0,0 +1,123 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+class raw_data_t;
+
+/*
+ * Cache snapshot keeps clean objects of the cache between restarts of the server.
+ *
+ * File consists of header, table of sections and sections themselves.
+ * Every shard of the cache writes its own section, objects in the section go from
+ * the coldest to the hottest ones, so restoring them in order recreates LRU order of pages.
+ * Section is a sequence of @snapshot_entry each followed by object's data padded to 8 bytes.
+ * File is written in native byte order and is mapped into memory on load.
+ */
+struct snapshot_header {
+	uint64_t		magic;
+	uint32_t		version;
+	uint32_t		sections;
+} __attribute__ ((packed));
+
+struct snapshot_section {
+	uint64_t		offset;
+	uint64_t		size;
+	uint64_t		objects;
+} __attribute__ ((packed));
+
+struct snapshot_entry {
+	struct dnet_raw_id	id;
+	struct dnet_time	timestamp;
+	uint64_t		user_flags;
+	uint64_t		size;
+	uint32_t		page;
+	uint32_t		reserved;
+} __attribute__ ((packed));
+
+/*
+ * Object taken from the cache for writing into snapshot, data is pinned until snapshot is written
+ */
+struct snapshot_object {
+	dnet_raw_id id;
+	size_t page;
+	dnet_time timestamp;
+	uint64_t user_flags;
+	std::shared_ptr<raw_data_t> data;
+};
+
+typedef std::vector<snapshot_object> snapshot_section_t;
+
+/*
+ * Results of restoring cache from snapshot on start, reported in backend status
+ */
+struct snapshot_stats {
+	snapshot_stats(): restored_objects(0), restored_size(0), skipped_objects(0), restore_time(0) {}
+
+	size_t restored_objects;
+	size_t restored_size;
+	// objects which were changed or removed on disk since snapshot or do not fit into the cache
+	size_t skipped_objects;
+	// time spent on restoring in milliseconds
+	long long restore_time;
+};
+
+/*
+ * Writes @sections into snapshot file at @path.
+ * Data is written to the temporary file which is renamed to @path when it is completely synced to disk,
+ * so crash during the write never leaves broken snapshot.
+ *
+ * Throws std::runtime_error on failure.
+ */
+void write_snapshot(const std::string &path, const std::vector<snapshot_section_t> &sections);
+
+/*
+ * Maps snapshot file into memory and validates its structure.
+ * Sections may be read concurrently from different threads.
+ */
+class snapshot_reader {
+public:
+	typedef std::function<void (const snapshot_entry &entry, const char *data)> handler_t;
+
+	// throws std::runtime_error if file can not be mapped or it is not a valid snapshot
+	snapshot_reader(const std::string &path);
+	~snapshot_reader();
+
+	size_t sections() const;
+
+	// calls @handler for every object of @section in order they were written
+	void read_section(size_t section, const handler_t &handler) const;
+
+private:
+	snapshot_reader(const snapshot_reader &) = delete;
+	snapshot_reader &operator =(const snapshot_reader &) = delete;
+
+	const char *m_data;
+	size_t m_size;
+	const snapshot_section *m_sections;
+	size_t m_sections_number;
+};
+
+}}
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,208 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <cstddef>
+#include <limits>
+
+#include <boost/intrusive/list.hpp>
+
+namespace ioremap { namespace cache {
+
+struct timer_wheel_tag_t;
+
+/*
+ * Node of the timer wheel, it keeps deadline the node is scheduled at.
+ * Hook unlinks itself on destruction, but owner must cancel node before that,
+ * otherwise size of the wheel becomes wrong.
+ */
+class timer_wheel_node_t : public boost::intrusive::list_base_hook<boost::intrusive::tag<timer_wheel_tag_t>,
+	boost::intrusive::link_mode<boost::intrusive::auto_unlink> > {
+public:
+	timer_wheel_node_t(): m_deadline(0) {}
+
+	size_t deadline() const {
+		return m_deadline;
+	}
+
+private:
+	template<typename node_type>
+	friend class timer_wheel;
+
+	size_t m_deadline;
+};
+
+/*
+ * Hierarchical timing wheel of nodes scheduled at absolute ticks (seconds for the cache).
+ *
+ * The first level has a slot per tick for the nearest 256 ticks, every next level has 64 slots
+ * each covering the whole previous level. When the first level wraps around, slot of the next level
+ * is cascaded down, so every node is moved at most once per level. Deadlines which do not fit into
+ * the last level are clamped to its end and are rescheduled when they are cascaded.
+ *
+ * Scheduling, rescheduling and cancelling are O(1), @pop_expired() is amortized O(1) per tick and node.
+ * Wheel is not synchronized.
+ */
+template<typename node_type>
+class timer_wheel {
+public:
+	// deadline which means that node is not scheduled at all
+	static const size_t never = std::numeric_limits<size_t>::max();
+
+	timer_wheel(size_t now): m_next(now + 1), m_size(0) {}
+
+	~timer_wheel() {
+		clear();
+	}
+
+	/*
+	 * Schedules @node at @deadline or moves it there if it is already scheduled.
+	 * Node whose deadline has already passed is returned by the next @pop_expired().
+	 */
+	void schedule(node_type *node, size_t deadline) {
+		cancel(node);
+
+		if (deadline == never)
+			return;
+
+		node->m_deadline = deadline;
+		insert(node);
+		++m_size;
+	}
+
+	void cancel(node_type *node) {
+		// node may have other list hooks, so its timer hook is taken explicitly
+		timer_wheel_node_t *hook = node;
+		if (hook->is_linked()) {
+			hook->unlink();
+			--m_size;
+		}
+	}
+
+	/*
+	 * Returns node whose deadline is not later than @now and removes it from the wheel,
+	 * returns NULL if there are no such nodes. Expired nodes are returned in order of ticks.
+	 */
+	node_type *pop_expired(size_t now) {
+		while (m_expired.empty() && m_next <= now) {
+			if (!m_size) {
+				m_next = now + 1;
+				break;
+			}
+
+			run_tick();
+		}
+
+		if (m_expired.empty())
+			return NULL;
+
+		node_type *node = &m_expired.front();
+		m_expired.pop_front();
+		--m_size;
+		return node;
+	}
+
+	void clear() {
+		for (size_t level = 0; level < levels; ++level) {
+			for (size_t i = 0; i < level_size(level); ++i) {
+				m_slots[level][i].clear();
+			}
+		}
+		m_expired.clear();
+		m_size = 0;
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	bool empty() const {
+		return !m_size;
+	}
+
+private:
+	enum {
+		levels = 4,
+		first_level_bits = 8,
+		level_bits = 6,
+		max_delta = (1 << (first_level_bits + (levels - 1) * level_bits)) - 1
+	};
+
+	typedef boost::intrusive::list<node_type, boost::intrusive::base_hook<timer_wheel_node_t>,
+		boost::intrusive::constant_time_size<false> > list_t;
+
+	static size_t level_size(size_t level) {
+		return level ? (1 << level_bits) : (1 << first_level_bits);
+	}
+
+	static size_t level_shift(size_t level) {
+		return level ? first_level_bits + (level - 1) * level_bits : 0;
+	}
+
+	void insert(node_type *node) {
+		if (node->m_deadline < m_next) {
+			m_expired.push_back(*node);
+			return;
+		}
+
+		size_t deadline = node->m_deadline;
+		if (deadline - m_next > max_delta)
+			deadline = m_next + max_delta;
+
+		size_t level = 0;
+		while (level + 1 < levels && deadline - m_next >= ((size_t)1 << level_shift(level + 1)))
+			++level;
+
+		const size_t slot = (deadline >> level_shift(level)) & (level_size(level) - 1);
+		m_slots[level][slot].push_back(*node);
+	}
+
+	// moves nodes of the current slot of @level to the lower levels, returns index of the slot
+	size_t cascade(size_t level) {
+		const size_t slot = (m_next >> level_shift(level)) & (level_size(level) - 1);
+
+		list_t nodes;
+		nodes.swap(m_slots[level][slot]);
+
+		while (!nodes.empty()) {
+			node_type *node = &nodes.front();
+			nodes.pop_front();
+			insert(node);
+		}
+
+		return slot;
+	}
+
+	void run_tick() {
+		const size_t slot = m_next & (level_size(0) - 1);
+
+		if (!slot) {
+			for (size_t level = 1; level < levels && !cascade(level); ++level) {
+			}
+		}
+
+		m_expired.splice(m_expired.end(), m_slots[0][slot]);
+		++m_next;
+	}
+
+	list_t m_slots[levels][1 << first_level_bits];
+	list_t m_expired;
+	// the first tick which is not processed yet
+	size_t m_next;
+	size_t m_size;
+};
+
+}}
+
+#endif // TIMER_WHEEL_HPP
@@ -0,0 +1,246 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef _GLIBCXX_USE_NANOSLEEP
+#define _GLIBCXX_USE_NANOSLEEP
+#endif
+
+#include "write_behind.hpp"
+#include "slru_cache.hpp"
+
+#include <algorithm>
+
+#include "monitor/measure_points.h"
+
+namespace ioremap { namespace cache {
+
+write_behind_t::write_behind_t(dnet_backend_io *backend, dnet_node *n,
+		const std::vector<std::shared_ptr<slru_cache_t>> &caches, const cache_config &config) :
+	m_backend(backend),
+	m_node(n),
+	m_caches(caches),
+	m_threads_number(config.sync_threads),
+	m_batch_size(config.sync_batch),
+	m_rate(config.sync_rate),
+	m_cache_size(config.size),
+	m_queue_size(0),
+	m_synced(0),
+	m_failed(0),
+	m_stop(false) {
+	for (size_t i = 0; i < latency_buckets; ++i) {
+		m_latency[i] = 0;
+	}
+
+	m_thread = std::thread(std::bind(&write_behind_t::run, this));
+}
+
+write_behind_t::~write_behind_t() {
+	m_stop = true;
+	m_thread.join();
+}
+
+rapidjson::Value &write_behind_t::to_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const {
+	stat_value.AddMember("queue_size", m_queue_size.load(), allocator)
+		  .AddMember("synced", m_synced.load(), allocator)
+		  .AddMember("failed", m_failed.load(), allocator)
+		  .AddMember("threads", m_threads_number, allocator)
+		  .AddMember("rate", m_rate, allocator);
+
+	rapidjson::Value latency_stat(rapidjson::kArrayType);
+	for (size_t i = 0; i < latency_buckets; ++i) {
+		rapidjson::Value bucket_stat(rapidjson::kObjectType);
+		// the last bucket has no upper bound, it is reported as zero
+		bucket_stat.AddMember("max_time", i + 1 < latency_buckets ? (1 << i) * 1000 : 0, allocator)
+			   .AddMember("count", m_latency[i].load(), allocator);
+		latency_stat.PushBack(bucket_stat, allocator);
+	}
+	stat_value.AddMember("sync_time", latency_stat, allocator);
+
+	return stat_value;
+}
+
+bool write_behind_t::need_exit() const {
+	return m_stop || dnet_need_exit(m_node) || m_backend->need_exit;
+}
+
+void write_behind_t::run() {
+	dnet_set_name("dnet_cache_%zu", m_backend->backend_id);
+
+	std::vector<write_behind_pass> passes(m_caches.size());
+	std::vector<write_behind_item> items;
+
+	while (!need_exit()) {
+		items.clear();
+
+		for (size_t i = 0; i < m_caches.size(); ++i) {
+			passes[i] = write_behind_pass();
+			m_caches[i]->prepare_sync(passes[i], items);
+		}
+
+		HANDY_GAUGE_SET("slru_cache.life_check.sync_iterate.element_count", items.size());
+		sync(items);
+
+		// pinned data is released before objects are erased from cache
+		items.clear();
+
+		for (size_t i = 0; i < m_caches.size(); ++i) {
+			for (auto it = passes[i].remove.begin(); it != passes[i].remove.end(); ++it) {
+				dnet_remove_local(m_backend, m_node, &(*it));
+			}
+
+			m_caches[i]->complete_sync(passes[i]);
+		}
+
+		rebalance();
+
+		for (size_t i = 0; i < m_caches.size() && !need_exit(); ++i) {
+			m_caches[i]->compress_demoted();
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+	}
+}
+
+/*
+ * Objects are sorted by key and split into batches of neighbour keys,
+ * so backend gets long runs of close keys instead of random ones.
+ * Caller's thread takes part in writing, additional threads are started only if there are enough batches.
+ */
+void write_behind_t::sync(std::vector<write_behind_item> &items) {
+	if (items.empty())
+		return;
+
+	HANDY_TIMER_SCOPE("slru_cache.life_check.sync_iterate");
+
+	std::sort(items.begin(), items.end(), [] (const write_behind_item &lhs, const write_behind_item &rhs) {
+		return dnet_id_cmp_str(lhs.id.id, rhs.id.id) < 0;
+	});
+
+	m_queue_size = items.size();
+
+	const size_t batches = (items.size() + m_batch_size - 1) / m_batch_size;
+	const size_t threads_number = std::min(batches, m_threads_number);
+	std::atomic<size_t> next_batch(0);
+
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threads_number; ++i) {
+		threads.emplace_back(std::bind(&write_behind_t::sync_batches, this, std::ref(items), std::ref(next_batch)));
+	}
+
+	sync_batches(items, next_batch);
+
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		it->join();
+	}
+
+	m_queue_size = 0;
+}
+
+void write_behind_t::sync_batches(std::vector<write_behind_item> &items, std::atomic<size_t> &next_batch) {
+	local_session sess(m_backend, m_node);
+
+	for (size_t begin = next_batch++ * m_batch_size; begin < items.size(); begin = next_batch++ * m_batch_size) {
+		const size_t end = std::min(begin + m_batch_size, items.size());
+
+		for (size_t i = begin; i < end; ++i) {
+			const write_behind_item &item = items[i];
+
+			throttle();
+
+			elliptics_timer timer;
+			int err = 0;
+			if (item.cache->sync_prepared(sess, item, &err)) {
+				account_latency(timer.elapsed<std::chrono::microseconds>());
+				if (err)
+					++m_failed;
+				else
+					++m_synced;
+			}
+
+			--m_queue_size;
+		}
+	}
+}
+
+/*
+ * Every write reserves its own time slot, so writes are spread evenly over a second.
+ * Rate is not limited on exit: all taken objects must be written before cache is destroyed.
+ */
+void write_behind_t::throttle() {
+	if (!m_rate || need_exit())
+		return;
+
+	std::chrono::system_clock::time_point slot;
+	{
+		std::lock_guard<std::mutex> guard(m_rate_lock);
+
+		const auto now = std::chrono::system_clock::now();
+		if (m_rate_next < now)
+			m_rate_next = now;
+
+		slot = m_rate_next;
+		m_rate_next += std::chrono::microseconds(1000000 / m_rate);
+	}
+
+	std::this_thread::sleep_until(slot);
+}
+
+/*
+ * Every shard keeps half of its fair share, the rest of the cache is split in proportion
+ * to size of objects shard keeps plus size of objects it has evicted since the previous pass.
+ * Budget moves only halfway to this target per pass, so short bursts do not swing budgets.
+ * Nothing is changed while no shard lacks space.
+ */
+void write_behind_t::rebalance() {
+	if (m_caches.size() < 2)
+		return;
+
+	std::vector<shard_usage> usage(m_caches.size());
+	size_t demand = 0, evicted = 0;
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		usage[i] = m_caches[i]->take_usage();
+		demand += usage[i].size + usage[i].evicted;
+		evicted += usage[i].evicted;
+	}
+
+	if (!evicted)
+		return;
+
+	const size_t reserved = m_cache_size / m_caches.size() / 2;
+	const size_t spare = m_cache_size - reserved * m_caches.size();
+
+	std::vector<size_t> budgets(m_caches.size());
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		const size_t target = reserved + spare * ((double)(usage[i].size + usage[i].evicted) / demand);
+		budgets[i] = (usage[i].max_size + target) / 2;
+	}
+
+	// shrinking shards free memory before growing ones take it
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		if (budgets[i] < usage[i].max_size)
+			m_caches[i]->set_max_size(budgets[i]);
+	}
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		if (budgets[i] > usage[i].max_size)
+			m_caches[i]->set_max_size(budgets[i]);
+	}
+}
+
+void write_behind_t::account_latency(long long usecs) {
+	size_t bucket = 0;
+	while (bucket + 1 < latency_buckets && usecs >= (1LL << bucket) * 1000)
+		++bucket;
+
+	++m_latency[bucket];
+}
+
+}} /* namespace ioremap::cache */
@@ -0,0 +1,128 @@
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef WRITE_BEHIND_HPP
+#define WRITE_BEHIND_HPP
+
+#include "cache.hpp"
+
+#include <deque>
+
+namespace ioremap { namespace cache {
+
+class slru_cache_t;
+
+/*
+ * Dirty object taken for sync, its data and attributes are pinned when object is taken,
+ * so they are written without cache lock.
+ */
+struct write_behind_item {
+	slru_cache_t *cache;
+	data_t *object;
+	dnet_id id;
+	bool only_append;
+	uint64_t user_flags;
+	dnet_time timestamp;
+	std::shared_ptr<raw_data_t> data;
+};
+
+/*
+ * Objects of one shard processed by one pass of write-behind
+ */
+struct write_behind_pass {
+	write_behind_pass(): last_time(0) {}
+
+	// objects taken for sync, they are released when pass is completed
+	std::vector<data_t *> objects;
+	// expired objects which must be removed from disk
+	std::deque<dnet_id> remove;
+	size_t last_time;
+};
+
+/*
+ * Memory usage of one shard, budgets of shards are rebalanced by it
+ */
+struct shard_usage {
+	size_t max_size;
+	size_t size;
+	// objects evicted for lack of space, it shows how much more memory shard could use
+	size_t evicted;
+};
+
+/*
+ * Write-behind service of one backend.
+ *
+ * Once a second it takes objects whose sync time has come from all shards of the cache,
+ * sorts them by key and writes them to the backend by groups of neighbour keys.
+ * Groups are written by at most @sync_threads threads, total rate of writes may be limited by @sync_rate.
+ * After that memory budgets of shards are rebalanced: shards which evict objects for lack of space
+ * take memory from shards which do not use their budgets. Finally objects demoted into the compressed
+ * pages are compressed, if compression is enabled.
+ */
+class write_behind_t {
+public:
+	write_behind_t(dnet_backend_io *backend, dnet_node *n, const std::vector<std::shared_ptr<slru_cache_t>> &caches,
+		const cache_config &config);
+
+	// waits for the current pass to be finished
+	~write_behind_t();
+
+	rapidjson::Value &to_json(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) const;
+
+private:
+	enum {
+		latency_buckets = 12
+	};
+
+	write_behind_t(const write_behind_t &) = delete;
+	write_behind_t &operator =(const write_behind_t &) = delete;
+
+	bool need_exit() const;
+
+	void run();
+
+	void sync(std::vector<write_behind_item> &items);
+
+	void sync_batches(std::vector<write_behind_item> &items, std::atomic<size_t> &next_batch);
+
+	void throttle();
+
+	void rebalance();
+
+	void account_latency(long long usecs);
+
+	dnet_backend_io *m_backend;
+	dnet_node *m_node;
+	std::vector<std::shared_ptr<slru_cache_t>> m_caches;
+
+	const size_t m_threads_number;
+	const size_t m_batch_size;
+	const size_t m_rate;
+	const size_t m_cache_size;
+
+	std::mutex m_rate_lock;
+	std::chrono::system_clock::time_point m_rate_next;
+
+	// number of objects of the current pass which are not written yet
+	std::atomic<size_t> m_queue_size;
+	std::atomic<size_t> m_synced;
+	std::atomic<size_t> m_failed;
+	// histogram of write times, upper bounds of buckets are 2^i milliseconds, the last bucket is unbounded
+	std::atomic<size_t> m_latency[latency_buckets];
+
+	std::atomic<bool> m_stop;
+	std::thread m_thread;
+};
+
+}}
+
+#endif // WRITE_BEHIND_HPP
@@ -272,6 +272,7 @@ void parse_options(config_data *data, const config &options)
 	data->cfg_state.removal_delay = options.at("removal_delay", 0);
 	data->cfg_state.server_prio = options.at("server_net_prio", 0);
 	data->cfg_state.client_prio = options.at("client_net_prio", 0);
+	data->cfg_state.net_lanes = options.at("net_lanes", 1);
 	data->cfg_state.indexes_shard_count = options.at("indexes_shard_count", 0);
 	data->daemon_mode = options.at("daemon", false);
 	data->parallel_start = options.at("parallel", true);
@@ -367,6 +367,307 @@ err_out_exit:
 }
 
 
+/*
+ * Asynchronous read queue.
+ * Backend IO thread resolves record location and queues the read, one of reader threads
+ * reads the data into a buffer taken from the receive buffer cache and queues it for sending
+ * without copying, so backend IO threads do not wait for the disk and network threads
+ * do not block in sendfile().
+ * When the queue is full, record is sent by network thread from the blob file as before.
+ */
+#define EBLOB_READ_THREADS_DEFAULT	8
+/* Larger records are always sent from the blob file to avoid allocating huge buffers */
+#define EBLOB_READ_ASYNC_MAX_SIZE	(16 * 1024 * 1024)
+/*
+ * Records of bulk reads which fit into the largest cached buffer are read into memory,
+ * so their replies are sent by a single writev() together with neighbours
+ * instead of a separate sendfile() call per record.
+ */
+#define EBLOB_READ_COALESCE_MAX_SIZE	((1 << (DNET_IO_BUF_MIN_SHIFT + DNET_IO_BUF_CLASSES - 1)) - \
+					 sizeof(struct dnet_io_req))
+
+struct eblob_read_request {
+	struct list_head	entry;
+	struct dnet_net_state	*st;
+	struct dnet_cmd		cmd;
+	struct dnet_io_attr	io;
+	int			fd;
+	int			on_close;
+	uint64_t		offset;
+};
+
+struct eblob_read_queue {
+	pthread_mutex_t		lock;
+	pthread_cond_t		wait;
+	struct list_head	requests;
+	int			need_exit;
+
+	int			queue_depth;
+	int			in_flight;
+	uint64_t		completed;
+	uint64_t		queue_full;
+
+	struct dnet_io_buf_pool	*buf_pool;
+	dnet_logger		*blog;
+
+	int			thread_num;
+	pthread_t		*threads;
+};
+
+static void blob_read_buf_free(void *priv)
+{
+	dnet_io_buf_free(priv);
+}
+
+/*
+ * Reads @io->size bytes at @offset of @fd into a buffer taken from @pool and queues it for sending,
+ * record is sent from the file if buffer can not be allocated.
+ */
+static int blob_read_buffered(struct dnet_io_buf_pool *pool, void *state, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, int fd, uint64_t offset, int on_close)
+{
+	struct dnet_io_req *r;
+	char *data;
+	uint64_t size = io->size, total = 0;
+	ssize_t bytes;
+	int err;
+
+	r = dnet_io_buf_alloc(pool, sizeof(struct dnet_io_req) + size);
+	if (!r)
+		return dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
+
+	data = (char *)(r + 1);
+
+	while (total < size) {
+		bytes = pread(fd, data + total, size - total, offset + total);
+		if (bytes < 0) {
+			if (errno == EINTR)
+				continue;
+
+			err = -errno;
+			goto err_out_free;
+		}
+
+		if (bytes == 0) {
+			err = -ERANGE;
+			goto err_out_free;
+		}
+
+		total += bytes;
+	}
+
+	if (on_close & DNET_IO_REQ_FLAGS_CACHE_FORGET)
+		posix_fadvise(fd, offset, size, POSIX_FADV_DONTNEED);
+
+	/* @r is released by the send queue */
+	return dnet_send_read_data_nocopy(state, cmd, io, data, blob_read_buf_free, r);
+
+err_out_free:
+	dnet_io_buf_free(r);
+	return err;
+}
+
+static void *blob_read_queue_process(void *priv)
+{
+	struct eblob_read_queue *q = priv;
+	struct eblob_read_request *req;
+	int err;
+
+	dnet_set_name("dnet_blob_read");
+
+	pthread_mutex_lock(&q->lock);
+	while (1) {
+		while (list_empty(&q->requests) && !q->need_exit)
+			pthread_cond_wait(&q->wait, &q->lock);
+
+		/* queued reads are completed before exit */
+		if (list_empty(&q->requests))
+			break;
+
+		req = list_first_entry(&q->requests, struct eblob_read_request, entry);
+		list_del(&req->entry);
+		pthread_mutex_unlock(&q->lock);
+
+		err = blob_read_buffered(q->buf_pool, req->st, &req->cmd, &req->io, req->fd, req->offset, req->on_close);
+		if (err) {
+			dnet_backend_log(q->blog, DNET_LOG_ERROR, "%s: EBLOB: blob-read-async: READ: %d: %s",
+			                 dnet_dump_id_str(req->io.id), err, strerror(-err));
+
+			/* acknowledge was turned off when read has been queued, client still waits for the reply */
+			req->cmd.flags |= DNET_FLAGS_NEED_ACK;
+			dnet_send_ack(req->st, &req->cmd, err, 0);
+		}
+
+		dnet_state_put(req->st);
+		free(req);
+
+		pthread_mutex_lock(&q->lock);
+		q->in_flight--;
+		q->completed++;
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	return NULL;
+}
+
+/*
+ * Queues read of @io->size bytes at @offset of @fd, reply is sent to @st by reader thread.
+ * Returns -EAGAIN if there are already @queue_depth reads in flight.
+ */
+static int blob_read_queue_submit(struct eblob_read_queue *q, struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_io_attr *io, int fd, uint64_t offset, int on_close)
+{
+	struct eblob_read_request *req;
+
+	req = malloc(sizeof(struct eblob_read_request));
+	if (!req)
+		return -EAGAIN;
+
+	req->cmd = *cmd;
+	req->io = *io;
+	req->fd = fd;
+	req->on_close = on_close;
+	req->offset = offset;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->in_flight >= q->queue_depth) {
+		q->queue_full++;
+		pthread_mutex_unlock(&q->lock);
+
+		free(req);
+		return -EAGAIN;
+	}
+
+	req->st = dnet_state_get(st);
+	list_add_tail(&req->entry, &q->requests);
+	q->in_flight++;
+
+	pthread_cond_signal(&q->wait);
+	pthread_mutex_unlock(&q->lock);
+
+	return 0;
+}
+
+static void blob_read_queue_stop(struct eblob_read_queue *q, int thread_num)
+{
+	int i;
+
+	pthread_mutex_lock(&q->lock);
+	q->need_exit = 1;
+	pthread_cond_broadcast(&q->wait);
+	pthread_mutex_unlock(&q->lock);
+
+	for (i = 0; i < thread_num; ++i)
+		pthread_join(q->threads[i], NULL);
+}
+
+static int blob_read_queue_init(struct eblob_backend_config *c)
+{
+	struct eblob_read_queue *q;
+	int err;
+
+	if (c->read_queue_depth <= 0)
+		return 0;
+
+	if (c->read_threads <= 0)
+		c->read_threads = EBLOB_READ_THREADS_DEFAULT;
+	if (c->read_threads > c->read_queue_depth)
+		c->read_threads = c->read_queue_depth;
+
+	q = calloc(1, sizeof(struct eblob_read_queue));
+	if (!q) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	INIT_LIST_HEAD(&q->requests);
+	q->queue_depth = c->read_queue_depth;
+	q->buf_pool = c->buf_pool;
+	q->blog = c->blog;
+
+	q->threads = calloc(c->read_threads, sizeof(pthread_t));
+	if (!q->threads) {
+		err = -ENOMEM;
+		goto err_out_free;
+	}
+
+	err = pthread_mutex_init(&q->lock, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_free_threads;
+	}
+
+	err = pthread_cond_init(&q->wait, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_lock_destroy;
+	}
+
+	for (q->thread_num = 0; q->thread_num < c->read_threads; ++q->thread_num) {
+		err = pthread_create(&q->threads[q->thread_num], NULL, blob_read_queue_process, q);
+		if (err) {
+			err = -err;
+			dnet_backend_log(c->blog, DNET_LOG_ERROR, "blob: could not create read thread: %d.", err);
+			goto err_out_stop;
+		}
+	}
+
+	c->read_queue = q;
+
+	dnet_backend_log(c->blog, DNET_LOG_INFO, "blob: asynchronous reads: queue depth: %d, threads: %d.",
+	                 c->read_queue_depth, c->read_threads);
+	return 0;
+
+err_out_stop:
+	blob_read_queue_stop(q, q->thread_num);
+	pthread_cond_destroy(&q->wait);
+err_out_lock_destroy:
+	pthread_mutex_destroy(&q->lock);
+err_out_free_threads:
+	free(q->threads);
+err_out_free:
+	free(q);
+err_out_exit:
+	return err;
+}
+
+static void blob_read_queue_cleanup(struct eblob_backend_config *c)
+{
+	struct eblob_read_queue *q = c->read_queue;
+
+	if (!q)
+		return;
+
+	blob_read_queue_stop(q, q->thread_num);
+
+	pthread_cond_destroy(&q->wait);
+	pthread_mutex_destroy(&q->lock);
+	free(q->threads);
+	free(q);
+
+	c->read_queue = NULL;
+}
+
+static void eblob_backend_read_queue_stat(void *priv, struct dnet_backend_read_queue_stat *stat)
+{
+	struct eblob_backend_config *c = priv;
+	struct eblob_read_queue *q = c->read_queue;
+
+	memset(stat, 0, sizeof(struct dnet_backend_read_queue_stat));
+
+	if (!q)
+		return;
+
+	stat->queue_depth = q->queue_depth;
+	stat->threads = q->thread_num;
+
+	pthread_mutex_lock(&q->lock);
+	stat->in_flight = q->in_flight;
+	stat->completed = q->completed;
+	stat->queue_full = q->queue_full;
+	pthread_mutex_unlock(&q->lock);
+}
+
 static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data, int last)
 {
 	struct dnet_ext_list elist;
@@ -503,6 +804,26 @@ static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cm
 	if (c->random_access)
 		on_close = DNET_IO_REQ_FLAGS_CACHE_FORGET;
 
+	/*
+	 * Only the final reply of the command can be sent asynchronously, otherwise acknowledge
+	 * could overtake the data. Local states (without socket) read replies right after
+	 * the handler has returned, so they are always served synchronously.
+	 */
+	if (c->read_queue && size && last && size <= EBLOB_READ_ASYNC_MAX_SIZE &&
+			!(cmd->flags & (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE)) &&
+			!(io->flags & DNET_IO_FLAGS_SKIP_SENDING) &&
+			((struct dnet_net_state *)state)->write_s >= 0) {
+		err = blob_read_queue_submit(c->read_queue, state, cmd, io, fd, offset, on_close);
+		if (err != -EAGAIN)
+			goto err_out_exit;
+	}
+
+	if ((cmd->flags & DNET_FLAGS_MORE) && size && size <= EBLOB_READ_COALESCE_MAX_SIZE &&
+			!(io->flags & DNET_IO_FLAGS_SKIP_SENDING)) {
+		err = blob_read_buffered(c->buf_pool, state, cmd, io, fd, offset, on_close);
+		goto err_out_exit;
+	}
+
 	err = dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
 
 err_out_exit:
@@ -923,6 +1244,85 @@ err_out_exit:
 	return err;
 }
 
+struct eblob_bulk_read_location {
+	uint64_t		index;
+	int			fd;
+	uint64_t		offset;
+};
+
+static int eblob_bulk_read_location_compare(const void *l1, const void *l2)
+{
+	const struct eblob_bulk_read_location *loc1 = l1;
+	const struct eblob_bulk_read_location *loc2 = l2;
+
+	if (loc1->fd != loc2->fd)
+		return loc1->fd < loc2->fd ? -1 : 1;
+
+	if (loc1->offset != loc2->offset)
+		return loc1->offset < loc2->offset ? -1 : 1;
+
+	return 0;
+}
+
+/*
+ * Sorts keys of bulk read by blob file and offset and asks kernel to read their data ahead,
+ * so that disk reads of all keys are issued at once and are served in on-disk order.
+ * Missing keys are put first, they are answered without touching the disk.
+ */
+static int eblob_backend_bulk_read_prepare(void *priv, const struct dnet_io_attr *ios, uint64_t num, uint64_t *order)
+{
+	struct eblob_backend_config *c = priv;
+	struct eblob_bulk_read_location *locations;
+	struct eblob_write_control wc;
+	struct eblob_key key;
+	struct dnet_io_attr io;
+	uint64_t i, size;
+	int err;
+
+	locations = malloc(num * sizeof(struct eblob_bulk_read_location));
+	if (!locations)
+		return -ENOMEM;
+
+	for (i = 0; i < num; ++i) {
+		io = ios[i];
+		dnet_convert_io_attr(&io);
+
+		locations[i].index = i;
+		locations[i].fd = -1;
+		locations[i].offset = 0;
+
+		memcpy(key.id, io.id, EBLOB_ID_SIZE);
+		err = blob_lookup(c->eblob, &key, &wc);
+		if (err < 0)
+			continue;
+
+		locations[i].fd = wc.data_fd;
+		locations[i].offset = wc.data_offset;
+
+		/* extended header is read together with requested part of the record */
+		size = wc.total_data_size;
+		if (io.size) {
+			uint64_t end = io.offset + io.size;
+
+			if (wc.flags & BLOB_DISK_CTL_EXTHDR)
+				end += sizeof(struct dnet_ext_list_hdr);
+			if (end < size)
+				size = end;
+		}
+
+		if (size)
+			posix_fadvise(wc.data_fd, wc.data_offset, size, POSIX_FADV_WILLNEED);
+	}
+
+	qsort(locations, num, sizeof(struct eblob_bulk_read_location), eblob_bulk_read_location_compare);
+
+	for (i = 0; i < num; ++i)
+		order[i] = locations[i].index;
+
+	free(locations);
+	return 0;
+}
+
 static int blob_defrag_status(void *priv)
 {
 	struct eblob_backend_config *c = priv;
@@ -1120,10 +1520,10 @@ err_out_exit:
 
 static int eblob_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
 {
-	FORMATTED(HANDY_TIMER_SCOPE, ("eblob_backend.cmd.%s", dnet_cmd_string(cmd->cmd)));
-
-	int err;
 	struct eblob_backend_config *c = priv;
+	int err;
+
+	HANDY_TIMER_SCOPE(dnet_cmd_stat_name(&c->cmd_stat_names, cmd->cmd));
 
 	switch (cmd->cmd) {
 		case DNET_CMD_LOOKUP:
@@ -1317,6 +1717,24 @@ static int dnet_blob_set_blob_flags(struct dnet_config_backend *b,
 	return 0;
 }
 
+static int dnet_blob_set_read_queue_depth(struct dnet_config_backend *b,
+                                          const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->read_queue_depth = strtoul(value, NULL, 0);
+	return 0;
+}
+
+static int dnet_blob_set_read_threads(struct dnet_config_backend *b,
+                                      const char *key __unused, const char *value)
+{
+	struct eblob_backend_config *c = b->data;
+
+	c->read_threads = strtoul(value, NULL, 0);
+	return 0;
+}
+
 static int dnet_blob_set_backend_id(struct dnet_config_backend *b,
                                     const char *key __unused, const char *value) {
 	struct eblob_backend_config *c = b->data;
@@ -1348,8 +1766,15 @@ static void eblob_backend_cleanup(void *priv)
 {
 	struct eblob_backend_config *c = priv;
 
+	/* reader threads use blob files, so they are stopped first */
+	blob_read_queue_cleanup(c);
+
 	eblob_cleanup(c->eblob);
 
+	/* buffers which are still queued for sending are released into heap */
+	dnet_io_buf_pool_destroy(c->buf_pool);
+	c->buf_pool = NULL;
+
 	pthread_mutex_destroy(&c->last_read_lock);
 }
 
@@ -1488,6 +1913,18 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 
 	c->vm_total = st.vm_total * st.vm_total * 1024 * 1024;
 
+	dnet_cmd_stat_names_init(&c->cmd_stat_names, "eblob_backend.cmd");
+
+	c->buf_pool = dnet_io_buf_pool_create();
+	if (!c->buf_pool) {
+		err = -ENOMEM;
+		goto err_out_eblob_cleanup;
+	}
+
+	err = blob_read_queue_init(c);
+	if (err)
+		goto err_out_pool_destroy;
+
 	b->cb.storage_stat_json = eblob_backend_storage_stat_json;
 	b->cb.total_elements = eblob_backend_total_elements;
 
@@ -1496,6 +1933,8 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 	b->cb.backend_cleanup = eblob_backend_cleanup;
 	b->cb.checksum = eblob_backend_checksum;
 	b->cb.lookup = eblob_backend_lookup;
+	b->cb.read_queue_stat = eblob_backend_read_queue_stat;
+	b->cb.bulk_read_prepare = eblob_backend_bulk_read_prepare;
 
 	b->cb.iterator = dnet_eblob_iterator;
 
@@ -1505,6 +1944,12 @@ static int dnet_blob_config_init(struct dnet_config_backend *b)
 
 	return 0;
 
+err_out_pool_destroy:
+	dnet_io_buf_pool_destroy(c->buf_pool);
+	c->buf_pool = NULL;
+err_out_eblob_cleanup:
+	eblob_cleanup(c->eblob);
+	c->eblob = NULL;
 err_out_last_read_lock_destroy:
 	pthread_mutex_destroy(&c->last_read_lock);
 err_out_exit:
@@ -1552,6 +1997,8 @@ static struct dnet_config_entry dnet_cfg_entries_blobsystem[] = {
 	{"index_block_size", dnet_blob_set_index_block_size},
 	{"index_block_bloom_length", dnet_blob_set_index_block_bloom_length},
 	{"periodic_timeout", dnet_blob_set_periodic_timeout},
+	{"read_queue_depth", dnet_blob_set_read_queue_depth},
+	{"read_threads", dnet_blob_set_read_threads},
 	{"backend_id", dnet_blob_set_backend_id}
 };
 
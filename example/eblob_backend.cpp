@@ -49,6 +49,8 @@ int dnet_blob_config_to_json(struct dnet_config_backend *b, char **json_stat, si
 	doc.AddMember("blob_size_limit", c->data.blob_size_limit, allocator);
 	doc.AddMember("defrag_time", c->data.defrag_time, allocator);
 	doc.AddMember("defrag_splay", c->data.defrag_splay, allocator);
+	doc.AddMember("read_queue_depth", c->read_queue_depth, allocator);
+	doc.AddMember("read_threads", c->read_threads, allocator);
 
 	rapidjson::StringBuffer buffer;
 	rapidjson::Writer<rapidjson::StringBuffer> writer(buffer);
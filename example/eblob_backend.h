@@ -25,12 +25,15 @@
 #include <eblob/blob.h>
 
 #include "elliptics/interface.h"
+#include "library/elliptics.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 struct dnet_config_backend;
+struct eblob_read_queue;
+struct dnet_io_buf_pool;
 
 struct eblob_read_params {
 	int			fd;
@@ -49,6 +52,21 @@ struct eblob_backend_config {
 	int				random_access;
 	int				last_read_index;
 	struct eblob_read_params	last_reads[100];
+
+	/* Cache of buffers records are read into before sending */
+	struct dnet_io_buf_pool		*buf_pool;
+
+	/*
+	 * Asynchronous reads: when @read_queue_depth is not zero, data is read by
+	 * @read_threads dedicated threads into memory buffers instead of being sent
+	 * by network threads from the blob file, at most @read_queue_depth reads can be in flight.
+	 */
+	int				read_queue_depth;
+	int				read_threads;
+	struct eblob_read_queue		*read_queue;
+
+	/* timers of commands handled by backend */
+	struct dnet_cmd_stat_names	cmd_stat_names;
 };
 
 int dnet_blob_config_to_json(struct dnet_config_backend *b, char **json_stat, size_t *size);
@@ -36,7 +36,8 @@ INIT_CALLBACK_TYPE(read_result_entry,
 
 INIT_CALLBACK_TYPE(lookup_result_entry,
 	DNET_CMD_LOOKUP,
-	DNET_CMD_WRITE
+	DNET_CMD_WRITE,
+	DNET_CMD_BULK_WRITE
 )
 
 INIT_CALLBACK_TYPE(monitor_stat_result_entry,
@@ -77,6 +77,13 @@
 
 #define DNET_DEFAULT_CACHE_SYNC_TIMEOUT_SEC 30
 
+/*
+ * Default number of threads which sync dirty cache objects of one backend
+ * and maximum number of objects synced by one thread in a row.
+ */
+#define DNET_DEFAULT_CACHE_SYNC_THREADS 4
+#define DNET_DEFAULT_CACHE_SYNC_BATCH 64
+
 #define DNET_DEFAULT_STALL_TRANSACTIONS 3
 
 #define DNET_DEFAULT_INDEXES_SHARD_COUNT 16
@@ -0,0 +1,174 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_ID_COMPARE_H
+#define __DNET_ID_COMPARE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <elliptics/core.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * IDs are compared as big-endian byte strings.
+ * Comparison is vectorized with AVX2 or SSE2 when compiler targets them,
+ * otherwise IDs are compared by 8-byte words converted to host byte order.
+ */
+
+/*
+ * Returns first 8 bytes of @id as host-order integer,
+ * prefixes compare in the same order as IDs they were taken from.
+ */
+static inline uint64_t dnet_id_prefix(const unsigned char *id)
+{
+	uint64_t prefix;
+
+	memcpy(&prefix, id, sizeof(prefix));
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+	prefix = __builtin_bswap64(prefix);
+#endif
+	return prefix;
+}
+
+static inline int dnet_id_cmp_byte(const unsigned char *id1, const unsigned char *id2, unsigned int pos)
+{
+	return id1[pos] < id2[pos] ? -1 : 1;
+}
+
+/*
+ * Compare two raw IDs of DNET_ID_SIZE bytes.
+ * Returns  1 when id1 > id2
+ *         -1 when id1 < id2
+ *          0 when id1 = id2
+ */
+static inline int dnet_id_cmp_raw(const unsigned char *id1, const unsigned char *id2)
+{
+	unsigned int i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= DNET_ID_SIZE; i += 32) {
+		const __m256i a = _mm256_loadu_si256((const __m256i *)(id1 + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i *)(id2 + i));
+		const unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+
+		if (mask != 0xffffffffU)
+			return dnet_id_cmp_byte(id1, id2, i + __builtin_ctz(~mask));
+	}
+#endif
+#if defined(__SSE2__)
+	for (; i + 16 <= DNET_ID_SIZE; i += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)(id1 + i));
+		const __m128i b = _mm_loadu_si128((const __m128i *)(id2 + i));
+		const unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+
+		if (mask != 0xffffU)
+			return dnet_id_cmp_byte(id1, id2, i + __builtin_ctz(~mask));
+	}
+#endif
+	for (; i + 8 <= DNET_ID_SIZE; i += 8) {
+		const uint64_t a = dnet_id_prefix(id1 + i);
+		const uint64_t b = dnet_id_prefix(id2 + i);
+
+		if (a != b)
+			return a < b ? -1 : 1;
+	}
+
+	for (; i < DNET_ID_SIZE; ++i) {
+		if (id1[i] != id2[i])
+			return dnet_id_cmp_byte(id1, id2, i);
+	}
+
+	return 0;
+}
+
+/*
+ * Returns non-zero if raw IDs are equal, cheaper than dnet_id_cmp_raw() since
+ * position of the first differing byte is not needed.
+ */
+static inline int dnet_id_equal_raw(const unsigned char *id1, const unsigned char *id2)
+{
+	unsigned int i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= DNET_ID_SIZE; i += 32) {
+		const __m256i a = _mm256_loadu_si256((const __m256i *)(id1 + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i *)(id2 + i));
+
+		if ((unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b)) != 0xffffffffU)
+			return 0;
+	}
+#endif
+#if defined(__SSE2__)
+	for (; i + 16 <= DNET_ID_SIZE; i += 16) {
+		const __m128i a = _mm_loadu_si128((const __m128i *)(id1 + i));
+		const __m128i b = _mm_loadu_si128((const __m128i *)(id2 + i));
+
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xffff)
+			return 0;
+	}
+#endif
+	return !memcmp(id1 + i, id2 + i, DNET_ID_SIZE - i);
+}
+
+/*
+ * Searches sorted array of @num IDs for the largest one which is not greater than @id.
+ * @prefixes holds dnet_id_prefix() of every ID, the search runs over this compact array
+ * and full IDs (located at the beginning of every @entry_size bytes long element of @entries)
+ * are compared only for elements whose prefix equals to the prefix of @id.
+ *
+ * Returns position of found ID or -1 if all IDs are greater than @id.
+ */
+static inline int dnet_id_prefix_search(const uint64_t *prefixes, const void *entries, size_t entry_size,
+		int num, const unsigned char *id)
+{
+	const uint64_t prefix = dnet_id_prefix(id);
+	int low = 0, high = num, i;
+
+	while (low < high) {
+		i = low + (high - low) / 2;
+
+		if (prefixes[i] <= prefix)
+			low = i + 1;
+		else
+			high = i;
+	}
+
+	for (i = low - 1; i >= 0 && prefixes[i] == prefix; --i) {
+		const unsigned char *entry_id = (const unsigned char *)entries + i * entry_size;
+
+		if (dnet_id_cmp_raw(entry_id, id) <= 0)
+			break;
+	}
+
+	return i;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_ID_COMPARE_H */
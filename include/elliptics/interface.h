@@ -36,6 +36,7 @@
 #include <netinet/in.h>
 
 #include <elliptics/packet.h>
+#include <elliptics/id_compare.h>
 #include <elliptics/srw.h>
 
 #include "logger.hpp"
@@ -176,6 +177,7 @@ int __attribute__((weak)) dnet_send_read_data(void *state, struct dnet_cmd *cmd,
 #define DNET_CFG_NO_CSUM		(1<<3)		/* globally disable checksum verification and update */
 #define DNET_CFG_RANDOMIZE_STATES	(1<<5)		/* randomize states for read requests */
 #define DNET_CFG_KEEPS_IDS_IN_CLUSTER	(1<<6)		/* keeps ids in elliptics cluster */
+#define DNET_CFG_SHARDED_REQUEST_QUEUE	(1<<7)		/* use sharded request queue in IO pools */
 
 static inline const char *dnet_flags_dump_cfgflags(uint64_t flags)
 {
@@ -187,6 +189,7 @@ static inline const char *dnet_flags_dump_cfgflags(uint64_t flags)
 		{ DNET_CFG_NO_CSUM, "no_csum" },
 		{ DNET_CFG_RANDOMIZE_STATES, "randomize_states" },
 		{ DNET_CFG_KEEPS_IDS_IN_CLUSTER, "keeps_ids_in_cluster" },
+		{ DNET_CFG_SHARDED_REQUEST_QUEUE, "sharded_request_queue" },
 	};
 
 	dnet_flags_dump_raw(buffer, sizeof(buffer), flags, infos, sizeof(infos) / sizeof(infos[0]));
@@ -256,6 +259,22 @@ struct dnet_io_local
 	uint64_t		reserved[8];
 };
 
+/*
+ * Statistics of backend's asynchronous read queue
+ */
+struct dnet_backend_read_queue_stat {
+	/* maximum number of reads which can be queued or processed at once, 0 if asynchronous reads are disabled */
+	uint64_t		queue_depth;
+	/* number of threads which process queued reads */
+	uint64_t		threads;
+	/* number of reads which are currently queued or processed */
+	uint64_t		in_flight;
+	/* number of reads completed asynchronously */
+	uint64_t		completed;
+	/* number of reads served synchronously because queue was full */
+	uint64_t		queue_full;
+};
+
 struct dnet_backend_callbacks {
 	/* command handler processes DNET_CMD_* commands */
 	int			(* command_handler)(void *state, void *priv, struct dnet_cmd *cmd, void *data);
@@ -296,6 +315,16 @@ struct dnet_backend_callbacks {
 	char *			(* dir)(void);
 
 	int			(* lookup)(struct dnet_node *n, void *priv, struct dnet_io_local *io);
+
+	/* fills statistics of asynchronous read queue, optional */
+	void			(* read_queue_stat)(void *priv, struct dnet_backend_read_queue_stat *stat);
+
+	/*
+	 * Prepares bulk read of @num keys described by @ios (in network byte order), optional.
+	 * Fills @order with indexes of @ios in the order they should be read in
+	 * (usually sorted by on-disk location) and may start asynchronous prefetch of their data.
+	 */
+	int			(* bulk_read_prepare)(void *priv, const struct dnet_io_attr *ios, uint64_t num, uint64_t *order);
 };
 
 /*
@@ -379,7 +408,13 @@ struct dnet_config
 	/* Config values for srw backend */
 	struct srw_init_ctl	srw;
 
-	int			reserved_for_future_use_2[5];
+	/*
+	 * Number of TCP connections opened to every remote node, requests which carry or read
+	 * large amounts of data are striped over additional ones. Zero means single connection.
+	 */
+	int			net_lanes;
+
+	int			reserved_for_future_use_2[4];
 
 	/* Config file name for handystats library */
 	const char 	*handystats_config;
@@ -553,6 +588,12 @@ int dnet_create_addr_str(struct dnet_addr *addr, const char *addr_str, int addr_
 
 int dnet_state_num(struct dnet_session *s);
 int dnet_node_state_num(struct dnet_node *n);
+
+/*
+ * Returns number of connected lanes to @addr, primary connection included,
+ * or -ENXIO if there is no state with such address.
+ */
+int dnet_state_lanes(struct dnet_session *s, const struct dnet_addr *addr);
 struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const struct dnet_addr *addr);
 struct dnet_net_state *dnet_state_get_first(struct dnet_node *n, const struct dnet_id *id);
 struct dnet_net_state *dnet_state_get_first_with_backend(struct dnet_node *n, const struct dnet_id *id, int *backend_id);
@@ -675,16 +716,7 @@ static inline int dnet_time_cmp(const struct dnet_time *t1, const struct dnet_ti
  */
 static inline int dnet_id_cmp_str(const unsigned char *id1, const unsigned char *id2)
 {
-	unsigned int i = 0;
-
-	for (i*=sizeof(unsigned long); i<DNET_ID_SIZE; ++i) {
-		if (id1[i] < id2[i])
-			return -1;
-		if (id1[i] > id2[i])
-			return 1;
-	}
-
-	return 0;
+	return dnet_id_cmp_raw(id1, id2);
 }
 static inline int dnet_id_cmp(const struct dnet_id *id1, const struct dnet_id *id2)
 {
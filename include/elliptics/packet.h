@@ -76,6 +76,7 @@ enum dnet_commands {
 	DNET_CMD_BACKEND_CONTROL,		/* Special command to start or stop backends */
 	DNET_CMD_BACKEND_STATUS,		/* Special command to see current statuses of backends */
 	DNET_CMD_SEND,				/* Send given set of local keys to remote groups */
+	DNET_CMD_BULK_WRITE,			/* Write a number of ids at one time */
 	DNET_CMD_UNKNOWN,			/* This slot is allocated for statistics gathered for unknown commands */
 	__DNET_CMD_MAX,
 };
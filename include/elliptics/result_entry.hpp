@@ -347,7 +347,7 @@ static inline bool operator ==(const ioremap::elliptics::data_pointer &a, const
 static inline bool operator ==(const ioremap::elliptics::index_entry &a, const ioremap::elliptics::index_entry &b)
 {
 	return a.data.size() == b.data.size()
-		&& memcmp(b.index.id, a.index.id, sizeof(b.index.id)) == 0
+		&& dnet_id_equal_raw(b.index.id, a.index.id)
 		&& memcmp(a.data.data(), b.data.data(), a.data.size()) == 0;
 }
 
@@ -358,7 +358,7 @@ struct dnet_raw_id_less_than
 {
 	inline bool operator() (const dnet_raw_id &a, const dnet_raw_id &b) const
 	{
-		return memcmp(a.id, b.id, sizeof(a.id)) < 0;
+		return dnet_id_cmp_raw(a.id, b.id) < 0;
 	}
 	inline bool operator() (const index_entry &a, const dnet_raw_id &b) const
 	{
@@ -370,7 +370,7 @@ struct dnet_raw_id_less_than
 	}
 	inline bool operator() (const index_entry &a, const index_entry &b) const
 	{
-		ssize_t cmp = memcmp(a.index.id, b.index.id, sizeof(b.index.id));
+		ssize_t cmp = dnet_id_cmp_raw(a.index.id, b.index.id);
 		if (CompareData && cmp == 0) {
 			cmp = a.data.size() - b.data.size();
 			if (cmp == 0) {
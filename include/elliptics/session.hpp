@@ -619,6 +619,13 @@ class session
 		 */
 		int state_num();
 
+		/*!
+		 * Returns the number of connections to the server node \a addr, primary one included.
+		 *
+		 * Returns -ENXIO if session is not connected to \a addr.
+		 */
+		int state_lanes(const address &addr);
+
 		/*!
 		 * Requests execution of custom command at all backends of all server nodes.
 		 *
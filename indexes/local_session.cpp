@@ -112,7 +112,7 @@ data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_t
 
 	struct dnet_io_req *r, *tmp;
 
-	list_for_each_entry_safe(r, tmp, &m_state->send_list, req_entry) {
+	list_for_each_entry_safe(r, tmp, &m_state->send_list[DNET_SEND_CLASS_CONTROL], req_entry) {
 		dnet_log(m_state->n, DNET_LOG_DEBUG, "hsize: %zu, dsize: %zu", r->hsize, r->dsize);
 
 		dnet_cmd *req_cmd = reinterpret_cast<dnet_cmd *>(r->header ? r->header : r->data);
@@ -224,7 +224,7 @@ data_pointer local_session::lookup(const dnet_cmd &tmp_cmd, int *errp)
 
 	struct dnet_io_req *r, *tmp;
 
-	list_for_each_entry_safe(r, tmp, &m_state->send_list, req_entry) {
+	list_for_each_entry_safe(r, tmp, &m_state->send_list[DNET_SEND_CLASS_CONTROL], req_entry) {
 		dnet_cmd *req_cmd = reinterpret_cast<dnet_cmd *>(r->header ? r->header : r->data);
 
 		if (req_cmd->status) {
@@ -331,7 +331,7 @@ void local_session::clear_queue(int *errp)
 {
 	struct dnet_io_req *r, *tmp;
 
-	list_for_each_entry_safe(r, tmp, &m_state->send_list, req_entry) {
+	list_for_each_entry_safe(r, tmp, &m_state->send_list[DNET_SEND_CLASS_CONTROL], req_entry) {
 		dnet_cmd *cmd = reinterpret_cast<dnet_cmd *>(r->header ? r->header : r->data);
 
 		if (errp && cmd->status)
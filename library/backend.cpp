@@ -835,6 +835,10 @@ void dnet_backend_info::parse(ioremap::elliptics::config::config_data *data,
 		cache_config = blackhole::utils::make_unique<ioremap::cache::cache_config>(*data->cache_config);
 	}
 
+	if (cache_config && cache_config->snapshot) {
+		cache_config->snapshot_path = history + "/cache.snapshot";
+	}
+
 	io_thread_num = backend.at("io_thread_num", data->cfg_state.io_thread_num);
 	nonblocking_io_thread_num = backend.at("nonblocking_io_thread_num", data->cfg_state.nonblocking_io_thread_num);
 
@@ -22,9 +22,33 @@ namespace ioremap { namespace cache {
 struct cache_config
 {
 	size_t			size;
+	/*
+	 * number of shards, "shards" option, 16 by default,
+	 * it is rounded up to a power of two and limited by 1024 when cache is created
+	 */
 	size_t			count;
 	unsigned		sync_timeout;
+	/* number of threads which write dirty objects of all shards to the backend */
+	unsigned		sync_threads;
+	/* number of neighbour keys written by one thread in a row */
+	unsigned		sync_batch;
+	/* maximum number of objects written per second, 0 - unlimited */
+	unsigned		sync_rate;
 	std::vector<size_t>	pages_proportions;
+	/* take cached objects from size-classed slabs instead of the system heap */
+	bool			slab_allocator;
+	/* admission policy of new objects: "none" or "tinylfu" */
+	std::string		admission;
+	/* codec of objects demoted into the coldest pages: "none" or "zlib" */
+	std::string		compression;
+	/* number of the coldest pages which keep objects compressed */
+	unsigned		compressed_pages;
+	/* keep clean objects in snapshot file between restarts */
+	bool			snapshot;
+	/* seconds between periodic snapshots, 0 - snapshot is written only on shutdown */
+	unsigned		snapshot_interval;
+	/* snapshot file in backend's history directory, empty if snapshot is disabled */
+	std::string		snapshot_path;
 
 	static std::unique_ptr<cache_config> parse(const ioremap::elliptics::config::config &cache);
 };
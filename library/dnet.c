@@ -282,7 +282,6 @@ int dnet_send_reply(void *state, struct dnet_cmd *cmd, const void *odata, unsign
 	struct dnet_net_state *st = state;
 	struct dnet_cmd *c;
 	void *data;
-	int err;
 
 	c = calloc(1, sizeof(struct dnet_cmd) + size);
 	if (!c)
@@ -308,10 +307,8 @@ int dnet_send_reply(void *state, struct dnet_cmd *cmd, const void *odata, unsign
 
 	dnet_convert_cmd(c);
 
-	err = dnet_send(st, c, sizeof(struct dnet_cmd) + size);
-	free(c);
-
-	return err;
+	/* @c is released by send queue after it has been sent */
+	return dnet_send_data_nocopy(st, c, sizeof(struct dnet_cmd) + size, NULL, 0, free, c);
 }
 
 static void dnet_queue_wait_threshold(struct dnet_net_state *st)
@@ -1276,7 +1273,8 @@ static int dnet_cmd_bulk_read(struct dnet_backend_io *backend, struct dnet_net_s
 	struct dnet_io_attr *io = data;
 	struct dnet_io_attr *ios = io + 1;
 	uint64_t count = 0;
-	uint64_t i;
+	uint64_t i, idx;
+	uint64_t *order = NULL;
 	int use_oplock;
 	struct dnet_id lock_id = { .group_id = cmd->id.group_id };
 
@@ -1291,21 +1289,35 @@ static int dnet_cmd_bulk_read(struct dnet_backend_io *backend, struct dnet_net_s
 	dnet_log(st->n, DNET_LOG_NOTICE, "%s: starting BULK_READ for %d commands",
 		dnet_dump_id(&cmd->id), (int) count);
 
+	/*
+	 * Let backend choose the order keys are read in and prefetch their data,
+	 * keys are processed in the order they were sent if it can not.
+	 */
+	if (count > 1 && backend->cb->bulk_read_prepare) {
+		order = malloc(count * sizeof(uint64_t));
+		if (order && backend->cb->bulk_read_prepare(backend->cb->command_private, ios, count, order)) {
+			free(order);
+			order = NULL;
+		}
+	}
+
 	for (i = 0; i < count; i++) {
+		idx = order ? order[i] : i;
+
 		/*
 		 * First key is already locked by request_queue::take_request().
-		 * Check that i-th key is not equal to the first key.
+		 * Check that idx-th key is not equal to the first key.
 		 */
-		use_oplock = (i > 0) && !(cmd->flags & DNET_FLAGS_NOLOCK) &&
-					!dnet_id_cmp_str((const unsigned char *)&ios[i].id, (const unsigned char *)&cmd->id.id);
+		use_oplock = (idx > 0) && !(cmd->flags & DNET_FLAGS_NOLOCK) &&
+					!dnet_id_cmp_str((const unsigned char *)&ios[idx].id, (const unsigned char *)&cmd->id.id);
 		if (use_oplock) {
-			memcpy(&lock_id.id, &ios[i].id, DNET_ID_SIZE);
+			memcpy(&lock_id.id, &ios[idx].id, DNET_ID_SIZE);
 			dnet_oplock(backend, &lock_id);
 		}
 
-		ret = dnet_process_cmd_raw(backend, st, &read_cmd, &ios[i], 1);
+		ret = dnet_process_cmd_raw(backend, st, &read_cmd, &ios[idx], 1);
 		dnet_log(st->n, DNET_LOG_NOTICE, "%s: processing BULK_READ.READ for %d/%d command, err: %d",
-			dnet_dump_id(&cmd->id), (int) i, (int) count, ret);
+			dnet_dump_id(&cmd->id), (int) idx, (int) count, ret);
 
 		if (use_oplock) {
 			dnet_opunlock(backend, &lock_id);
@@ -1317,6 +1329,97 @@ static int dnet_cmd_bulk_read(struct dnet_backend_io *backend, struct dnet_net_s
 			err = ret;
 	}
 
+	free(order);
+	return err;
+}
+
+/*
+ * BULK_WRITE carries dnet_io_attr header whose @num is the number of records,
+ * every record is dnet_io_attr followed by its data of @size bytes.
+ * Records are processed one by one as WRITE commands within the same transaction,
+ * thus every key gets its own reply (or acknowledge with error) which carries key's status.
+ */
+static int dnet_cmd_bulk_write(struct dnet_backend_io *backend, struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	int err = 0, ret;
+	struct dnet_io_attr *io = data;
+	struct dnet_io_attr *rio, tmp;
+	unsigned char *records = (unsigned char *)(io + 1);
+	uint64_t size, offset, count, i;
+	int use_oplock;
+	struct dnet_id lock_id = { .group_id = cmd->id.group_id };
+	struct dnet_cmd write_cmd;
+
+	if (cmd->size < sizeof(struct dnet_io_attr)) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid BULK_WRITE: cmd.size: %llu",
+			dnet_dump_id(&cmd->id), (unsigned long long)cmd->size);
+		return -EINVAL;
+	}
+
+	dnet_convert_io_attr(io);
+	count = io->num;
+	size = cmd->size - sizeof(struct dnet_io_attr);
+
+	/* Check the whole packet first, so that malformed one does not get partially written */
+	for (i = 0, offset = 0; i < count; ++i) {
+		if (size - offset < sizeof(struct dnet_io_attr))
+			break;
+
+		tmp = *(struct dnet_io_attr *)(records + offset);
+		dnet_convert_io_attr(&tmp);
+		offset += sizeof(struct dnet_io_attr);
+
+		if (size - offset < tmp.size)
+			break;
+		offset += tmp.size;
+	}
+
+	if (i != count || offset != size) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid BULK_WRITE: records: %llu/%llu, size: %llu/%llu",
+			dnet_dump_id(&cmd->id), (unsigned long long)i, (unsigned long long)count,
+			(unsigned long long)offset, (unsigned long long)size);
+		return -EINVAL;
+	}
+
+	dnet_log(st->n, DNET_LOG_NOTICE, "%s: starting BULK_WRITE for %llu commands",
+		dnet_dump_id(&cmd->id), (unsigned long long)count);
+
+	for (i = 0, offset = 0; i < count; ++i) {
+		rio = (struct dnet_io_attr *)(records + offset);
+
+		tmp = *rio;
+		dnet_convert_io_attr(&tmp);
+		offset += sizeof(struct dnet_io_attr) + tmp.size;
+
+		write_cmd = *cmd;
+		write_cmd.cmd = DNET_CMD_WRITE;
+		write_cmd.size = sizeof(struct dnet_io_attr) + tmp.size;
+		write_cmd.flags |= DNET_FLAGS_MORE | DNET_FLAGS_NEED_ACK;
+		dnet_setup_id(&write_cmd.id, cmd->id.group_id, tmp.id);
+
+		/*
+		 * Queue does not lock key of BULK_WRITE, see dnet_request_locks_key(),
+		 * so every record is locked on its own and only one lock is held at a time
+		 */
+		use_oplock = !(cmd->flags & DNET_FLAGS_NOLOCK);
+		if (use_oplock) {
+			memcpy(&lock_id.id, write_cmd.id.id, DNET_ID_SIZE);
+			dnet_oplock(backend, &lock_id);
+		}
+
+		ret = dnet_process_cmd_raw(backend, st, &write_cmd, rio, 1);
+		dnet_log(st->n, DNET_LOG_NOTICE, "%s: processing BULK_WRITE.WRITE for %llu/%llu command, err: %d",
+			dnet_dump_id(&write_cmd.id), (unsigned long long)i, (unsigned long long)count, ret);
+
+		if (use_oplock) {
+			dnet_opunlock(backend, &lock_id);
+		}
+
+		/* batch fails with the first error, other records are written anyway */
+		if (ret && !err)
+			err = ret;
+	}
+
 	return err;
 }
 
@@ -1552,6 +1655,13 @@ static int dnet_process_cmd_with_backend_raw(struct dnet_backend_io *backend, st
 				err = dnet_cmd_bulk_read(backend, st, cmd, data);
 			}
 			break;
+		case DNET_CMD_BULK_WRITE:
+			err = backend->cb->command_handler(st, backend->cb->command_private, cmd, data);
+
+			if (err == -ENOTSUP) {
+				err = dnet_cmd_bulk_write(backend, st, cmd, data);
+			}
+			break;
 		case DNET_CMD_READ:
 		case DNET_CMD_WRITE:
 		case DNET_CMD_DEL:
@@ -1660,7 +1770,7 @@ int dnet_process_cmd_raw(struct dnet_backend_io *backend, struct dnet_net_state
 	int handled_in_cache = 0;
 
 	HANDY_TIMER_SCOPE(recursive ? "io.cmd_recursive" : "io.cmd");
-	FORMATTED(HANDY_TIMER_SCOPE, ("io.cmd%s.%s", (recursive ? "_recursive" : ""), dnet_cmd_string(cmd->cmd)));
+	HANDY_TIMER_SCOPE(dnet_cmd_stat_name(&n->cmd_stat_names[!!recursive], cmd->cmd));
 
 	gettimeofday(&start, NULL);
 
@@ -1727,14 +1837,38 @@ int dnet_process_cmd_raw(struct dnet_backend_io *backend, struct dnet_net_state
 	return err;
 }
 
-int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
-		int fd, uint64_t offset, int on_exit)
+/*
+ * Reply header of READ command, it is queued for sending together with the data it describes
+ * and owns that data if @destroy is set.
+ */
+struct dnet_read_data_reply {
+	void			(* destroy)(void *priv);
+	void			*priv;
+	struct dnet_cmd		cmd;
+	struct dnet_io_attr	io;
+	/* copy of the data follows if it is not owned by caller */
+};
+
+static void dnet_read_data_reply_destroy(void *priv)
+{
+	struct dnet_read_data_reply *reply = priv;
+
+	if (reply->destroy)
+		reply->destroy(reply->priv);
+	free(reply);
+}
+
+static int dnet_send_read_data_raw(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		int fd, uint64_t offset, int on_exit, int nocopy, void (* destroy)(void *priv), void *priv)
 {
 	struct dnet_net_state *st = state;
 	struct dnet_node *n = st->n;
+	struct dnet_read_data_reply *reply;
+	struct dnet_id id;
 	struct dnet_cmd *c;
 	struct dnet_io_attr *rio;
 	int hsize = sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr);
+	size_t copy_size = 0;
 	int err;
 	long csum_time, send_time, total_time;
 	struct timeval start_tv, csum_tv, send_tv;
@@ -1745,20 +1879,38 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 	 * back to parental client, instead server will wrap data into
 	 * proper transaction reply next to this obscure packet.
 	 */
-	if (io->flags & DNET_IO_FLAGS_SKIP_SENDING)
-		return 0;
+	if (io->flags & DNET_IO_FLAGS_SKIP_SENDING) {
+		err = 0;
+		goto err_out_destroy;
+	}
+
+	/* caller which hands data over must provide it, there is no file to send instead */
+	if (nocopy && !data) {
+		err = -EINVAL;
+		goto err_out_destroy;
+	}
 
 	gettimeofday(&start_tv, NULL);
 
-	c = calloc(1, hsize);
-	if (!c) {
+	/* Data which is not owned by the caller is copied right after the header in the same buffer */
+	if (data && !nocopy)
+		copy_size = io->size;
+
+	reply = malloc(sizeof(struct dnet_read_data_reply) + copy_size);
+	if (!reply) {
 		err = -ENOMEM;
-		goto err_out_exit;
+		goto err_out_destroy;
 	}
+	memset(reply, 0, sizeof(struct dnet_read_data_reply));
 
-	rio = (struct dnet_io_attr *)(c + 1);
+	reply->destroy = destroy;
+	reply->priv = priv;
 
-	dnet_setup_id(&c->id, cmd->id.group_id, io->id);
+	c = &reply->cmd;
+	rio = &reply->io;
+
+	dnet_setup_id(&id, cmd->id.group_id, io->id);
+	c->id = id;
 
 	c->flags = cmd->flags & ~(DNET_FLAGS_NEED_ACK);
 	if (cmd->flags & DNET_FLAGS_NEED_ACK)
@@ -1787,12 +1939,20 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 			goto err_out_free;
 	}
 
+	if (copy_size) {
+		memcpy(reply + 1, data, copy_size);
+		data = reply + 1;
+	}
+
 	gettimeofday(&csum_tv, NULL);
 
-	if (data)
-		err = dnet_send_data(st, c, hsize, data, rio->size);
-	else
+	/* @reply is released by the send queue, it also releases the data if caller handed it over */
+	if (data) {
+		err = dnet_send_data_nocopy(st, c, hsize, data, rio->size, dnet_read_data_reply_destroy, reply);
+	} else {
 		err = dnet_send_fd(st, c, hsize, fd, offset, rio->size, on_exit);
+		dnet_read_data_reply_destroy(reply);
+	}
 
 	gettimeofday(&send_tv, NULL);
 
@@ -1801,17 +1961,32 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 	total_time = DIFF(start_tv, send_tv);
 
 	dnet_log(n, DNET_LOG_INFO, "%s: %s: reply: cflags: %s, %s, csum-time: %ld, send-time: %ld, total-time: %ld usecs.",
-			dnet_dump_id(&c->id), dnet_cmd_string(c->cmd),
+			dnet_dump_id(&id), dnet_cmd_string(DNET_CMD_READ),
 			dnet_flags_dump_cflags(cmd->flags), dnet_print_io(io),
 			csum_time, send_time, total_time);
 
+	return err;
 
 err_out_free:
-	free(c);
-err_out_exit:
+	free(reply);
+err_out_destroy:
+	if (destroy)
+		destroy(priv);
 	return err;
 }
 
+int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		int fd, uint64_t offset, int on_exit)
+{
+	return dnet_send_read_data_raw(state, cmd, io, data, fd, offset, on_exit, 0, NULL, NULL);
+}
+
+int dnet_send_read_data_nocopy(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		void (* destroy)(void *priv), void *priv)
+{
+	return dnet_send_read_data_raw(state, cmd, io, data, -1, 0, 0, 1, destroy, priv);
+}
+
 static void dnet_fill_state_addr(void *state, struct dnet_addr *addr)
 {
 	struct dnet_net_state *st = state;
@@ -164,6 +164,7 @@ static char *dnet_cmd_strings[] = {
 	[DNET_CMD_BACKEND_CONTROL] = "BACKEND_CONTROL",
 	[DNET_CMD_BACKEND_STATUS] = "BACKEND_STATUS",
 	[DNET_CMD_SEND] = "SERVER_SEND",
+	[DNET_CMD_BULK_WRITE] = "BULK_WRITE",
 	[DNET_CMD_UNKNOWN] = "UNKNOWN",
 };
 
@@ -175,6 +176,23 @@ char *dnet_cmd_string(int cmd)
 	return dnet_cmd_strings[cmd];
 }
 
+void dnet_cmd_stat_names_init(struct dnet_cmd_stat_names *names, const char *prefix)
+{
+	int cmd;
+
+	for (cmd = 0; cmd < __DNET_CMD_MAX; ++cmd) {
+		snprintf(names->names[cmd], sizeof(names->names[cmd]), "%s.%s", prefix, dnet_cmd_string(cmd));
+	}
+}
+
+const char *dnet_cmd_stat_name(const struct dnet_cmd_stat_names *names, int cmd)
+{
+	if (cmd <= 0 || cmd >= __DNET_CMD_MAX)
+		cmd = DNET_CMD_UNKNOWN;
+
+	return names->names[cmd];
+}
+
 const char *dnet_backend_state_string(uint32_t state)
 {
 	switch ((enum dnet_backend_state)state) {
@@ -44,6 +44,7 @@ typedef unsigned short u_short;
 #include "list.h"
 
 #include "rbtree.h"
+#include "timer_wheel.h"
 
 #include "atomic.h"
 #include "lock.h"
@@ -124,8 +125,79 @@ struct dnet_io_req {
 	int			fd;
 	off_t			local_offset;
 	size_t			fsize;
+
+	/*
+	 * If @destroy is set, @header and @data are not copied when request is queued for sending,
+	 * request takes their ownership instead and calls @destroy(@destroy_priv)
+	 * when it has been sent or dropped.
+	 */
+	void			(* destroy)(void *priv);
+	void			*destroy_priv;
+
+	/* Receive buffer cache this request has been allocated from, see dnet_io_buf_alloc() */
+	struct dnet_io_buf_pool	*buf_pool;
+	int			buf_class;
+
+	/*
+	 * Send class the request is queued into and stream slot it is counted in,
+	 * -1 if none and DNET_SEND_STREAMS if it is counted as untracked stream reply
+	 */
+	int			send_class;
+	int			send_stream;
 };
 
+/*
+ * Cache of receive buffers (dnet_io_req followed by command and its payload) split into
+ * power-of-two size classes starting from (1 << DNET_IO_BUF_MIN_SHIFT) bytes.
+ * Every network thread has its own cache, buffers can be released by any thread,
+ * they are returned into the cache they were taken from.
+ * Cache is freed when its owner and all allocated buffers have dropped their references.
+ */
+#define DNET_IO_BUF_MIN_SHIFT		9
+#define DNET_IO_BUF_CLASSES		8
+/* Maximum number of bytes kept in every size class */
+#define DNET_IO_BUF_CACHE_SIZE		(1024 * 1024)
+
+struct dnet_io_buf_pool {
+	atomic_t		refcnt;
+	pthread_mutex_t		lock;
+	int			need_exit;
+	struct list_head	free_list[DNET_IO_BUF_CLASSES];
+	int			free_num[DNET_IO_BUF_CLASSES];
+};
+
+struct dnet_io_buf_pool *dnet_io_buf_pool_create(void);
+void dnet_io_buf_pool_destroy(struct dnet_io_buf_pool *pool);
+/*
+ * Allocates buffer of @size bytes which starts with zeroed dnet_io_req structure.
+ * Sizes larger than the biggest size class are allocated from heap directly.
+ */
+struct dnet_io_req *dnet_io_buf_alloc(struct dnet_io_buf_pool *pool, size_t size);
+void dnet_io_buf_free(struct dnet_io_req *r);
+
+/*
+ * Caches of freed transactions (dnet_trans followed by its command) split into power-of-two
+ * size classes starting from (1 << DNET_TRANS_MIN_SHIFT) bytes. Node keeps several caches,
+ * thread allocates from the cache picked by its id, so client threads do not contend on one lock,
+ * transaction is returned into the cache it was taken from.
+ */
+#define DNET_TRANS_MIN_SHIFT		9
+#define DNET_TRANS_CLASSES		4
+#define DNET_TRANS_CACHES		16
+/* Maximum number of bytes kept in every size class of every cache */
+#define DNET_TRANS_CACHE_SIZE		(256 * 1024)
+
+struct dnet_trans_cache {
+	pthread_mutex_t		lock;
+	int			need_exit;
+	struct list_head	free_list[DNET_TRANS_CLASSES];
+	int			free_num[DNET_TRANS_CLASSES];
+};
+
+int dnet_trans_cache_init(struct dnet_node *n);
+void dnet_trans_cache_cleanup(struct dnet_node *n);
+void dnet_trans_cache_destroy(struct dnet_node *n);
+
 /*
  * Currently executed network state machine:
  * receives and sends command and data.
@@ -139,6 +211,45 @@ struct dnet_io_req {
 
 #define DNET_STATE_DEFAULT_WEIGHT	1.0
 
+/*
+ * Maximum number of TCP connections (lanes) opened to every remote node.
+ * Requests which carry or ask for at least DNET_NET_LANE_BULK_SIZE bytes
+ * are sent into additional lanes, so small requests are not queued behind them.
+ */
+#define DNET_NET_LANES_MAX		8
+#define DNET_NET_LANE_BULK_SIZE		(64 * 1024)
+/* Time to wait for connection of additional lane in milliseconds */
+#define DNET_NET_LANE_CONNECT_TIMEOUT	1000
+
+/*
+ * Send queue of every state is split into priority classes served by deficit round robin.
+ * Class is served while its deficit is positive, every round adds (DNET_SEND_QUANTUM << weight) bytes to it,
+ * where weight is 2 for control commands and bare acknowledgements, 1 for small and 0 for bulk requests.
+ * Requests of at least DNET_NET_LANE_BULK_SIZE bytes are bulk ones.
+ * States without socket (local sessions) queue everything into DNET_SEND_CLASS_CONTROL.
+ */
+#define DNET_SEND_CLASS_CONTROL		0
+#define DNET_SEND_CLASS_SMALL		1
+#define DNET_SEND_CLASS_BULK		2
+#define DNET_SEND_CLASSES		3
+#define DNET_SEND_QUANTUM		(64 * 1024)
+
+/*
+ * Replies of one transaction are sent in order, so while transaction has pending non-final replies,
+ * all its replies are queued into the class of the first one. Transactions are tracked in (1 << DNET_SEND_STREAMS_SHIFT)
+ * slots, transaction takes the first free slot among DNET_SEND_STREAMS_PROBE ones starting from hash of its number.
+ * When all of them are busy, replies of untracked transactions are queued into the bulk class until they have been sent.
+ */
+#define DNET_SEND_STREAMS_SHIFT		8
+#define DNET_SEND_STREAMS		(1 << DNET_SEND_STREAMS_SHIFT)
+#define DNET_SEND_STREAMS_PROBE		4
+
+struct dnet_send_stream {
+	uint64_t		trans;
+	int			send_class;
+	int			num;
+};
+
 /* Iterator watermarks for sending data and sleeping */
 #define DNET_SEND_WATERMARK_HIGH	(1024 * 100)
 #define DNET_SEND_WATERMARK_LOW		(512 * 100)
@@ -152,6 +263,30 @@ struct dnet_net_epoll_data
 	int fd;
 };
 
+struct dnet_trans;
+
+/*
+ * Open addressing hash table of transactions sent into the state, keyed by transaction number.
+ * Linear probing with backward shift removal, so there are no tombstones and lookup of
+ * a reply stops at the first empty slot. Slots are allocated on the first insertion,
+ * table grows when it is half full and shrinks when less than 1/8 of it is used.
+ */
+#define DNET_TRANS_TABLE_MIN_SIZE	64
+
+struct dnet_trans_table {
+	struct dnet_trans	**slots;
+	/* number of slots minus one, number of slots is power of two */
+	size_t			mask;
+	size_t			size;
+};
+
+/* home slot of transaction @trans in the table with @mask */
+static inline size_t dnet_trans_hash(uint64_t trans, size_t mask)
+{
+	/* transaction numbers are taken from the node-wide counter, so they come to the state with a stride */
+	return (size_t)((trans * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
 struct dnet_net_state
 {
 	// To store state either at node::empty_state_list (List of all client nodes, used for statistics)
@@ -193,10 +328,25 @@ struct dnet_net_state
 	unsigned int		rcv_flags;
 	void			*rcv_data;
 
+	/*
+	 * Read-ahead buffer: small commands are sliced out of it,
+	 * so that several of them can be received by single recv() call
+	 */
+	char			*rcv_buf;
+	size_t			rcv_buf_start, rcv_buf_end;
+
 	int			epoll_fd;
 	size_t			send_offset;
 	pthread_mutex_t		send_lock;
-	struct list_head	send_list;
+	/*
+	 * Send queues of priority classes, their deficits in bytes, class which is being served
+	 * and pending non-final replies per stream slot and of untracked streams, see DNET_SEND_CLASSES
+	 */
+	struct list_head	send_list[DNET_SEND_CLASSES];
+	long			send_deficit[DNET_SEND_CLASSES];
+	int			send_class;
+	struct dnet_send_stream	send_streams[DNET_SEND_STREAMS];
+	int			send_streams_overflow;
 	/*
 	 * Condition variable to wait when send_queue_size reaches high
 	 * watermark
@@ -204,10 +354,27 @@ struct dnet_net_state
 	pthread_cond_t		send_wait;
 	/* Number of queued requests in send queue from iterator */
 	atomic_t		send_queue_size;
+	/*
+	 * Number of send syscalls (writev/send/sendfile) issued for this state
+	 * and number of requests fully sent by them
+	 */
+	atomic_t		send_syscalls;
+	atomic_t		send_requests;
 
 	pthread_mutex_t		trans_lock;
-	struct rb_root		trans_root;
-	struct rb_root		timer_root;
+	struct dnet_trans_table	trans_table;
+	/* deadlines of transactions sent into this state, protected by @trans_lock */
+	struct dnet_timer_wheel	timer_wheel;
+
+	/*
+	 * Additional connections to the same address, bulk requests are striped over them.
+	 * Array is protected by @trans_lock. Lane holds a reference to its @primary state
+	 * and primary state holds references to its lanes until either of them is reset.
+	 */
+	struct dnet_net_state	*lanes[DNET_NET_LANES_MAX - 1];
+	struct dnet_net_state	*primary;
+	/* position of the lane in @primary's lanes plus one, zero for primary states */
+	int			lane;
 
 
 	int			la;
@@ -250,6 +417,10 @@ int dnet_idc_insert(struct dnet_net_state *st, struct dnet_idc *idc);
 void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id);
 int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *ids);
 void dnet_idc_destroy_nolock(struct dnet_net_state *st);
+/* Frees replaced route table snapshots once their readers are gone, must be called without @n->state_lock */
+void dnet_route_table_reclaim(struct dnet_node *n);
+/* Rebuilds route table if previous update failed and reclaims replaced snapshots */
+void dnet_route_table_check(struct dnet_node *n);
 
 int dnet_state_micro_init(struct dnet_net_state *st, struct dnet_node *n, struct dnet_addr *addr, int join);
 int dnet_state_set_server_prio(struct dnet_net_state *st);
@@ -262,6 +433,19 @@ struct dnet_net_state *dnet_state_create(struct dnet_node *n,
 
 void dnet_state_reset(struct dnet_net_state *st, int error);
 void dnet_state_clean(struct dnet_net_state *st);
+
+/* Opens missing lanes of the state, returns number of lanes it has, primary connection included */
+int dnet_state_lanes_connect(struct dnet_net_state *st);
+/* Opens missing lanes of all states in the route table */
+void dnet_reconnect_lanes(struct dnet_node *n);
+/* Returns number of connected lanes of the state, primary connection included */
+int dnet_state_lanes_num(struct dnet_net_state *st);
+
+/* Lanes share backends and their weights with the primary state */
+static inline struct dnet_net_state *dnet_state_primary(struct dnet_net_state *st)
+{
+	return st->primary ? st->primary : st;
+}
 void dnet_state_remove_nolock(struct dnet_net_state *st);
 
 struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const struct dnet_addr *addr);
@@ -384,6 +568,41 @@ struct dnet_group
 	struct dnet_state_id	*ids;
 };
 
+/*
+ * Immutable snapshot of the route table built from node's group tree.
+ * It is rebuilt and published by writers under @dnet_node::state_lock,
+ * readers look up IDs without taking the lock, see dnet_route_read_lock().
+ */
+struct dnet_route_table_entry {
+	/* must be the first member, entries are searched by dnet_id_prefix_search() */
+	struct dnet_raw_id	raw;
+	struct dnet_net_state	*st;
+	int			backend_id;
+};
+
+struct dnet_route_group {
+	unsigned int		group_id;
+	int			id_num;
+	/* first bytes of every ID as host-order integers, they are searched before full IDs are compared */
+	uint64_t		*prefixes;
+	struct dnet_route_table_entry	*entries;
+};
+
+struct dnet_route_table {
+	uint64_t		version;
+	int			group_num;
+	/*
+	 * Snapshot holds reference to the state of every backend it routes to,
+	 * so replaced snapshot can be freed after its readers are gone without @dnet_node::state_lock
+	 */
+	int			state_num;
+	struct dnet_net_state	**states;
+	/* next replaced snapshot waiting for its readers, see dnet_route_table_reclaim() */
+	struct dnet_route_table	*retired_next;
+	/* sorted by group_id */
+	struct dnet_route_group	groups[];
+};
+
 static inline struct dnet_group *dnet_group_get(struct dnet_group *g)
 {
 	atomic_inc(&g->refcnt);
@@ -414,6 +633,7 @@ struct dnet_net_io {
 	int			epoll_fd;
 	pthread_t		tid;
 	struct dnet_node	*n;
+	struct dnet_io_buf_pool	*buf_pool;
 };
 
 enum dnet_work_io_mode {
@@ -449,6 +669,28 @@ static inline void list_stat_size_decrease(struct list_stat *st, int num) {
 	st->list_size -= num;
 }
 
+#define DNET_STAT_NAME_SIZE	64
+
+/*
+ * Names of metrics are built once when node, pool or backend is created,
+ * request processing only passes prepared names instead of formatting them on every call.
+ */
+struct dnet_cmd_stat_names {
+	char			names[__DNET_CMD_MAX][DNET_STAT_NAME_SIZE];
+};
+
+/* fills names of all commands as "@prefix.COMMAND" */
+void dnet_cmd_stat_names_init(struct dnet_cmd_stat_names *names, const char *prefix);
+const char *dnet_cmd_stat_name(const struct dnet_cmd_stat_names *names, int cmd);
+
+/* metrics of work pool, they are named "pool.<backend_id|sys>.<blocking|nonblocking>.<metric>" */
+struct dnet_work_pool_stat_names {
+	char			queue_wait_time[DNET_STAT_NAME_SIZE];
+	char			queue_size[DNET_STAT_NAME_SIZE];
+	char			active_threads[DNET_STAT_NAME_SIZE];
+	char			search_trans_time[DNET_STAT_NAME_SIZE];
+};
+
 struct dnet_backend_io;
 struct dnet_work_pool {
 	struct dnet_node	*n;
@@ -459,6 +701,8 @@ struct dnet_work_pool {
 	struct dnet_work_io	*wio_list;
 
 	void			*request_queue;
+
+	struct dnet_work_pool_stat_names stat_names;
 };
 
 struct dnet_work_pool_place
@@ -527,6 +771,15 @@ void dnet_io_cleanup(struct dnet_node *n);
 
 void dnet_io_req_free(struct dnet_io_req *r);
 
+/*
+ * Send queue of the state, see DNET_SEND_CLASSES. All of them must be called under @st->send_lock.
+ * Request is queued into its class, then removed from the queue returned by dnet_send_list_pick_nolock()
+ * after it has been sent.
+ */
+void dnet_send_list_add_nolock(struct dnet_net_state *st, struct dnet_io_req *r);
+struct list_head *dnet_send_list_pick_nolock(struct dnet_net_state *st);
+void dnet_send_list_del_nolock(struct dnet_net_state *st, struct dnet_io_req *r);
+
 struct dnet_config_data {
 	void (*destroy_config_data) (struct dnet_config_data *);
 
@@ -564,6 +817,21 @@ struct dnet_node
 	pthread_mutex_t		state_lock;
 	struct rb_root		group_root;
 
+	/*
+	 * Published route table snapshot and counters of its readers.
+	 * Readers register in the counter selected by @route_epoch. Replaced snapshots are queued
+	 * into @route_retired and freed by dnet_route_table_reclaim() outside of @state_lock,
+	 * which flips the epoch and waits for both counters to drain under @route_reclaim_lock.
+	 * @route_table_dirty is set when snapshot could not be rebuilt, previous one is kept then.
+	 */
+	struct dnet_route_table	*route_table;
+	struct dnet_route_table	*route_retired;
+	uint64_t		route_table_version;
+	int			route_table_dirty;
+	atomic_t		route_epoch;
+	atomic_t		route_readers[2];
+	pthread_mutex_t		route_reclaim_lock;
+
 	/* hosts client states, i.e. those who didn't join network */
 	struct list_head	empty_state_list;
 	/* hosts server states, i.e. those who joined network */
@@ -573,6 +841,7 @@ struct dnet_node
 	struct list_head	storage_state_list;
 
 	atomic_t		trans;
+	struct dnet_trans_cache	trans_cache[DNET_TRANS_CACHES];
 
 	dnet_route_list		*route;
 	struct dnet_net_state	*st;
@@ -627,6 +896,9 @@ struct dnet_node
 	struct dnet_lock	counters_lock;
 	struct dnet_stat_count	counters[__DNET_CMD_MAX * 2];
 
+	/* timers of commands: the first table for direct commands, the second one for recursive ones */
+	struct dnet_cmd_stat_names cmd_stat_names[2];
+
 	int			bg_ionice_class;
 	int			bg_ionice_prio;
 	int			removal_delay;
@@ -640,6 +912,14 @@ struct dnet_node
 	int			server_prio;
 	int			client_prio;
 
+	/* number of connections opened to every remote node */
+	int			net_lanes;
+	/*
+	 * Set when new remote node has been connected, reconnection thread opens its lanes then,
+	 * so that connection process does not wait for them
+	 */
+	atomic_t		lanes_pending;
+
 	/*
 	 * List of dnet_iterator.
 	 * Used for iterator management e.g. pause/continue actions.
@@ -745,6 +1025,10 @@ int dnet_sendfile(struct dnet_net_state *st, int fd, uint64_t *offset, uint64_t
 
 int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r);
 
+/* Maximum number of requests gathered into single writev() call */
+#define DNET_SEND_BATCH_MAX	64
+int dnet_send_request_batch(struct dnet_net_state *st, struct dnet_io_req **reqs, int num);
+
 
 int __attribute__((weak)) dnet_send_ack(struct dnet_net_state *st, struct dnet_cmd *cmd, int err, int recursive);
 void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r);
@@ -765,10 +1049,11 @@ int __attribute__((weak)) dnet_state_join(struct dnet_net_state *st);
 
 struct dnet_trans
 {
-	struct rb_node			trans_entry;
-	struct rb_node			timer_entry;
+	struct dnet_timer_wheel_entry	timer_entry;
+	/* transaction is in the trans table of @st */
+	int				hashed;
 
-	/* is used when checking thread moves transaction out of the above trees because of timeout */
+	/* is used when checking thread moves transaction out of the trans table and timer wheel because of timeout */
 	struct list_head		trans_list_entry;
 
 	struct timeval			time, start;
@@ -784,6 +1069,10 @@ struct dnet_trans
 
 	atomic_t			refcnt;
 
+	/* cache and size class transaction memory is returned to, NULL cache means heap */
+	struct dnet_trans_cache		*cache;
+	int				cache_class;
+
 	int				command; /* main command this transaction carries */
 
 	void				*priv;
@@ -813,6 +1102,12 @@ static inline void dnet_trans_put(struct dnet_trans *t)
 int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a);
 void dnet_trans_remove_nolock(struct dnet_net_state *st, struct dnet_trans *t);
 struct dnet_trans *dnet_trans_search(struct dnet_net_state *st, uint64_t trans);
+/*
+ * Returns any transaction of the state without taking a reference, @pos is the slot search starts from,
+ * it is updated so that the next call continues from the found transaction.
+ */
+struct dnet_trans *dnet_trans_first_nolock(struct dnet_net_state *st, size_t *pos);
+void dnet_trans_table_destroy(struct dnet_trans_table *table);
 
 int dnet_trans_insert_timer_nolock(struct dnet_net_state *st, struct dnet_trans *a);
 void dnet_trans_remove_timer_nolock(struct dnet_net_state *st, struct dnet_trans *t);
@@ -833,6 +1128,21 @@ ssize_t dnet_send_data(struct dnet_net_state *st, void *header, uint64_t hsize,
 ssize_t dnet_send(struct dnet_net_state *st, void *data, uint64_t size);
 ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size);
 
+/*
+ * Queues @header and @data for sending without copying them.
+ * Ownership of the buffers is handed over to the send queue: @destroy(@priv) is called
+ * after the data has been sent or dropped, including the case when queueing itself fails.
+ */
+ssize_t dnet_send_data_nocopy(struct dnet_net_state *st, void *header, uint64_t hsize, void *data, uint64_t dsize,
+		void (* destroy)(void *priv), void *priv);
+
+/*
+ * The same as dnet_send_read_data(), but @data is not copied,
+ * @destroy(@priv) is called when @data is not needed anymore.
+ */
+int dnet_send_read_data_nocopy(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io, void *data,
+		void (* destroy)(void *priv), void *priv);
+
 struct dnet_addr_storage
 {
 	int				reconnect_time, reconnect_time_max;
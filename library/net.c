@@ -21,6 +21,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -142,17 +143,14 @@ err_out_exit:
 
 void dnet_state_clean(struct dnet_net_state *st)
 {
-	struct rb_node *rb_node;
 	struct dnet_trans *t;
+	size_t pos = 0;
 	int num = 0;
 
 	while (1) {
-		t = NULL;
-
 		pthread_mutex_lock(&st->trans_lock);
-		rb_node = rb_first(&st->trans_root);
-		if (rb_node) {
-			t = rb_entry(rb_node, struct dnet_trans, trans_entry);
+		t = dnet_trans_first_nolock(st, &pos);
+		if (t) {
 			dnet_trans_get(t);
 
 			dnet_trans_remove_nolock(st, t);
@@ -177,8 +175,13 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 	struct dnet_io_req *r;
 	int offset = 0;
 	int err = 0;
+	size_t size = sizeof(struct dnet_io_req);
+
+	/* Buffers owned by the request are not copied, they will be released by @orig->destroy */
+	if (!orig->destroy)
+		size += orig->dsize + orig->hsize;
 
-	buf = r = malloc(sizeof(struct dnet_io_req) + orig->dsize + orig->hsize);
+	buf = r = malloc(size);
 	if (!r) {
 		dnet_log(st->n, DNET_LOG_ERROR, "Not enough memory for io req queue fd: %d : %s %d", orig->fd, strerror(-err), err);
 		return NULL;
@@ -186,20 +189,29 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 	memset(r, 0, sizeof(struct dnet_io_req));
 	r->fd = -1;
 
-	if (orig->header && orig->hsize) {
-		r->header = buf + sizeof(struct dnet_io_req);
+	if (orig->destroy) {
+		r->header = orig->header;
 		r->hsize = orig->hsize;
+		r->data = orig->data;
+		r->dsize = orig->dsize;
+		r->destroy = orig->destroy;
+		r->destroy_priv = orig->destroy_priv;
+	} else {
+		if (orig->header && orig->hsize) {
+			r->header = buf + sizeof(struct dnet_io_req);
+			r->hsize = orig->hsize;
 
-		offset = r->hsize;
-		memcpy(r->header, orig->header, r->hsize);
-	}
+			offset = r->hsize;
+			memcpy(r->header, orig->header, r->hsize);
+		}
 
-	if (orig->data && orig->dsize) {
-		r->data = buf + sizeof(struct dnet_io_req) + offset;
-		r->dsize = orig->dsize;
+		if (orig->data && orig->dsize) {
+			r->data = buf + sizeof(struct dnet_io_req) + offset;
+			r->dsize = orig->dsize;
 
-		offset += r->dsize;
-		memcpy(r->data, orig->data, r->dsize);
+			offset += r->dsize;
+			memcpy(r->data, orig->data, r->dsize);
+		}
 	}
 
 	if (orig->fd >= 0 && orig->fsize) {
@@ -212,9 +224,128 @@ static struct dnet_io_req *dnet_io_req_copy(struct dnet_net_state *st, struct dn
 	return r;
 }
 
+/* copies command the request starts with, returns zero if there is no command */
+static int dnet_io_req_cmd(struct dnet_io_req *r, struct dnet_cmd *cmd)
+{
+	if (r->hsize >= sizeof(struct dnet_cmd))
+		memcpy(cmd, r->header, sizeof(struct dnet_cmd));
+	else if (!r->hsize && r->dsize >= sizeof(struct dnet_cmd))
+		memcpy(cmd, r->data, sizeof(struct dnet_cmd));
+	else
+		return 0;
+
+	dnet_convert_cmd(cmd);
+	return 1;
+}
+
+/*
+ * Small control commands and bare acknowledgements go first, they must not wait for large replies,
+ * otherwise remote side may treat this node as stalled. Other requests are split by size.
+ */
+static int dnet_io_req_send_class(struct dnet_io_req *r, struct dnet_cmd *cmd)
+{
+	uint64_t size = r->hsize + r->dsize + r->fsize;
+
+	if (size >= DNET_NET_LANE_BULK_SIZE)
+		return DNET_SEND_CLASS_BULK;
+
+	if (cmd) {
+		switch (cmd->cmd) {
+		case DNET_CMD_REVERSE_LOOKUP:
+		case DNET_CMD_JOIN:
+		case DNET_CMD_ROUTE_LIST:
+		case DNET_CMD_STATUS:
+		case DNET_CMD_AUTH:
+		case DNET_CMD_UPDATE_IDS:
+		case DNET_CMD_BACKEND_CONTROL:
+		case DNET_CMD_BACKEND_STATUS:
+			return DNET_SEND_CLASS_CONTROL;
+		default:
+			break;
+		}
+
+		if ((cmd->flags & DNET_FLAGS_REPLY) && !cmd->size)
+			return DNET_SEND_CLASS_CONTROL;
+	}
+
+	return DNET_SEND_CLASS_SMALL;
+}
+
 /*
- * Eventually we may end up with proper reference counters here, but for now let's just copy the whole buf.
- * Large data blocks are being sent through sendfile anyway, so it should not be _that_ costly operation.
+ * Keeps replies of the same transaction in one class while it has pending non-final replies,
+ * see DNET_SEND_STREAMS. Counter is decreased when request has been sent.
+ */
+static void dnet_io_req_stream_nolock(struct dnet_net_state *st, struct dnet_io_req *r, struct dnet_cmd *cmd)
+{
+	struct dnet_send_stream *s = NULL, *free_slot = NULL, *probe;
+	int i, pos;
+
+	pos = (cmd->trans * 0x9e3779b97f4a7c15ULL) >> (64 - DNET_SEND_STREAMS_SHIFT);
+
+	for (i = 0; i < DNET_SEND_STREAMS_PROBE; ++i) {
+		probe = &st->send_streams[(pos + i) & (DNET_SEND_STREAMS - 1)];
+
+		if (!probe->num) {
+			if (!free_slot)
+				free_slot = probe;
+		} else if (probe->trans == cmd->trans) {
+			s = probe;
+			break;
+		}
+	}
+
+	if (s) {
+		r->send_class = s->send_class;
+	} else if (st->send_streams_overflow) {
+		/* reply may belong to untracked transaction whose replies are still queued */
+		r->send_class = DNET_SEND_CLASS_BULK;
+	}
+
+	if (!(cmd->flags & DNET_FLAGS_MORE))
+		return;
+
+	if (!s && !st->send_streams_overflow && free_slot) {
+		s = free_slot;
+		s->trans = cmd->trans;
+		s->send_class = r->send_class;
+	}
+
+	if (s) {
+		s->num++;
+		r->send_stream = s - st->send_streams;
+	} else {
+		r->send_class = DNET_SEND_CLASS_BULK;
+		st->send_streams_overflow++;
+		r->send_stream = DNET_SEND_STREAMS;
+	}
+}
+
+void dnet_send_list_add_nolock(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	struct dnet_cmd cmd;
+	int has_cmd;
+
+	has_cmd = dnet_io_req_cmd(r, &cmd);
+	r->send_class = dnet_io_req_send_class(r, has_cmd ? &cmd : NULL);
+	r->send_stream = -1;
+
+	/* states without socket (local sessions) read replies back from their queue in order they were queued */
+	if (st->write_s < 0) {
+		r->send_class = DNET_SEND_CLASS_CONTROL;
+		has_cmd = 0;
+	}
+
+	if (has_cmd && (cmd.flags & DNET_FLAGS_REPLY))
+		dnet_io_req_stream_nolock(st, r, &cmd);
+
+	list_add_tail(&r->req_entry, &st->send_list[r->send_class]);
+}
+
+/*
+ * Header and data are copied unless request owns them (@orig->destroy is set),
+ * in the latter case only request structure is allocated and buffers are released by @orig->destroy
+ * after the request has been sent.
+ * Large data blocks are being sent through sendfile anyway.
  */
 static int dnet_io_req_queue(struct dnet_net_state *st, struct dnet_io_req *orig)
 {
@@ -223,12 +354,14 @@ static int dnet_io_req_queue(struct dnet_net_state *st, struct dnet_io_req *orig
 
 	r = dnet_io_req_copy(st, orig);
 	if (!r) {
+		if (orig->destroy)
+			orig->destroy(orig->destroy_priv);
 		err = -ENOMEM;
 		goto err_out_exit;
 	}
 
 	pthread_mutex_lock(&st->send_lock);
-	list_add_tail(&r->req_entry, &st->send_list);
+	dnet_send_list_add_nolock(st, r);
 
 	if (!st->__need_exit)
 		dnet_schedule_send(st);
@@ -246,7 +379,9 @@ void dnet_io_req_free(struct dnet_io_req *r)
 		if (r->on_exit & DNET_IO_REQ_FLAGS_CLOSE)
 			close(r->fd);
 	}
-	free(r);
+	if (r->destroy)
+		r->destroy(r->destroy_priv);
+	dnet_io_buf_free(r);
 }
 
 static int dnet_wait(struct dnet_net_state *st, unsigned int events, long timeout)
@@ -300,13 +435,14 @@ out_exit:
 	return err;
 }
 
-ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
+static ssize_t dnet_send_nolock_flags(struct dnet_net_state *st, void *data, uint64_t size, int flags)
 {
 	ssize_t err = 0;
 	struct dnet_node *n = st->n;
 
 	while (size) {
-		err = send(st->write_s, data, size, 0);
+		err = send(st->write_s, data, size, flags);
+		atomic_inc(&st->send_syscalls);
 		if (err < 0) {
 			err = -errno;
 			if (err != -EAGAIN)
@@ -331,6 +467,11 @@ ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
 	return err;
 }
 
+ssize_t dnet_send_nolock(struct dnet_net_state *st, void *data, uint64_t size)
+{
+	return dnet_send_nolock_flags(st, data, size, 0);
+}
+
 ssize_t dnet_send(struct dnet_net_state *st, void *data, uint64_t size)
 {
 	struct dnet_io_req r;
@@ -357,12 +498,30 @@ ssize_t dnet_send_data(struct dnet_net_state *st, void *header, uint64_t hsize,
 	return dnet_io_req_queue(st, &r);
 }
 
+ssize_t dnet_send_data_nocopy(struct dnet_net_state *st, void *header, uint64_t hsize, void *data, uint64_t dsize,
+		void (* destroy)(void *priv), void *priv)
+{
+	struct dnet_io_req r;
+
+	memset(&r, 0, sizeof(r));
+	r.header = header;
+	r.hsize = hsize;
+	r.data = data;
+	r.dsize = dsize;
+	r.fd = -1;
+	r.destroy = destroy;
+	r.destroy_priv = priv;
+
+	return dnet_io_req_queue(st, &r);
+}
+
 static ssize_t dnet_send_fd_nolock(struct dnet_net_state *st, int fd, uint64_t offset, uint64_t dsize)
 {
 	ssize_t err;
 
 	while (dsize) {
 		err = dnet_sendfile(st, fd, &offset, dsize);
+		atomic_inc(&st->send_syscalls);
 		if (err < 0)
 			break;
 		if (err == 0) {
@@ -404,14 +563,69 @@ void dnet_trans_update_timestamp(struct dnet_trans *t)
 	t->time.tv_usec += t->wait_ts.tv_nsec / 1000;
 }
 
+/*
+ * Bulk requests are those which carry at least DNET_NET_LANE_BULK_SIZE bytes
+ * and reads of at least that many bytes. Size of whole-object reads is unknown, they stay on the primary state.
+ */
+static int dnet_trans_is_bulk(struct dnet_trans *t, struct dnet_io_req *req)
+{
+	struct dnet_io_attr io;
+
+	if (req->hsize + req->dsize + req->fsize >= DNET_NET_LANE_BULK_SIZE)
+		return 1;
+
+	if (t->command == DNET_CMD_READ && req->hsize >= sizeof(struct dnet_cmd) + sizeof(struct dnet_io_attr)) {
+		memcpy(&io, (struct dnet_cmd *)req->header + 1, sizeof(struct dnet_io_attr));
+		dnet_convert_io_attr(&io);
+
+		return io.size >= DNET_NET_LANE_BULK_SIZE;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns referenced lane of @st bulk transaction @trans is sent into,
+ * transactions are striped over lanes by their numbers. Returns NULL if state has no live lanes.
+ */
+static struct dnet_net_state *dnet_state_get_lane(struct dnet_net_state *st, uint64_t trans)
+{
+	const int lanes_num = st->n->net_lanes - 1;
+	struct dnet_net_state *lane = NULL;
+	int i;
+
+	pthread_mutex_lock(&st->trans_lock);
+	for (i = 0; i < lanes_num; ++i) {
+		lane = st->lanes[(trans + i) % lanes_num];
+		if (lane && !lane->__need_exit) {
+			dnet_state_get(lane);
+			break;
+		}
+
+		lane = NULL;
+	}
+	pthread_mutex_unlock(&st->trans_lock);
+
+	return lane;
+}
+
 int dnet_trans_send(struct dnet_trans *t, struct dnet_io_req *req)
 {
-	struct dnet_net_state *st = req->st;
+	struct dnet_net_state *st = req->st, *lane = NULL;
 	struct dnet_test_settings test_settings;
 	int err;
 
 	dnet_trans_get(t);
 
+	if (st->n->net_lanes > 1 && t->st == st && !st->primary && dnet_trans_is_bulk(t, req))
+		lane = dnet_state_get_lane(st, t->trans);
+
+	if (lane) {
+		/* lane keeps its primary state alive, so callers may still use @st they have passed */
+		dnet_state_put(t->st);
+		t->st = req->st = st = lane;
+	}
+
 	pthread_mutex_lock(&st->trans_lock);
 	err = dnet_trans_insert_nolock(st, t);
 	if (!err) {
@@ -665,13 +879,13 @@ int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st
 			 * Remove transaction for the duration of callback processing,
 			 * otherwise timeout checking thread can catch up.
 			 *
-			 * Network thread also removes transaction from the tree, but network
+			 * Network thread also removes transaction from the timer wheel, but network
 			 * thread can read multiple replies and put multiple packets into the IO queue,
-			 * which if processed here. Since code below inserts transaction into the timer tree
+			 * which if processed here. Since code below inserts transaction into the timer wheel
 			 * again after its callback has been completed, someone has to remove it.
 			 *
-			 * It is safe to remove transaction multiple times, but subsequent insertion will lead to crash,
-			 * if timestamp has been updated, since it is used as a key in the timer tree.
+			 * It is safe to remove transaction multiple times, but it must not be inserted
+			 * into the timer wheel while it is still scheduled there.
 			 */
 			dnet_trans_remove_timer_nolock(st, t);
 		}
@@ -723,8 +937,8 @@ int dnet_process_recv(struct dnet_backend_io *backend, struct dnet_net_state *st
 			dnet_trans_put(t);
 		} else {
 			/*
-			 * Put transaction back into the end of 'timer' tree with updated timestamp.
-			 * Transaction had been removed from timer tree in @dnet_update_trans_timestamp_network() in network
+			 * Put transaction back into the timer wheel with updated timestamp.
+			 * Transaction had been removed from timer wheel in @dnet_update_trans_timestamp_network() in network
 			 * thread right after whole data was read.
 			 */
 
@@ -829,6 +1043,42 @@ int dnet_state_reset_nolock_noclean(struct dnet_net_state *st, int error, struct
 	return dnet_trans_iterate_move_transaction(st, head);
 }
 
+/*
+ * Drops references between the state being reset and its lanes or its primary state.
+ * Lanes of the primary state are shut down, network threads reset them as any other broken connection.
+ */
+static void dnet_state_lanes_detach(struct dnet_net_state *st)
+{
+	struct dnet_net_state *lanes[DNET_NET_LANES_MAX - 1];
+	struct dnet_net_state *primary = st->primary;
+	int i, detached = 0;
+
+	pthread_mutex_lock(&st->trans_lock);
+	memcpy(lanes, st->lanes, sizeof(lanes));
+	memset(st->lanes, 0, sizeof(st->lanes));
+	pthread_mutex_unlock(&st->trans_lock);
+
+	for (i = 0; i < DNET_NET_LANES_MAX - 1; ++i) {
+		if (!lanes[i])
+			continue;
+
+		shutdown(lanes[i]->read_s, SHUT_RDWR);
+		dnet_state_put(lanes[i]);
+	}
+
+	if (primary) {
+		pthread_mutex_lock(&primary->trans_lock);
+		if (primary->lanes[st->lane - 1] == st) {
+			primary->lanes[st->lane - 1] = NULL;
+			detached = 1;
+		}
+		pthread_mutex_unlock(&primary->trans_lock);
+
+		if (detached)
+			dnet_state_put(st);
+	}
+}
+
 void dnet_state_reset(struct dnet_net_state *st, int error)
 {
 	LIST_HEAD(head);
@@ -840,6 +1090,9 @@ void dnet_state_reset(struct dnet_net_state *st, int error)
 	dnet_state_reset_nolock_noclean(st, error, &head);
 	pthread_mutex_unlock(&st->n->state_lock);
 
+	dnet_route_table_reclaim(st->n);
+	dnet_state_lanes_detach(st);
+
 	dnet_trans_clean_list(&head, error);
 }
 
@@ -864,6 +1117,13 @@ void dnet_set_sockopt(struct dnet_node *n, int s)
 	opt = 1;
 	setsockopt(s, SOL_SOCKET, SO_KEEPALIVE, &opt, 4);
 
+	/*
+	 * Requests are batched by the sending thread itself (see dnet_send_request_batch()),
+	 * so there is no need to wait for more data in the kernel.
+	 */
+	opt = 1;
+	setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &opt, 4);
+
 	setsockopt(s, IPPROTO_TCP, TCP_KEEPCNT, &n->keep_cnt, 4);
 	opt = 10;
 	setsockopt(s, IPPROTO_TCP, TCP_KEEPIDLE, &n->keep_idle, 4);
@@ -965,7 +1225,7 @@ static int dnet_auth_send(struct dnet_net_state *st)
 int dnet_state_micro_init(struct dnet_net_state *st,
 		struct dnet_node *n, struct dnet_addr *addr, int join)
 {
-	int err = 0;
+	int err = 0, i;
 
 	st->n = n;
 
@@ -981,8 +1241,13 @@ int dnet_state_micro_init(struct dnet_net_state *st,
 		goto err_out;
 	}
 
-	st->trans_root = RB_ROOT;
-	st->timer_root = RB_ROOT;
+	memset(&st->trans_table, 0, sizeof(struct dnet_trans_table));
+	{
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		dnet_timer_wheel_init(&st->timer_wheel, dnet_timer_wheel_tick(&tv));
+	}
 
 	st->epoll_fd = -1;
 
@@ -993,7 +1258,14 @@ int dnet_state_micro_init(struct dnet_net_state *st,
 		goto err_out_idc_destroy;
 	}
 
-	INIT_LIST_HEAD(&st->send_list);
+	for (i = 0; i < DNET_SEND_CLASSES; ++i) {
+		INIT_LIST_HEAD(&st->send_list[i]);
+		st->send_deficit[i] = 0;
+	}
+	st->send_class = DNET_SEND_CLASS_CONTROL;
+	memset(st->send_streams, 0, sizeof(st->send_streams));
+	st->send_streams_overflow = 0;
+
 	err = pthread_mutex_init(&st->send_lock, NULL);
 	if (err) {
 		err = -err;
@@ -1009,6 +1281,8 @@ int dnet_state_micro_init(struct dnet_net_state *st,
 	}
 
 	atomic_init(&st->send_queue_size, 0);
+	atomic_init(&st->send_syscalls, 0);
+	atomic_init(&st->send_requests, 0);
 	atomic_init(&st->refcnt, 1);
 
 	memcpy(&st->addr, addr, sizeof(struct dnet_addr));
@@ -1236,11 +1510,201 @@ err_out_exit:
 	return NULL;
 }
 
+/*
+ * Connects to @addr waiting at most DNET_NET_LANE_CONNECT_TIMEOUT milliseconds,
+ * returns connected socket or negative error.
+ */
+static int dnet_lane_socket_connect(struct dnet_node *n, const struct dnet_addr *addr)
+{
+	struct pollfd pfd;
+	socklen_t slen = sizeof(int);
+	int s, err, status = 0;
+
+	s = socket(addr->family, SOCK_STREAM, IPPROTO_TCP);
+	if (s < 0) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to create lane socket", dnet_addr_string(addr));
+		goto err_out_exit;
+	}
+
+	fcntl(s, F_SETFL, O_NONBLOCK);
+	fcntl(s, F_SETFD, FD_CLOEXEC);
+
+	err = connect(s, (struct sockaddr *)addr->addr, addr->addr_len);
+	if (err < 0 && errno != EINPROGRESS) {
+		err = -errno;
+		goto err_out_close;
+	}
+
+	pfd.fd = s;
+	pfd.events = POLLOUT;
+	pfd.revents = 0;
+
+	err = poll(&pfd, 1, DNET_NET_LANE_CONNECT_TIMEOUT);
+	if (err <= 0) {
+		err = err ? -errno : -ETIMEDOUT;
+		goto err_out_close;
+	}
+
+	err = getsockopt(s, SOL_SOCKET, SO_ERROR, &status, &slen);
+	if (err || status) {
+		err = status ? -status : -errno;
+		goto err_out_close;
+	}
+
+	return s;
+
+err_out_close:
+	dnet_log(n, DNET_LOG_ERROR, "%s: failed to connect lane: %s [%d]",
+			dnet_addr_string(addr), strerror(-err), err);
+	close(s);
+err_out_exit:
+	return err;
+}
+
+/*
+ * Lanes are plain client connections to the address of the state: they do not join and are not added
+ * into the route table, they only carry bulk transactions of their primary state.
+ * Network threads and timeout checks handle them as any other connection.
+ *
+ * Lane may be reset before it is stored into the lanes array and thus never be detached by dnet_state_reset(),
+ * such lanes are dropped from the array and connected again.
+ */
+int dnet_state_lanes_connect(struct dnet_net_state *st)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_net_state *lane, *dead;
+	int i, s, err, exists, need_exit;
+
+	if (n->net_lanes <= 1 || st->primary || st->accept_s >= 0 || st == n->st)
+		return dnet_state_lanes_num(st);
+
+	for (i = 0; i < n->net_lanes - 1; ++i) {
+		dead = NULL;
+
+		pthread_mutex_lock(&st->trans_lock);
+		if (st->lanes[i] && st->lanes[i]->__need_exit) {
+			dead = st->lanes[i];
+			st->lanes[i] = NULL;
+		}
+		exists = st->lanes[i] != NULL;
+		need_exit = st->__need_exit;
+		pthread_mutex_unlock(&st->trans_lock);
+
+		if (dead)
+			dnet_state_put(dead);
+
+		if (need_exit || n->need_exit)
+			break;
+		if (exists)
+			continue;
+
+		s = dnet_lane_socket_connect(n, &st->addr);
+		if (s < 0)
+			continue;
+
+		/* socket is closed by dnet_state_create() if it fails */
+		lane = dnet_state_create(n, NULL, 0, &st->addr, s, &err, 0, 0, st->idx, 0, NULL, 0);
+		if (!lane) {
+			dnet_log(n, DNET_LOG_ERROR, "%s: failed to create lane %d: %s [%d]",
+					dnet_state_dump_addr(st), i + 1, strerror(-err), err);
+			continue;
+		}
+
+		memcpy(lane->version, st->version, sizeof(lane->version));
+		lane->primary = dnet_state_get(st);
+		lane->lane = i + 1;
+
+		/* reference returned by dnet_state_create() is kept in the lanes array */
+		pthread_mutex_lock(&st->trans_lock);
+		if (!st->__need_exit && !st->lanes[i]) {
+			st->lanes[i] = lane;
+			lane = NULL;
+		}
+		pthread_mutex_unlock(&st->trans_lock);
+
+		if (lane) {
+			dnet_state_reset(lane, -EEXIST);
+			dnet_state_put(lane);
+			continue;
+		}
+
+		dnet_log(n, DNET_LOG_INFO, "%s: connected lane %d/%d, socket: %d/%d",
+				dnet_state_dump_addr(st), i + 1, n->net_lanes - 1, st->lanes[i]->read_s, st->lanes[i]->write_s);
+	}
+
+	return dnet_state_lanes_num(st);
+}
+
+int dnet_state_lanes_num(struct dnet_net_state *st)
+{
+	int i, num = 1;
+
+	pthread_mutex_lock(&st->trans_lock);
+	for (i = 0; i < st->n->net_lanes - 1; ++i) {
+		if (st->lanes[i] && !st->lanes[i]->__need_exit)
+			++num;
+	}
+	pthread_mutex_unlock(&st->trans_lock);
+
+	return num;
+}
+
+void dnet_reconnect_lanes(struct dnet_node *n)
+{
+	struct dnet_net_state *st, **states = NULL;
+	int i, num = 0;
+
+	if (n->net_lanes <= 1)
+		return;
+
+	pthread_mutex_lock(&n->state_lock);
+	list_for_each_entry(st, &n->dht_state_list, node_entry) {
+		++num;
+	}
+
+	if (num)
+		states = malloc(num * sizeof(struct dnet_net_state *));
+
+	if (states) {
+		i = 0;
+		list_for_each_entry(st, &n->dht_state_list, node_entry) {
+			states[i++] = dnet_state_get(st);
+		}
+	}
+	pthread_mutex_unlock(&n->state_lock);
+
+	if (!states)
+		return;
+
+	for (i = 0; i < num; ++i) {
+		dnet_state_lanes_connect(states[i]);
+		dnet_state_put(states[i]);
+	}
+
+	free(states);
+}
+
 int dnet_state_num(struct dnet_session *s)
 {
 	return dnet_node_state_num(s->node);
 }
 
+int dnet_state_lanes(struct dnet_session *s, const struct dnet_addr *addr)
+{
+	struct dnet_net_state *st;
+	int num;
+
+	st = dnet_state_search_by_addr(s->node, addr);
+	if (!st)
+		return -ENXIO;
+
+	num = dnet_state_lanes_num(st);
+	dnet_state_put(st);
+
+	return num;
+}
+
 int dnet_node_state_num(struct dnet_node *n)
 {
 	struct dnet_net_state *st;
@@ -1258,10 +1722,13 @@ int dnet_node_state_num(struct dnet_node *n)
 static void dnet_state_send_clean(struct dnet_net_state *st)
 {
 	struct dnet_io_req *r, *tmp;
+	int i;
 
-	list_for_each_entry_safe(r, tmp, &st->send_list, req_entry) {
-		list_del(&r->req_entry);
-		dnet_io_req_free(r);
+	for (i = 0; i < DNET_SEND_CLASSES; ++i) {
+		list_for_each_entry_safe(r, tmp, &st->send_list[i], req_entry) {
+			list_del(&r->req_entry);
+			dnet_io_req_free(r);
+		}
 	}
 }
 
@@ -1281,9 +1748,14 @@ void dnet_state_destroy(struct dnet_net_state *st)
 	}
 
 	dnet_state_clean(st);
+	dnet_trans_table_destroy(&st->trans_table);
 
 	dnet_state_send_clean(st);
 
+	if (st->rcv_data)
+		dnet_io_buf_free(st->rcv_data);
+	free(st->rcv_buf);
+
 	pthread_rwlock_destroy(&st->idc_lock);
 	pthread_mutex_destroy(&st->send_lock);
 	pthread_mutex_destroy(&st->trans_lock);
@@ -1293,43 +1765,52 @@ void dnet_state_destroy(struct dnet_net_state *st)
 
 	free(st->addrs);
 
+	dnet_state_put(st->primary);
+
 	memset(st, 0xff, sizeof(struct dnet_net_state));
 	free(st);
 }
 
+static void dnet_send_request_log(struct dnet_net_state *st, struct dnet_io_req *r, const char *stage,
+		int level, size_t sent, size_t total_size)
+{
+	struct dnet_cmd *cmd = r->header ? r->header : r->data;
+
+	dnet_node_set_trace_id(st->n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
+	dnet_log(st->n, level,
+		"%s: %s: sending trans: %lld -> %s/%d: size: %llu, cflags: %s, %s-sent: %zd/%zd",
+		dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
+		dnet_addr_string(&st->addr), cmd->backend_id,
+		(unsigned long long)cmd->size, dnet_flags_dump_cflags(cmd->flags),
+		stage, sent, total_size);
+	dnet_node_unset_trace_id();
+}
+
+/*
+ * Sends single request, it is used for requests with file descriptor attached,
+ * header and data are sent with MSG_MORE flag to be coalesced with the file content.
+ *
+ * We do not destroy request here, it is postponed to caller.
+ */
 int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r)
 {
-	int cork;
 	int err = 0;
 	size_t offset = st->send_offset;
 	const size_t total_size = r->dsize + r->hsize + r->fsize;
+	const int more = (r->fd >= 0 && r->fsize) ? MSG_MORE : 0;
 
-	if (total_size > sizeof(struct dnet_cmd)) {
-		/* Use TCP_CORK to send headers and packet body in one piece */
-		cork = 1;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_CORK, &cork, 4);
-	}
-
-	if (1) {
-		struct dnet_cmd *cmd = r->header ? r->header : r->data;
-		dnet_node_set_trace_id(st->n->log, cmd->trace_id, cmd->flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
-		dnet_log(st->n, st->send_offset == 0 ? DNET_LOG_INFO : DNET_LOG_DEBUG,
-			"%s: %s: sending trans: %lld -> %s/%d: size: %llu, cflags: %s, start-sent: %zd/%zd",
-			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
-			dnet_addr_string(&st->addr), cmd->backend_id,
-			(unsigned long long)cmd->size, dnet_flags_dump_cflags(cmd->flags),
+	dnet_send_request_log(st, r, "start", st->send_offset == 0 ? DNET_LOG_INFO : DNET_LOG_DEBUG,
 			st->send_offset, total_size);
-	}
 
 	if (r->hsize && r->header && st->send_offset < r->hsize) {
-		err = dnet_send_nolock(st, r->header + offset, r->hsize - offset);
+		err = dnet_send_nolock_flags(st, r->header + offset, r->hsize - offset, (r->dsize ? MSG_MORE : more));
 		if (err)
 			goto err_out_exit;
 	}
 
 	if (r->dsize && r->data && st->send_offset < (r->dsize + r->hsize)) {
 		offset = st->send_offset - r->hsize;
-		err = dnet_send_nolock(st, r->data + offset, r->dsize - offset);
+		err = dnet_send_nolock_flags(st, r->data + offset, r->dsize - offset, more);
 		if (err)
 			goto err_out_exit;
 	}
@@ -1353,34 +1834,100 @@ int dnet_send_request(struct dnet_net_state *st, struct dnet_io_req *r)
 	}
 
 err_out_exit:
-
-	if (1) {
-		struct dnet_cmd *cmd = r->header ? r->header : r->data;
-		dnet_log(st->n, st->send_offset == total_size ? DNET_LOG_INFO : DNET_LOG_DEBUG,
-			"%s: %s: sending trans: %lld -> %s/%d: size: %llu, cflags: %s, finish-sent: %zd/%zd",
-			dnet_dump_id(&cmd->id), dnet_cmd_string(cmd->cmd), (unsigned long long)cmd->trans,
-			dnet_addr_string(&st->addr), cmd->backend_id,
-			(unsigned long long)cmd->size, dnet_flags_dump_cflags(cmd->flags),
+	dnet_send_request_log(st, r, "finish", st->send_offset == total_size ? DNET_LOG_INFO : DNET_LOG_DEBUG,
 			st->send_offset, total_size);
+
+	return err;
+}
+
+/*
+ * Sends headers and data of @num requests (which must not have file descriptors attached)
+ * with as few writev() calls as possible.
+ *
+ * @st->send_offset is the number of bytes already sent starting from the beginning of @reqs[0],
+ * after return it may be larger than size of the first request, caller has to walk over @reqs
+ * and complete requests which have been fully sent.
+ *
+ * We do not destroy requests here, it is postponed to caller.
+ */
+int dnet_send_request_batch(struct dnet_net_state *st, struct dnet_io_req **reqs, int num)
+{
+	struct iovec iov[2 * DNET_SEND_BATCH_MAX];
+	struct iovec *cur = iov;
+	size_t skip = st->send_offset;
+	size_t total_size = 0, req_start = 0, req_size;
+	ssize_t err = 0;
+	int iovcnt = 0;
+	int i;
+
+	for (i = 0; i < num && i < DNET_SEND_BATCH_MAX; ++i) {
+		struct dnet_io_req *r = reqs[i];
+		void *bufs[2] = { r->header, r->data };
+		size_t sizes[2] = { r->header ? r->hsize : 0, r->data ? r->dsize : 0 };
+		int j;
+
+		for (j = 0; j < 2; ++j) {
+			if (sizes[j] <= skip) {
+				skip -= sizes[j];
+				continue;
+			}
+
+			iov[iovcnt].iov_base = bufs[j] + skip;
+			iov[iovcnt].iov_len = sizes[j] - skip;
+			++iovcnt;
+			skip = 0;
+		}
+
+		total_size += r->hsize + r->dsize;
 	}
-	dnet_node_unset_trace_id();
+	num = i;
+
+	while (st->send_offset < total_size) {
+		err = writev(st->write_s, cur, iovcnt);
+		atomic_inc(&st->send_syscalls);
+		if (err < 0) {
+			err = -errno;
+			if (err != -EAGAIN)
+				dnet_log_err(st->n, "Failed to send %d requests: size: %zu, socket: %d",
+					num, total_size - st->send_offset, st->write_s);
+			break;
+		}
 
-	if (total_size > sizeof(struct dnet_cmd)) {
-		cork = 0;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_CORK, &cork, 4);
+		if (err == 0) {
+			dnet_log(st->n, DNET_LOG_ERROR, "Peer %s has dropped the connection: socket: %d.",
+					dnet_state_dump_addr(st), st->write_s);
+			err = -ECONNRESET;
+			break;
+		}
+
+		st->send_offset += err;
+
+		while (err > 0) {
+			if ((size_t)err >= cur->iov_len) {
+				err -= cur->iov_len;
+				++cur;
+				--iovcnt;
+			} else {
+				cur->iov_base += err;
+				cur->iov_len -= err;
+				err = 0;
+			}
+		}
 	}
 
-	/*
-	 * Flush TCP output pipeline if we've sent whole request.
-	 *
-	 * We do not destroy request here, it is postponed to caller.
-	 * Function can be called without lock - default call path from network processing thread and dnet_process_send_single()
-	 * or under st->send_lock, if queue was empty and dnet_send*() caller directly invoked this function from dnet_io_req_queue()
-	 * instead of queueing.
-	 */
-	if (st->send_offset == total_size) {
-		int nodelay = 1;
-		setsockopt(st->write_s, IPPROTO_TCP, TCP_NODELAY, &nodelay, 4);
+	for (i = 0; i < num; ++i) {
+		req_size = reqs[i]->hsize + reqs[i]->dsize;
+
+		if (st->send_offset >= req_start + req_size) {
+			dnet_send_request_log(st, reqs[i], "finish", DNET_LOG_INFO, req_size, req_size);
+		} else {
+			if (st->send_offset > req_start)
+				dnet_send_request_log(st, reqs[i], "finish", DNET_LOG_DEBUG,
+						st->send_offset - req_start, req_size);
+			break;
+		}
+
+		req_start += req_size;
 	}
 
 	return err;
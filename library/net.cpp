@@ -952,6 +952,10 @@ static void dnet_process_socket(const dnet_connect_state_ptr &state, epoll_event
 
 		memcpy(st->version, socket->version, sizeof(st->version));
 
+		// lanes are opened by reconnection thread, they must not delay connection to other nodes
+		if (state->node->net_lanes > 1)
+			atomic_set(&state->node->lanes_pending, 1);
+
 		dnet_log(state->node, DNET_LOG_INFO, "Connected to %s, backends-num: %d, addr-num: %d, idx: %d, socket: %d/%d",
 			dnet_addr_string(&socket->addr),
 			int(id_container->backends_count), int(cnt->addr_num), idx,
@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <sched.h>
 
 #include "elliptics.h"
 #include "elliptics/interface.h"
@@ -40,6 +41,10 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 	}
 
 	atomic_init(&n->trans, 0);
+	atomic_init(&n->route_epoch, 0);
+	atomic_init(&n->route_readers[0], 0);
+	atomic_init(&n->route_readers[1], 0);
+	atomic_init(&n->lanes_pending, 0);
 
 	err = dnet_log_init(n, cfg->log);
 	if (err)
@@ -51,10 +56,16 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 		goto err_out_free;
 	}
 
+	err = pthread_mutex_init(&n->route_reclaim_lock, NULL);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize route reclaim lock: err: %d", err);
+		goto err_out_destroy_state;
+	}
+
 	n->wait = dnet_wait_alloc(0);
 	if (!n->wait) {
 		dnet_log(n, DNET_LOG_ERROR, "Failed to allocate wait structure.");
-		goto err_out_destroy_state;
+		goto err_out_destroy_route_reclaim;
 	}
 
 	err = dnet_counter_init(n);
@@ -85,6 +96,15 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 	}
 	pthread_attr_setdetachstate(&n->attr, PTHREAD_CREATE_DETACHED);
 
+	err = dnet_trans_cache_init(n);
+	if (err) {
+		dnet_log(n, DNET_LOG_ERROR, "Failed to initialize transaction caches: err: %d", err);
+		goto err_out_destroy_attr;
+	}
+
+	dnet_cmd_stat_names_init(&n->cmd_stat_names[0], "io.cmd");
+	dnet_cmd_stat_names_init(&n->cmd_stat_names[1], "io.cmd_recursive");
+
 	n->group_root = RB_ROOT;
 	INIT_LIST_HEAD(&n->empty_state_list);
 	INIT_LIST_HEAD(&n->dht_state_list);
@@ -98,6 +118,8 @@ static struct dnet_node *dnet_node_alloc(struct dnet_config *cfg)
 
 	return n;
 
+err_out_destroy_attr:
+	pthread_attr_destroy(&n->attr);
 err_out_destroy_test_settings:
 	pthread_rwlock_destroy(&n->test_settings_lock);
 err_out_destroy_reconnect_lock:
@@ -106,6 +128,8 @@ err_out_destroy_counter:
 	dnet_counter_destroy(n);
 err_out_destroy_wait:
 	dnet_wait_put(n->wait);
+err_out_destroy_route_reclaim:
+	pthread_mutex_destroy(&n->route_reclaim_lock);
 err_out_destroy_state:
 	pthread_mutex_destroy(&n->state_lock);
 err_out_free:
@@ -199,6 +223,228 @@ static int dnet_idc_compare(const void *k1, const void *k2)
 	return dnet_id_cmp_str(id1->raw.id, id2->raw.id);
 }
 
+static int dnet_route_group_compare(const void *k1, const void *k2)
+{
+	const struct dnet_route_group *g1 = k1;
+	const struct dnet_route_group *g2 = k2;
+
+	if (g1->group_id < g2->group_id)
+		return -1;
+	if (g1->group_id > g2->group_id)
+		return 1;
+	return 0;
+}
+
+/*
+ * Registers reader of the route table, published snapshot can be accessed
+ * until dnet_route_read_unlock() is called with returned index.
+ */
+static int dnet_route_read_lock(struct dnet_node *n)
+{
+	int idx = atomic_read(&n->route_epoch) & 1;
+
+	atomic_inc(&n->route_readers[idx]);
+	return idx;
+}
+
+static void dnet_route_read_unlock(struct dnet_node *n, int idx)
+{
+	atomic_dec(&n->route_readers[idx]);
+}
+
+static struct dnet_route_table *dnet_route_table_get(struct dnet_node *n)
+{
+	return __atomic_load_n(&n->route_table, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Waits until all readers which could have seen previously published snapshot are gone.
+ * Readers are directed into the other counter before each one is drained, since reader could load
+ * the epoch before snapshot has been replaced and register in either counter.
+ * Must be called under @n->route_reclaim_lock.
+ */
+static void dnet_route_synchronize(struct dnet_node *n)
+{
+	int idx;
+
+	for (idx = 0; idx < 2; ++idx) {
+		atomic_set(&n->route_epoch, !idx);
+
+		while (atomic_read(&n->route_readers[idx]) > 0)
+			sched_yield();
+	}
+}
+
+static void dnet_route_table_free(struct dnet_route_table *table)
+{
+	int i;
+
+	if (!table)
+		return;
+
+	for (i = 0; i < table->state_num; ++i)
+		dnet_state_put(table->states[i]);
+
+	free(table);
+}
+
+static struct dnet_route_table *dnet_route_table_build_nolock(struct dnet_node *n)
+{
+	struct dnet_route_table *table;
+	struct dnet_route_group *rg;
+	struct dnet_group *g;
+	struct dnet_idc *idc;
+	struct rb_node *it;
+	uint64_t *prefixes;
+	struct dnet_route_table_entry *entries;
+	size_t group_num = 0, id_num = 0, state_num = 0;
+	int i;
+
+	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
+		g = rb_entry(it, struct dnet_group, group_entry);
+		if (g->id_num) {
+			++group_num;
+			id_num += g->id_num;
+
+			list_for_each_entry(idc, &g->idc_list, group_entry) {
+				++state_num;
+			}
+		}
+	}
+
+	table = malloc(sizeof(struct dnet_route_table) + group_num * sizeof(struct dnet_route_group) +
+			state_num * sizeof(struct dnet_net_state *) +
+			id_num * (sizeof(uint64_t) + sizeof(struct dnet_route_table_entry)));
+	if (!table)
+		return NULL;
+
+	table->version = ++n->route_table_version;
+	table->group_num = group_num;
+	table->state_num = 0;
+	table->states = (struct dnet_net_state **)&table->groups[group_num];
+	table->retired_next = NULL;
+
+	prefixes = (uint64_t *)&table->states[state_num];
+	entries = (struct dnet_route_table_entry *)(prefixes + id_num);
+	rg = table->groups;
+
+	for (it = rb_first(&n->group_root); it; it = rb_next(it)) {
+		g = rb_entry(it, struct dnet_group, group_entry);
+		if (!g->id_num)
+			continue;
+
+		list_for_each_entry(idc, &g->idc_list, group_entry) {
+			table->states[table->state_num++] = dnet_state_get(idc->st);
+		}
+
+		rg->group_id = g->group_id;
+		rg->id_num = g->id_num;
+		rg->prefixes = prefixes;
+		rg->entries = entries;
+
+		for (i = 0; i < g->id_num; ++i) {
+			const struct dnet_state_id *sid = &g->ids[i];
+
+			prefixes[i] = dnet_id_prefix(sid->raw.id);
+			entries[i].raw = sid->raw;
+			entries[i].st = sid->idc->st;
+			entries[i].backend_id = sid->idc->backend_id;
+		}
+
+		prefixes += g->id_num;
+		entries += g->id_num;
+		++rg;
+	}
+
+	qsort(table->groups, table->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+	return table;
+}
+
+/*
+ * Rebuilds route table from the group tree and publishes it, must be called under @n->state_lock.
+ * Replaced snapshot is queued for dnet_route_table_reclaim(), it keeps states it references alive until then.
+ * If snapshot can not be allocated, the previous one is kept and check thread retries the update.
+ */
+static void dnet_route_table_update_nolock(struct dnet_node *n)
+{
+	struct dnet_route_table *table, *old;
+
+	table = dnet_route_table_build_nolock(n);
+	if (!table) {
+		n->route_table_dirty = 1;
+		dnet_log(n, DNET_LOG_ERROR, "Failed to allocate route table snapshot, keeping previous one until next update");
+		return;
+	}
+
+	n->route_table_dirty = 0;
+
+	old = n->route_table;
+	__atomic_store_n(&n->route_table, table, __ATOMIC_RELEASE);
+
+	if (old) {
+		old->retired_next = n->route_retired;
+		n->route_retired = old;
+	}
+}
+
+void dnet_route_table_reclaim(struct dnet_node *n)
+{
+	struct dnet_route_table *table, *next;
+
+	pthread_mutex_lock(&n->route_reclaim_lock);
+
+	pthread_mutex_lock(&n->state_lock);
+	table = n->route_retired;
+	n->route_retired = NULL;
+	pthread_mutex_unlock(&n->state_lock);
+
+	if (table)
+		dnet_route_synchronize(n);
+
+	pthread_mutex_unlock(&n->route_reclaim_lock);
+
+	/* states may be destroyed here, they take @n->state_lock to remove themselves */
+	for (; table; table = next) {
+		next = table->retired_next;
+		dnet_route_table_free(table);
+	}
+}
+
+void dnet_route_table_check(struct dnet_node *n)
+{
+	pthread_mutex_lock(&n->state_lock);
+	if (n->route_table_dirty)
+		dnet_route_table_update_nolock(n);
+	pthread_mutex_unlock(&n->state_lock);
+
+	dnet_route_table_reclaim(n);
+}
+
+static const struct dnet_route_group *dnet_route_group_search(const struct dnet_route_table *table, unsigned int group_id)
+{
+	struct dnet_route_group key;
+
+	if (!table)
+		return NULL;
+
+	key.group_id = group_id;
+	return bsearch(&key, table->groups, table->group_num, sizeof(struct dnet_route_group), dnet_route_group_compare);
+}
+
+/*
+ * Returns position of the largest ID which is not greater than @id,
+ * or the last one if all IDs in the group are greater (route ring wraps around).
+ */
+static int dnet_route_group_search_id(const struct dnet_route_group *g, const unsigned char *id)
+{
+	int pos = dnet_id_prefix_search(g->prefixes, g->entries, sizeof(struct dnet_route_table_entry), g->id_num, id);
+
+	if (pos < 0)
+		pos = g->id_num - 1;
+
+	return pos;
+}
+
 static void dnet_idc_remove_nolock(struct dnet_idc *idc)
 {
 	int i, pos;
@@ -272,7 +518,11 @@ int dnet_idc_insert_nolock(struct dnet_net_state *st, struct dnet_idc *idc_new)
 	return 0;
 }
 
-void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
+/*
+ * Removes backend's IDs from the group without publishing new route table,
+ * returns 1 if backend has been found.
+ */
+static int __dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
 {
 	struct dnet_idc *idc = dnet_idc_search_backend_nolock(st, backend_id);
 	if (idc) {
@@ -280,12 +530,21 @@ void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
 		dnet_idc_remove_nolock(idc);
 		pthread_rwlock_unlock(&st->idc_lock);
 	}
+
+	return idc != NULL;
+}
+
+void dnet_idc_remove_backend_nolock(struct dnet_net_state *st, int backend_id)
+{
+	if (__dnet_idc_remove_backend_nolock(st, backend_id))
+		dnet_route_table_update_nolock(st->n);
 }
 
 static void dnet_idc_remove_all(struct dnet_net_state *st)
 {
 	struct dnet_idc *idc;
 	struct rb_node *rb_node, *next;
+	int removed = 0;
 
 	pthread_rwlock_wrlock(&st->idc_lock);
 	for (rb_node = rb_first(&st->idc_root); rb_node != NULL; rb_node = next) {
@@ -293,8 +552,12 @@ static void dnet_idc_remove_all(struct dnet_net_state *st)
 
 		next = rb_next(rb_node);
 		dnet_idc_remove_nolock(idc);
+		removed = 1;
 	}
 	pthread_rwlock_unlock(&st->idc_lock);
+
+	if (removed)
+		dnet_route_table_update_nolock(st->n);
 }
 
 int dnet_state_set_server_prio(struct dnet_net_state *st)
@@ -344,6 +607,7 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 		dnet_idc_remove_backend_nolock(st, backend->backend_id);
 		pthread_mutex_unlock(&n->state_lock);
 
+		dnet_route_table_reclaim(n);
 		return 0;
 	}
 
@@ -374,7 +638,7 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 			goto err_out_unlock_put;
 	}
 
-	dnet_idc_remove_backend_nolock(st, backend->backend_id);
+	__dnet_idc_remove_backend_nolock(st, backend->backend_id);
 
 	g->ids = realloc(g->ids, (g->id_num + id_num) * sizeof(struct dnet_state_id));
 	if (!g->ids) {
@@ -419,8 +683,12 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 		}
 	}
 
+	dnet_route_table_update_nolock(n);
+
 	pthread_mutex_unlock(&n->state_lock);
 
+	dnet_route_table_reclaim(n);
+
 	gettimeofday(&end, NULL);
 	diff = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
 
@@ -435,8 +703,11 @@ int dnet_idc_update_backend(struct dnet_net_state *st, struct dnet_backend_ids *
 
 err_out_unlock_put:
 	dnet_group_put(g);
+	/* previous IDs of the backend could have been removed already */
+	dnet_route_table_update_nolock(n);
 err_out_unlock:
 	pthread_mutex_unlock(&n->state_lock);
+	dnet_route_table_reclaim(n);
 	free(idc);
 err_out_exit:
 	gettimeofday(&end, NULL);
@@ -451,99 +722,52 @@ void dnet_idc_destroy_nolock(struct dnet_net_state *st)
 	dnet_idc_remove_all(st);
 }
 
-static int __dnet_idc_search(struct dnet_group *g, const struct dnet_id *id)
-{
-	int low, high, i, cmp;
-	struct dnet_state_id *sid;
-
-	for (low = -1, high = g->id_num; high-low > 1; ) {
-		i = low + (high - low)/2;
-		sid = &g->ids[i];
-
-		cmp = dnet_id_cmp_str(sid->raw.id, id->id);
-		if (cmp < 0)
-			low = i;
-		else if (cmp > 0)
-			high = i;
-		else
-			goto out;
-	}
-	i = high - 1;
-
-out:
-	if (i == -1)
-		i = g->id_num - 1;
-
-	return i;
-}
-
-static struct dnet_state_id *dnet_idc_search(struct dnet_group *g, const struct dnet_id *id)
-{
-	return &g->ids[__dnet_idc_search(g, id)];
-}
-
-static int dnet_search_range_nolock(struct dnet_node *n, struct dnet_id *id, struct dnet_raw_id *start, struct dnet_raw_id *next)
+int dnet_search_range(struct dnet_node *n, struct dnet_id *id, struct dnet_raw_id *start, struct dnet_raw_id *next)
 {
-	struct dnet_state_id *sid;
-	struct dnet_group *group;
-	int idc_pos;
-
-	group = dnet_group_search(n, id->group_id);
-	if (!group)
-		return -ENXIO;
-
-	idc_pos = __dnet_idc_search(group, id);
-	sid = &group->ids[idc_pos];
-	memcpy(start, &sid->raw, sizeof(struct dnet_raw_id));
+	const struct dnet_route_group *group;
+	int idx, pos, err = -ENXIO;
 
-	if (++idc_pos >= group->id_num)
-		idc_pos = 0;
-	sid = &group->ids[idc_pos];
-	memcpy(next, &sid->raw, sizeof(struct dnet_raw_id));
+	idx = dnet_route_read_lock(n);
 
-	dnet_group_put(group);
+	group = dnet_route_group_search(dnet_route_table_get(n), id->group_id);
+	if (group) {
+		pos = dnet_route_group_search_id(group, id->id);
+		memcpy(start, &group->entries[pos].raw, sizeof(struct dnet_raw_id));
 
-	return 0;
-}
+		if (++pos >= group->id_num)
+			pos = 0;
+		memcpy(next, &group->entries[pos].raw, sizeof(struct dnet_raw_id));
 
-int dnet_search_range(struct dnet_node *n, struct dnet_id *id, struct dnet_raw_id *start, struct dnet_raw_id *next)
-{
-	int err;
+		err = 0;
+	}
 
-	pthread_mutex_lock(&n->state_lock);
-	err = dnet_search_range_nolock(n, id, start, next);
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_route_read_unlock(n, idx);
 
 	return err;
 }
 
-static struct dnet_state_id *__dnet_state_search_id(struct dnet_node *n, const struct dnet_id *id)
+static struct dnet_net_state *__dnet_state_search(struct dnet_node *n, const struct dnet_id *id, int *backend_id)
 {
-	struct dnet_state_id *sid;
-	struct dnet_group *group;
-
-	group = dnet_group_search(n, id->group_id);
-	if (!group)
-		return NULL;
-
-	sid = dnet_idc_search(group, id);
+	const struct dnet_route_group *group;
+	const struct dnet_route_table_entry *entry;
+	struct dnet_net_state *found = NULL;
+	int idx;
 
-	dnet_group_put(group);
+	idx = dnet_route_read_lock(n);
 
-	return sid;
-}
+	group = dnet_route_group_search(dnet_route_table_get(n), id->group_id);
+	if (group) {
+		entry = &group->entries[dnet_route_group_search_id(group, id->id)];
 
-static struct dnet_net_state *__dnet_state_search(struct dnet_node *n, const struct dnet_id *id, int *backend_id)
-{
-	struct dnet_state_id *sid = __dnet_state_search_id(n, id);
+		if (backend_id)
+			*backend_id = entry->backend_id;
 
-	if (!sid)
-		return NULL;
+		found = dnet_state_get(entry->st);
+	}
 
-	if (backend_id)
-		*backend_id = sid->idc->backend_id;
+	dnet_route_read_unlock(n, idx);
 
-	return dnet_state_get(sid->idc->st);
+	return found;
 }
 
 struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const struct dnet_addr *addr)
@@ -563,50 +787,33 @@ struct dnet_net_state *dnet_state_search_by_addr(struct dnet_node *n, const stru
 	return found;
 }
 
+/*
+ * Route table is not protected by @n->state_lock anymore,
+ * this function can be called both with and without it.
+ */
 struct dnet_net_state *dnet_state_search_nolock(struct dnet_node *n, const struct dnet_id *id, int *backend_id)
 {
-	struct dnet_net_state *found;
-
-	found = __dnet_state_search(n, id, backend_id);
-	if (!found) {
-		struct dnet_group *g;
-
-		g = dnet_group_search(n, id->group_id);
-		if (!g)
-			goto err_out_exit;
-
-		found = dnet_state_get(g->ids[0].idc->st);
-		if (backend_id)
-			*backend_id = g->ids[0].idc->backend_id;
-
-		dnet_group_put(g);
-	}
-
-err_out_exit:
-	return found;
+	return __dnet_state_search(n, id, backend_id);
 }
 
 ssize_t dnet_state_search_backend(struct dnet_node *n, const struct dnet_id *id)
 {
+	const struct dnet_route_group *group;
+	const struct dnet_route_table_entry *entry;
 	ssize_t backend_id = -1;
-	struct dnet_state_id *sid;
+	int idx;
 
-	pthread_mutex_lock(&n->state_lock);
+	idx = dnet_route_read_lock(n);
 
-	sid = __dnet_state_search_id(n, id);
-	if (!sid) {
-		struct dnet_group *g;
+	group = dnet_route_group_search(dnet_route_table_get(n), id->group_id);
+	if (group) {
+		entry = &group->entries[dnet_route_group_search_id(group, id->id)];
 
-		g = dnet_group_search(n, id->group_id);
-		if (g) {
-			sid = &g->ids[0];
-		}
+		if (entry->st == n->st)
+			backend_id = entry->backend_id;
 	}
 
-	if (sid && sid->idc->st == n->st)
-		backend_id = sid->idc->backend_id;
-
-	pthread_mutex_unlock(&n->state_lock);
+	dnet_route_read_unlock(n, idx);
 
 	return backend_id;
 }
@@ -616,6 +823,8 @@ int dnet_get_backend_weight(struct dnet_net_state *st, int backend_id, uint32_t
 	struct dnet_idc *idc;
 	int err = -ENOENT;
 
+	st = dnet_state_primary(st);
+
 	pthread_rwlock_rdlock(&st->idc_lock);
 	idc = dnet_idc_search_backend_nolock(st, backend_id);
 	if (idc) {
@@ -636,6 +845,8 @@ void dnet_set_backend_weight(struct dnet_net_state *st, int backend_id, uint32_t
 {
 	struct dnet_idc *idc;
 
+	st = dnet_state_primary(st);
+
 	pthread_rwlock_rdlock(&st->idc_lock);
 	idc = dnet_idc_search_backend_nolock(st, backend_id);
 	if (idc) {
@@ -667,9 +878,7 @@ struct dnet_net_state *dnet_state_get_first_with_backend(struct dnet_node *n, co
 {
 	struct dnet_net_state *found;
 
-	pthread_mutex_lock(&n->state_lock);
 	found = dnet_state_search_nolock(n, id, backend_id);
-	pthread_mutex_unlock(&n->state_lock);
 
 	if (!found) {
 		dnet_log(n, DNET_LOG_ERROR, "%s: could not find network state for request", dnet_dump_id(id));
@@ -787,6 +996,15 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 	n->client_prio = cfg->client_prio;
 	n->server_prio = cfg->server_prio;
 
+	n->net_lanes = cfg->net_lanes;
+	if (n->net_lanes < 1)
+		n->net_lanes = 1;
+	if (n->net_lanes > DNET_NET_LANES_MAX) {
+		dnet_log(n, DNET_LOG_NOTICE, "Number of net lanes %d is too large, using %d.",
+				n->net_lanes, DNET_NET_LANES_MAX);
+		n->net_lanes = DNET_NET_LANES_MAX;
+	}
+
 	if (!n->indexes_shard_count) {
 		n->indexes_shard_count = DNET_DEFAULT_INDEXES_SHARD_COUNT;
 		dnet_log(n, DNET_LOG_NOTICE, "Using default indexes shard count (%d shards).",
@@ -815,6 +1033,7 @@ err_out_io_exit:
 err_out_crypto_cleanup:
 	dnet_crypto_cleanup(n);
 err_out_free:
+	dnet_trans_cache_destroy(n);
 	free(n);
 err_out_exit:
 	pthread_sigmask(SIG_SETMASK, &previous_sigset, NULL);
@@ -851,6 +1070,11 @@ void dnet_node_cleanup_common_resources(struct dnet_node *n)
 
 	pthread_attr_destroy(&n->attr);
 
+	dnet_route_table_reclaim(n);
+	dnet_route_table_free(n->route_table);
+	n->route_table = NULL;
+
+	pthread_mutex_destroy(&n->route_reclaim_lock);
 	pthread_mutex_destroy(&n->state_lock);
 	dnet_crypto_cleanup(n);
 
@@ -865,6 +1089,8 @@ void dnet_node_cleanup_common_resources(struct dnet_node *n)
 
 	free(n->test_settings);
 	free(n->route_addr);
+
+	dnet_trans_cache_cleanup(n);
 }
 
 void dnet_node_destroy(struct dnet_node *n)
@@ -874,6 +1100,7 @@ void dnet_node_destroy(struct dnet_node *n)
 	dnet_node_stop_common_resources(n);
 	dnet_node_cleanup_common_resources(n);
 	dnet_counter_destroy(n);
+	dnet_trans_cache_destroy(n);
 
 	free(n);
 }
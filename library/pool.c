@@ -172,6 +172,29 @@ static void dnet_work_pool_place_cleanup(struct dnet_work_pool_place *pool)
 	pthread_mutex_destroy(&pool->lock);
 }
 
+/*
+ * Names of pool metrics are built once here, IO threads and scheduler only pass them to handystats.
+ * Could have used dnet_work_io_mode_str() to get string name for the pool's mode,
+ * but for statistic lowercase names works better and dnet_work_io_mode_str() provides mode names in uppercase.
+ */
+static void dnet_work_pool_stat_names_init(struct dnet_work_pool *pool)
+{
+	struct dnet_work_pool_stat_names *names = &pool->stat_names;
+	const char *mode_marker = ((pool->mode == DNET_WORK_IO_MODE_BLOCKING) ? "blocking" : "nonblocking");
+	char id[DNET_STAT_NAME_SIZE];
+
+	if (pool->io) {
+		snprintf(id, sizeof(id), "%zu.%s", pool->io->backend_id, mode_marker);
+	} else {
+		snprintf(id, sizeof(id), "sys.%s", mode_marker);
+	}
+
+	snprintf(names->queue_wait_time, sizeof(names->queue_wait_time), "pool.%s.queue.wait_time", id);
+	snprintf(names->queue_size, sizeof(names->queue_size), "pool.%s.queue.size", id);
+	snprintf(names->active_threads, sizeof(names->active_threads), "pool.%s.active_threads", id);
+	snprintf(names->search_trans_time, sizeof(names->search_trans_time), "pool.%s.search_trans_time", id);
+}
+
 int dnet_work_pool_alloc(struct dnet_work_pool_place *place, struct dnet_node *n,
 	struct dnet_backend_io *io, int num, int mode, void *(* process)(void *))
 {
@@ -197,8 +220,11 @@ int dnet_work_pool_alloc(struct dnet_work_pool_place *place, struct dnet_node *n
 	pool->n = n;
 	pool->io = io;
 
+	dnet_work_pool_stat_names_init(pool);
+
 	const int has_backend = io ? 1 : 0;
-	pool->request_queue = dnet_request_queue_create(has_backend);
+	const int sharded = !!(n->flags & DNET_CFG_SHARDED_REQUEST_QUEUE);
+	pool->request_queue = dnet_request_queue_create(has_backend, sharded, num);
 	if (!pool->request_queue) {
 		err = -ENOMEM;
 		goto err_out_mutex_destroy;
@@ -240,19 +266,6 @@ static int dnet_cmd_needs_backend(int command)
 	return 1;
 }
 
-static inline void make_thread_stat_id(char *buffer, int size, struct dnet_work_pool *pool)
-{
-	/* Could have used dnet_work_io_mode_str() to get string name
-	 for the pool's mode, but for statistic lowercase names works better and
-	 dnet_work_io_mode_str() provides mode names in uppercase.
-	*/
-	const char *mode_marker = ((pool->mode == DNET_WORK_IO_MODE_BLOCKING) ? "blocking" : "nonblocking");
-	if (pool->io) {
-		snprintf(buffer, size - 1, "%zu.%s", pool->io->backend_id, mode_marker);
-	} else {
-		snprintf(buffer, size - 1, "sys.%s", mode_marker);
-	}
-}
 
 static void dnet_update_trans_timestamp_network(struct dnet_io_req *r)
 {
@@ -268,7 +281,7 @@ static void dnet_update_trans_timestamp_network(struct dnet_io_req *r)
 			dnet_trans_update_timestamp(t);
 
 			/*
-			 * Always remove transaction from 'timer' tree,
+			 * Always remove transaction from timer wheel,
 			 * thus it will not be found by checker thread and
 			 * its callback will not be called under us.
 			 */
@@ -289,7 +302,6 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 	struct dnet_cmd *cmd = r->header;
 	int nonblocking = !!(cmd->flags & DNET_FLAGS_NOLOCK);
 	ssize_t backend_id = -1;
-	char thread_stat_id[255];
 
 	if (cmd->size > 0) {
 		dnet_log(r->st->n, DNET_LOG_DEBUG, "%s: %s: RECV cmd: %s: cmd-size: %llu, nonblocking: %d",
@@ -346,8 +358,6 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 
 	pool = place->pool;
 
-	make_thread_stat_id(thread_stat_id, sizeof(thread_stat_id), pool);
-
 	// If we are processing the command we should update cmd->backend_id to actual one
 	if (!(cmd->flags & DNET_FLAGS_REPLY)) {
 		if (pool->io)
@@ -366,12 +376,125 @@ void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 
 	pthread_mutex_unlock(&place->lock);
 
-	FORMATTED(HANDY_TIMER_START, ("pool.%s.queue.wait_time", thread_stat_id), (unsigned long)&r->req_entry);
-	FORMATTED(HANDY_COUNTER_INCREMENT, ("pool.%s.queue.size", thread_stat_id), 1);
+	HANDY_TIMER_START(pool->stat_names.queue_wait_time, (unsigned long)&r->req_entry);
+	HANDY_COUNTER_INCREMENT(pool->stat_names.queue_size, 1);
 	HANDY_COUNTER_INCREMENT("io.input.queue.size", 1);
 }
 
 
+struct dnet_io_buf_pool *dnet_io_buf_pool_create(void)
+{
+	struct dnet_io_buf_pool *pool;
+	int i, err;
+
+	pool = calloc(1, sizeof(struct dnet_io_buf_pool));
+	if (!pool)
+		return NULL;
+
+	err = pthread_mutex_init(&pool->lock, NULL);
+	if (err) {
+		free(pool);
+		return NULL;
+	}
+
+	for (i = 0; i < DNET_IO_BUF_CLASSES; ++i)
+		INIT_LIST_HEAD(&pool->free_list[i]);
+
+	atomic_init(&pool->refcnt, 1);
+	return pool;
+}
+
+static void dnet_io_buf_pool_put(struct dnet_io_buf_pool *pool)
+{
+	if (atomic_dec_and_test(&pool->refcnt)) {
+		pthread_mutex_destroy(&pool->lock);
+		free(pool);
+	}
+}
+
+/*
+ * Drops cached buffers and owner's reference,
+ * buffers which are still in use will be freed to heap when released.
+ */
+void dnet_io_buf_pool_destroy(struct dnet_io_buf_pool *pool)
+{
+	struct dnet_io_req *r, *tmp;
+	int i;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->need_exit = 1;
+	for (i = 0; i < DNET_IO_BUF_CLASSES; ++i) {
+		list_for_each_entry_safe(r, tmp, &pool->free_list[i], req_entry) {
+			list_del(&r->req_entry);
+			free(r);
+		}
+		pool->free_num[i] = 0;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	dnet_io_buf_pool_put(pool);
+}
+
+struct dnet_io_req *dnet_io_buf_alloc(struct dnet_io_buf_pool *pool, size_t size)
+{
+	struct dnet_io_req *r = NULL;
+	int cls = 0;
+
+	while (cls < DNET_IO_BUF_CLASSES && size > (1UL << (DNET_IO_BUF_MIN_SHIFT + cls)))
+		++cls;
+
+	if (!pool || cls == DNET_IO_BUF_CLASSES) {
+		r = malloc(size);
+		if (r)
+			memset(r, 0, sizeof(struct dnet_io_req));
+		return r;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (!list_empty(&pool->free_list[cls])) {
+		r = list_first_entry(&pool->free_list[cls], struct dnet_io_req, req_entry);
+		list_del(&r->req_entry);
+		pool->free_num[cls]--;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	if (!r) {
+		r = malloc(1UL << (DNET_IO_BUF_MIN_SHIFT + cls));
+		if (!r)
+			return NULL;
+	}
+
+	memset(r, 0, sizeof(struct dnet_io_req));
+	r->buf_pool = pool;
+	r->buf_class = cls;
+
+	atomic_inc(&pool->refcnt);
+	return r;
+}
+
+void dnet_io_buf_free(struct dnet_io_req *r)
+{
+	struct dnet_io_buf_pool *pool = r->buf_pool;
+	int cls = r->buf_class;
+
+	if (!pool) {
+		free(r);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->lock);
+	if (!pool->need_exit &&
+			pool->free_num[cls] < (DNET_IO_BUF_CACHE_SIZE >> (DNET_IO_BUF_MIN_SHIFT + cls))) {
+		list_add(&r->req_entry, &pool->free_list[cls]);
+		pool->free_num[cls]++;
+		r = NULL;
+	}
+	pthread_mutex_unlock(&pool->lock);
+
+	free(r);
+	dnet_io_buf_pool_put(pool);
+}
+
 void dnet_schedule_command(struct dnet_net_state *st)
 {
 	st->rcv_flags = DNET_IO_CMD;
@@ -383,7 +506,7 @@ void dnet_schedule_command(struct dnet_net_state *st)
 		dnet_log(st->n, DNET_LOG_DEBUG, "freed: size: %llu, trans: %llu, reply: %d, ptr: %p.",
 						(unsigned long long)c->size, tid, tid != c->trans, st->rcv_data);
 #endif
-		free(st->rcv_data);
+		dnet_io_buf_free(st->rcv_data);
 		st->rcv_data = NULL;
 	}
 
@@ -391,14 +514,23 @@ void dnet_schedule_command(struct dnet_net_state *st)
 	st->rcv_offset = 0;
 }
 
-static int dnet_process_recv_single(struct dnet_net_state *st)
+/*
+ * Size of per-state read-ahead buffer.
+ * Payloads which are not smaller than the buffer are received directly into request.
+ */
+#define DNET_RECV_BUFFER_SIZE	(16 * 1024)
+
+static int dnet_process_recv_single(struct dnet_net_io *nio, struct dnet_net_state *st)
 {
 	struct dnet_node *n = st->n;
 	struct dnet_io_req *r;
 	void *data;
 	uint64_t size;
+	size_t avail;
+	int direct;
 	int err;
 
+next:
 	dnet_node_set_trace_id(n->log, st->rcv_cmd.trace_id, st->rcv_cmd.flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
 again:
 	/*
@@ -412,30 +544,63 @@ again:
 	size = st->rcv_end - st->rcv_offset;
 
 	if (size) {
-		err = recv(st->read_s, data, size, 0);
-		if (err < 0) {
-			err = -EAGAIN;
-			if (errno != EAGAIN && errno != EINTR) {
-				err = -errno;
-				dnet_log_err(n, "%s: failed to receive data, socket: %d/%d",
-						dnet_state_dump_addr(st), st->read_s, st->write_s);
+		avail = st->rcv_buf_end - st->rcv_buf_start;
+
+		if (!avail) {
+			direct = !(st->rcv_flags & DNET_IO_CMD) && size >= DNET_RECV_BUFFER_SIZE;
+
+			if (!direct && !st->rcv_buf) {
+				st->rcv_buf = malloc(DNET_RECV_BUFFER_SIZE);
+				if (!st->rcv_buf) {
+					err = -ENOMEM;
+					goto out;
+				}
+			}
+
+			if (direct)
+				err = recv(st->read_s, data, size, 0);
+			else
+				err = recv(st->read_s, st->rcv_buf, DNET_RECV_BUFFER_SIZE, 0);
+			if (err < 0) {
+				err = -EAGAIN;
+				if (errno != EAGAIN && errno != EINTR) {
+					err = -errno;
+					dnet_log_err(n, "%s: failed to receive data, socket: %d/%d",
+							dnet_state_dump_addr(st), st->read_s, st->write_s);
+					goto out;
+				}
+
 				goto out;
 			}
 
-			goto out;
+			if (err == 0) {
+				dnet_log(n, DNET_LOG_ERROR, "%s: peer has disconnected, socket: %d/%d.",
+					dnet_state_dump_addr(st), st->read_s, st->write_s);
+				err = -ECONNRESET;
+				goto out;
+			}
+
+			if (direct) {
+				avail = 0;
+				st->rcv_offset += err;
+			} else {
+				avail = err;
+				st->rcv_buf_start = 0;
+				st->rcv_buf_end = avail;
+			}
 		}
 
-		if (err == 0) {
-			dnet_log(n, DNET_LOG_ERROR, "%s: peer has disconnected, socket: %d/%d.",
-				dnet_state_dump_addr(st), st->read_s, st->write_s);
-			err = -ECONNRESET;
-			goto out;
+		if (avail) {
+			if (avail > size)
+				avail = size;
+
+			memcpy(data, st->rcv_buf + st->rcv_buf_start, avail);
+			st->rcv_buf_start += avail;
+			st->rcv_offset += avail;
 		}
 
 		dnet_node_unset_trace_id();
 		dnet_node_set_trace_id(n->log, st->rcv_cmd.trace_id, st->rcv_cmd.flags & DNET_FLAGS_TRACE_BIT, (ssize_t)-1);
-
-		st->rcv_offset += err;
 	}
 
 	if (st->rcv_offset != st->rcv_end)
@@ -455,12 +620,11 @@ again:
 				dnet_state_dump_addr(st), c->backend_id,
 				(unsigned long long)c->size, dnet_flags_dump_cflags(c->flags), c->status);
 
-		r = malloc(c->size + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
+		r = dnet_io_buf_alloc(nio->buf_pool, c->size + sizeof(struct dnet_cmd) + sizeof(struct dnet_io_req));
 		if (!r) {
 			err = -ENOMEM;
 			goto out;
 		}
-		memset(r, 0, sizeof(struct dnet_io_req));
 
 		r->header = r + 1;
 		r->hsize = sizeof(struct dnet_cmd);
@@ -491,6 +655,14 @@ again:
 
 	dnet_schedule_io(n, r);
 	dnet_node_unset_trace_id();
+
+	/*
+	 * Socket will not be reported as readable if the rest of received data
+	 * is already in the read-ahead buffer, so process it right now.
+	 */
+	if (st->rcv_buf_start != st->rcv_buf_end)
+		goto next;
+
 	return 0;
 
 out:
@@ -646,49 +818,148 @@ void dnet_unschedule_all(struct dnet_net_state *st)
 		epoll_ctl(st->epoll_fd, EPOLL_CTL_DEL, st->accept_s, NULL);
 }
 
+/* charges class of the sent request and releases its stream slot */
+void dnet_send_list_del_nolock(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	list_del(&r->req_entry);
+	st->send_deficit[r->send_class] -= r->hsize + r->dsize + r->fsize;
+	if (r->send_stream == DNET_SEND_STREAMS)
+		st->send_streams_overflow--;
+	else if (r->send_stream >= 0)
+		st->send_streams[r->send_stream].num--;
+}
+
+static void dnet_send_request_complete(struct dnet_net_state *st, struct dnet_io_req *r)
+{
+	pthread_mutex_lock(&st->send_lock);
+	dnet_send_list_del_nolock(st, r);
+	pthread_mutex_unlock(&st->send_lock);
+
+	pthread_mutex_lock(&st->n->io->full_lock);
+	list_stat_size_decrease(&st->n->io->output_stats, 1);
+	pthread_mutex_unlock(&st->n->io->full_lock);
+	HANDY_COUNTER_DECREMENT("io.output.queue.size", 1);
+
+	if (atomic_read(&st->send_queue_size) > 0)
+		if (atomic_dec(&st->send_queue_size) == DNET_SEND_WATERMARK_LOW) {
+			dnet_log(st->n, DNET_LOG_DEBUG,
+					"State low_watermark reached: %s: %ld, waking up",
+					dnet_addr_string(&st->addr),
+					atomic_read(&st->send_queue_size));
+			pthread_cond_broadcast(&st->send_wait);
+		}
+
+	atomic_inc(&st->send_requests);
+	dnet_io_req_free(r);
+}
+
+static inline long dnet_send_quantum(int send_class)
+{
+	return (long)DNET_SEND_QUANTUM << (DNET_SEND_CLASS_BULK - send_class);
+}
+
+/*
+ * Deficit round robin over send classes, see DNET_SEND_CLASSES. Deficit is charged when request has been sent,
+ * it goes negative after large request and is paid back in the following rounds.
+ * Partially sent request is always continued first, since @st->send_offset points into it.
+ * Returns send queue to take requests from, it is empty only if there is nothing to send.
+ */
+struct list_head *dnet_send_list_pick_nolock(struct dnet_net_state *st)
+{
+	long rounds, r;
+	int i, c, backlogged;
+
+	c = st->send_class;
+	if (st->send_offset || (!list_empty(&st->send_list[c]) && st->send_deficit[c] > 0))
+		return &st->send_list[c];
+
+	while (1) {
+		rounds = LONG_MAX;
+		backlogged = 0;
+
+		for (i = 1; i <= DNET_SEND_CLASSES; ++i) {
+			c = (st->send_class + i) % DNET_SEND_CLASSES;
+			if (list_empty(&st->send_list[c])) {
+				st->send_deficit[c] = 0;
+				continue;
+			}
+
+			backlogged = 1;
+			st->send_deficit[c] += dnet_send_quantum(c);
+			if (st->send_deficit[c] > 0) {
+				st->send_class = c;
+				return &st->send_list[c];
+			}
+
+			r = -st->send_deficit[c] / dnet_send_quantum(c) + 1;
+			if (r < rounds)
+				rounds = r;
+		}
+
+		if (!backlogged)
+			return &st->send_list[st->send_class];
+
+		/* all backlogged classes are in debt, skip rounds which would not send anything */
+		for (c = 0; c < DNET_SEND_CLASSES; ++c) {
+			if (!list_empty(&st->send_list[c]))
+				st->send_deficit[c] += (rounds - 1) * dnet_send_quantum(c);
+		}
+	}
+}
+
 static int dnet_process_send_single(struct dnet_net_state *st)
 {
-	struct dnet_io_req *r = NULL;
+	struct dnet_io_req *reqs[DNET_SEND_BATCH_MAX];
+	struct dnet_io_req *r;
+	struct list_head *send_list;
+	size_t total_size;
+	int num, i;
 	int err;
 
 	while (1) {
-		r = NULL;
+		num = 0;
 
+		/*
+		 * Gather requests from the head of the picked queue until the first one with file descriptor attached,
+		 * the latter is sent on its own since its content goes through sendfile()
+		 */
 		pthread_mutex_lock(&st->send_lock);
-		if (!list_empty(&st->send_list)) {
-			r = list_first_entry(&st->send_list, struct dnet_io_req, req_entry);
-		} else {
-			dnet_unschedule_send(st);
+		send_list = dnet_send_list_pick_nolock(st);
+		list_for_each_entry(r, send_list, req_entry) {
+			if (r->fd >= 0 && r->fsize) {
+				if (num == 0)
+					reqs[num++] = r;
+				break;
+			}
+
+			reqs[num++] = r;
+			if (num == DNET_SEND_BATCH_MAX)
+				break;
 		}
+
+		if (!num)
+			dnet_unschedule_send(st);
 		pthread_mutex_unlock(&st->send_lock);
 
-		if (!r) {
+		if (!num) {
 			err = -EAGAIN;
 			goto err_out_exit;
 		}
 
-		err = dnet_send_request(st, r);
-		if (st->send_offset == (r->dsize + r->hsize + r->fsize)) {
-			pthread_mutex_lock(&st->send_lock);
-			list_del(&r->req_entry);
-			pthread_mutex_unlock(&st->send_lock);
-
-			pthread_mutex_lock(&st->n->io->full_lock);
-			list_stat_size_decrease(&st->n->io->output_stats, 1);
-			pthread_mutex_unlock(&st->n->io->full_lock);
-			HANDY_COUNTER_DECREMENT("io.output.queue.size", 1);
-
-			if (atomic_read(&st->send_queue_size) > 0)
-				if (atomic_dec(&st->send_queue_size) == DNET_SEND_WATERMARK_LOW) {
-					dnet_log(st->n, DNET_LOG_DEBUG,
-							"State low_watermark reached: %s: %ld, waking up",
-							dnet_addr_string(&st->addr),
-							atomic_read(&st->send_queue_size));
-					pthread_cond_broadcast(&st->send_wait);
-				}
+		if (reqs[0]->fd >= 0 && reqs[0]->fsize)
+			err = dnet_send_request(st, reqs[0]);
+		else
+			err = dnet_send_request_batch(st, reqs, num);
 
-			dnet_io_req_free(r);
-			st->send_offset = 0;
+		/* @st->send_offset is counted from the beginning of the first request */
+		for (i = 0; i < num; ++i) {
+			r = reqs[i];
+			total_size = r->dsize + r->hsize + r->fsize;
+			if (st->send_offset < total_size)
+				break;
+
+			st->send_offset -= total_size;
+			dnet_send_request_complete(st, r);
 		}
 
 		if (err)
@@ -770,12 +1041,12 @@ int dnet_schedule_recv(struct dnet_net_state *st)
 	return dnet_schedule_network_io(st, 0);
 }
 
-static int dnet_state_net_process(struct dnet_net_state *st, struct epoll_event *ev)
+static int dnet_state_net_process(struct dnet_net_io *nio, struct dnet_net_state *st, struct epoll_event *ev)
 {
 	int err = -ECONNRESET;
 
 	if (ev->events & EPOLLIN) {
-		err = dnet_process_recv_single(st);
+		err = dnet_process_recv_single(nio, st);
 		if (err && (err != -EAGAIN))
 			goto err_out_exit;
 	}
@@ -926,7 +1197,7 @@ static void *dnet_io_process_network(void *data_)
 			} else if ((evs[i].events & EPOLLOUT) || dnet_check_io(n->io)) {
 				// if this is sending event or io pool queues are not full then process it
 				++tmp;
-				err = dnet_state_net_process(st, &evs[i]);
+				err = dnet_state_net_process(nio, st, &evs[i]);
 			} else {
 				continue;
 			}
@@ -955,7 +1226,7 @@ static void *dnet_io_process_network(void *data_)
 				// while every transaction holds a reference
 				//
 				// IO thread could remove transaction, it is the only place allowed to do it.
-				// transactions may live in the tree and be accessed without locks in IO thread,
+				// transactions may live in the trans table and be accessed without locks in IO thread,
 				// IO thread is kind of 'owner' of the transaction processing
 				dnet_state_put(st);
 				break;
@@ -1017,7 +1288,6 @@ void *dnet_io_process(void *data_)
 	struct dnet_io_req *r;
 	struct dnet_cmd *cmd;
 	int nonblocking = (pool->mode == DNET_WORK_IO_MODE_NONBLOCKING);
-	char thread_stat_id[255];
 
 	if (pool->io) {
 		dnet_set_name("dnet_%sio_%zu", nonblocking ? "nb_" : "", pool->io->backend_id);
@@ -1025,14 +1295,12 @@ void *dnet_io_process(void *data_)
 		dnet_set_name("dnet_%sio", nonblocking ? "nb_" : "");
 	}
 
-	make_thread_stat_id(thread_stat_id, sizeof(thread_stat_id), pool);
-
 	dnet_log(n, DNET_LOG_NOTICE, "started io thread: #%d, nonblocking: %d, backend: %zd",
 		wio->thread_index, nonblocking, pool->io ? (ssize_t)pool->io->backend_id : -1);
 
 
 	while (!n->need_exit && (!pool->io || !pool->io->need_exit)) {
-		r = dnet_pop_request(wio, thread_stat_id);
+		r = dnet_pop_request(wio);
 		if (!r)
 			continue;
 
@@ -1040,10 +1308,10 @@ void *dnet_io_process(void *data_)
 
 		HANDY_COUNTER_DECREMENT("io.input.queue.size", 1);
 
-		FORMATTED(HANDY_COUNTER_DECREMENT, ("pool.%s.queue.size", thread_stat_id), 1);
-		FORMATTED(HANDY_TIMER_STOP, ("pool.%s.queue.wait_time", thread_stat_id), (unsigned long)r);
+		HANDY_COUNTER_DECREMENT(pool->stat_names.queue_size, 1);
+		HANDY_TIMER_STOP(pool->stat_names.queue_wait_time, (unsigned long)r);
 
-		FORMATTED(HANDY_COUNTER_INCREMENT, ("pool.%s.active_threads", thread_stat_id), 1);
+		HANDY_COUNTER_INCREMENT(pool->stat_names.active_threads, 1);
 
 		st = r->st;
 		cmd = r->header;
@@ -1065,7 +1333,7 @@ void *dnet_io_process(void *data_)
 		dnet_io_req_free(r);
 		dnet_state_put(st);
 
-		FORMATTED(HANDY_COUNTER_DECREMENT, ("pool.%s.active_threads", thread_stat_id), 1);
+		HANDY_COUNTER_DECREMENT(pool->stat_names.active_threads, 1);
 	}
 
 	dnet_log(n, DNET_LOG_NOTICE, "finished io thread: #%d, nonblocking: %d, backend: %zd",
@@ -1135,10 +1403,18 @@ int dnet_io_init(struct dnet_node *n, struct dnet_config *cfg)
 
 		nio->n = n;
 
+		nio->buf_pool = dnet_io_buf_pool_create();
+		if (!nio->buf_pool) {
+			err = -ENOMEM;
+			dnet_log(n, DNET_LOG_ERROR, "Failed to create receive buffer pool");
+			goto err_out_net_destroy;
+		}
+
 		nio->epoll_fd = epoll_create(10000);
 		if (nio->epoll_fd < 0) {
 			err = -errno;
 			dnet_log_err(n, "Failed to create epoll fd");
+			dnet_io_buf_pool_destroy(nio->buf_pool);
 			goto err_out_net_destroy;
 		}
 
@@ -1148,6 +1424,7 @@ int dnet_io_init(struct dnet_node *n, struct dnet_config *cfg)
 		err = pthread_create(&nio->tid, NULL, dnet_io_process_network, nio);
 		if (err) {
 			close(nio->epoll_fd);
+			dnet_io_buf_pool_destroy(nio->buf_pool);
 			err = -err;
 			dnet_log(n, DNET_LOG_ERROR, "Failed to create network processing thread: %d", err);
 			goto err_out_net_destroy;
@@ -1161,6 +1438,7 @@ err_out_net_destroy:
 	while (--i >= 0) {
 		pthread_join(n->io->net[i].tid, NULL);
 		close(n->io->net[i].epoll_fd);
+		dnet_io_buf_pool_destroy(n->io->net[i].buf_pool);
 	}
 
 	dnet_work_pool_exit(&n->io->pool.recv_pool_nb);
@@ -1281,6 +1559,9 @@ void dnet_io_cleanup(struct dnet_node *n)
 
 	dnet_io_cleanup_states(n);
 
+	for (i = 0; i < (size_t)io->net_thread_num; ++i)
+		dnet_io_buf_pool_destroy(io->net[i].buf_pool);
+
 	free(io);
 	n->io = NULL;
 }
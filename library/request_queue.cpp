@@ -1,6 +1,8 @@
 #include "request_queue.h"
 #include "monitor/measure_points.h"
 
+#include <algorithm>
+
 
 static size_t dnet_id_hash(const dnet_id &key)
 {
@@ -14,12 +16,12 @@ static size_t dnet_raw_id_hash(const dnet_id &key)
 
 static bool dnet_id_comparator(const dnet_id &lhs, const dnet_id &rhs)
 {
-	return !dnet_id_cmp(&lhs, &rhs);
+	return lhs.group_id == rhs.group_id && dnet_id_equal_raw(lhs.id, rhs.id);
 }
 
 static bool dnet_raw_id_comparator(const dnet_id &lhs, const dnet_id &rhs)
 {
-	return !dnet_id_cmp_str(reinterpret_cast<const unsigned char *>(&lhs.id),
+	return dnet_id_equal_raw(reinterpret_cast<const unsigned char *>(&lhs.id),
 				reinterpret_cast<const unsigned char *>(&rhs.id));
 }
 
@@ -55,14 +57,14 @@ void dnet_request_queue::push_request(dnet_io_req *req)
 	m_queue_wait.notify_one();
 }
 
-dnet_io_req *dnet_request_queue::pop_request(dnet_work_io *wio, const char *thread_stat_id)
+dnet_io_req *dnet_request_queue::pop_request(dnet_work_io *wio)
 {
 	std::unique_lock<std::mutex> lock(m_queue_mutex);
 
-	auto r = take_request(wio, thread_stat_id);
+	auto r = take_request(wio);
 	if (!r) {
 		m_queue_wait.wait_for(lock, std::chrono::seconds(1));
-		r = take_request(wio, thread_stat_id);
+		r = take_request(wio);
 	}
 
 	if (r) {
@@ -73,9 +75,9 @@ dnet_io_req *dnet_request_queue::pop_request(dnet_work_io *wio, const char *thre
 	return r;
 }
 
-dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thread_stat_id)
+dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio)
 {
-	FORMATTED(HANDY_TIMER_SCOPE, ("pool.%s.search_trans_time", thread_stat_id));
+	HANDY_TIMER_SCOPE(wio->pool->stat_names.search_trans_time);
 
 	dnet_work_pool *pool = wio->pool;
 	dnet_io_req *it, *tmp;
@@ -124,7 +126,7 @@ dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thr
 
 		/* This is not a transaction reply, process it right now */
 		if (!(cmd->flags & DNET_FLAGS_REPLY)) {
-			if (cmd->flags & DNET_FLAGS_NOLOCK)
+			if (!dnet_request_locks_key(cmd))
 				return it;
 
 			locked_keys_t::iterator it_lock;
@@ -166,11 +168,11 @@ dnet_io_req *dnet_request_queue::take_request(dnet_work_io *wio, const char *thr
 	return nullptr;
 }
 
-void dnet_request_queue::release_request(const dnet_io_req *req)
+void dnet_request_queue::release_request(dnet_work_io *, const dnet_io_req *req)
 {
 	auto cmd = reinterpret_cast<const dnet_cmd *>(req->header);
 	if (!(cmd->flags & DNET_FLAGS_REPLY) &&
-	    !(cmd->flags & DNET_FLAGS_NOLOCK)) {
+	    dnet_request_locks_key(cmd)) {
 		release_key(&cmd->id);
 	}
 }
@@ -240,51 +242,382 @@ void dnet_request_queue::get_list_stats(list_stat *stats) const
 }
 
 
+dnet_sharded_request_queue::shard::shard(bool has_backend)
+: size(0),
+ locked_keys(1, has_backend ? &dnet_raw_id_hash : &dnet_id_hash,
+	     has_backend ? &dnet_raw_id_comparator : &dnet_id_comparator)
+{
+	INIT_LIST_HEAD(&queue);
+}
+
+dnet_sharded_request_queue::dnet_sharded_request_queue(bool has_backend, int num_threads)
+: m_has_backend(has_backend),
+ m_owned_shards(std::max(num_threads, 1), -1),
+ m_queue_size(0),
+ m_generation(0),
+ m_waiters(0)
+{
+	/*
+	 * Number of shards is a power of two not less than twice the number of pool threads,
+	 * so that threads rarely meet in the same shard.
+	 */
+	size_t shards_count = 1;
+	while (shards_count < m_owned_shards.size() * 2)
+		shards_count <<= 1;
+
+	m_shards_mask = shards_count - 1;
+	m_shards.reserve(shards_count);
+	for (size_t i = 0; i < shards_count; ++i) {
+		m_shards.emplace_back(new shard(has_backend));
+	}
+}
+
+dnet_sharded_request_queue::~dnet_sharded_request_queue()
+{
+	for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+		shard &s = **it;
+
+		for (auto lit = s.lock_pool.begin(); lit != s.lock_pool.end(); ++lit) {
+			delete *lit;
+		}
+
+		struct dnet_io_req *r, *tmp;
+		list_for_each_entry_safe(r, tmp, &s.queue, req_entry) {
+			list_del(&r->req_entry);
+			dnet_io_req_free(r);
+		}
+	}
+}
+
+size_t dnet_sharded_request_queue::key_shard_index(const dnet_id *id) const
+{
+	const size_t hash = m_has_backend ? dnet_raw_id_hash(*id) : dnet_id_hash(*id);
+	return hash & m_shards_mask;
+}
+
+size_t dnet_sharded_request_queue::shard_index(const dnet_io_req *req) const
+{
+	auto cmd = reinterpret_cast<const dnet_cmd *>(req->header);
+
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		return cmd->trans & m_shards_mask;
+
+	return key_shard_index(&cmd->id);
+}
+
+void dnet_sharded_request_queue::push_request(dnet_io_req *req)
+{
+	shard &s = *m_shards[shard_index(req)];
+	{
+		std::unique_lock<std::mutex> lock(s.lock);
+		list_add_tail(&req->req_entry, &s.queue);
+		++s.size;
+	}
+	++m_queue_size;
+
+	notify();
+}
+
+dnet_io_req *dnet_sharded_request_queue::pop_request(dnet_work_io *wio)
+{
+	const unsigned long long generation = m_generation;
+
+	auto r = take_request(wio);
+	if (!r) {
+		wait(generation);
+		r = take_request(wio);
+	}
+
+	if (r)
+		--m_queue_size;
+
+	return r;
+}
+
+dnet_io_req *dnet_sharded_request_queue::take_owned_request(dnet_work_io *wio)
+{
+	struct list_head *list = NULL;
+
+	if (!list_empty(&wio->reply_list))
+		list = &wio->reply_list;
+	else if (!list_empty(&wio->request_list))
+		list = &wio->request_list;
+	else
+		return nullptr;
+
+	auto r = list_first_entry(list, struct dnet_io_req, req_entry);
+	auto cmd = reinterpret_cast<const dnet_cmd *>(r->header);
+	if (cmd->flags & DNET_FLAGS_REPLY)
+		wio->trans = cmd->trans;
+
+	list_del_init(&r->req_entry);
+	return r;
+}
+
+dnet_io_req *dnet_sharded_request_queue::take_request(dnet_work_io *wio)
+{
+	HANDY_TIMER_SCOPE(wio->pool->stat_names.search_trans_time);
+
+	/*
+	 * See comment in dnet_request_queue::take_request() about why current transaction must be reset here.
+	 */
+	wio->trans = ~0ULL;
+
+	/*
+	 * If thread still owns a key or a transaction, then there are pending requests in its lists
+	 * which must be processed before the key or the transaction will be released.
+	 */
+	const ssize_t owned = m_owned_shards[wio->thread_index];
+	if (owned >= 0) {
+		shard &s = *m_shards[owned];
+		std::unique_lock<std::mutex> lock(s.lock);
+		auto r = take_owned_request(wio);
+		if (r)
+			return r;
+	}
+
+	const size_t shards_count = m_shards.size();
+	for (size_t i = 0; i < shards_count; ++i) {
+		const size_t shard_idx = (wio->thread_index + i) & m_shards_mask;
+		if (m_shards[shard_idx]->size == 0)
+			continue;
+
+		auto r = take_shard_request(shard_idx, wio);
+		if (r)
+			return r;
+	}
+
+	return nullptr;
+}
+
+dnet_io_req *dnet_sharded_request_queue::take_shard_request(size_t shard_idx, dnet_work_io *wio)
+{
+	shard &s = *m_shards[shard_idx];
+	dnet_io_req *it, *tmp;
+
+	std::unique_lock<std::mutex> lock(s.lock);
+
+	list_for_each_entry_safe(it, tmp, &s.queue, req_entry) {
+		auto cmd = reinterpret_cast<const dnet_cmd *>(it->header);
+
+		/* This is not a transaction reply, process it right now */
+		if (!(cmd->flags & DNET_FLAGS_REPLY)) {
+			if (!dnet_request_locks_key(cmd)) {
+				list_del_init(&it->req_entry);
+				--s.size;
+				return it;
+			}
+
+			dnet_locked_keys_t::iterator it_lock;
+			bool inserted;
+			std::tie(it_lock, inserted) =
+				s.locked_keys.insert({cmd->id, static_cast<dnet_locks_entry *>(nullptr)});
+			if (inserted) {
+				it_lock->second = take_lock_entry(s, wio);
+				m_owned_shards[wio->thread_index] = shard_idx;
+
+				list_del_init(&it->req_entry);
+				--s.size;
+				return it;
+			}
+
+			dnet_work_io *owner = it_lock->second->owner;
+			/* if key is already locked by other pool thread, then move it to request_list of this thread */
+			if (owner) {
+				list_move_tail(&it->req_entry, &owner->request_list);
+				--s.size;
+			}
+		} else {
+			auto it_trans = s.claimed_trans.find(cmd->trans);
+			if (it_trans != s.claimed_trans.end()) {
+				/* Someone claimed this transaction, it will process the reply */
+				list_move_tail(&it->req_entry, &it_trans->second->reply_list);
+				--s.size;
+				continue;
+			}
+
+			s.claimed_trans.insert({cmd->trans, wio});
+			m_owned_shards[wio->thread_index] = shard_idx;
+			wio->trans = cmd->trans;
+
+			list_del_init(&it->req_entry);
+			--s.size;
+			return it;
+		}
+	}
+
+	return nullptr;
+}
+
+void dnet_sharded_request_queue::release_request(dnet_work_io *wio, const dnet_io_req *req)
+{
+	auto cmd = reinterpret_cast<const dnet_cmd *>(req->header);
+
+	if (cmd->flags & DNET_FLAGS_REPLY) {
+		shard &s = *m_shards[cmd->trans & m_shards_mask];
+		std::unique_lock<std::mutex> lock(s.lock);
+
+		/* Transaction stays claimed until all its queued replies are processed by this thread */
+		if (!list_empty(&wio->reply_list))
+			return;
+
+		s.claimed_trans.erase(cmd->trans);
+		m_owned_shards[wio->thread_index] = -1;
+		return;
+	}
+
+	if (dnet_request_locks_key(cmd))
+		release_key(wio, &cmd->id);
+}
+
+void dnet_sharded_request_queue::lock_key(const dnet_id *id)
+{
+	shard &s = *m_shards[key_shard_index(id)];
+
+	std::unique_lock<std::mutex> lock(s.lock);
+	while (1) {
+		auto it = s.locked_keys.find(*id);
+		if (it == s.locked_keys.end())
+			break;
+
+		auto lock_entry = it->second;
+		lock_entry->unlock_event.wait_for(lock, std::chrono::seconds(1));
+	}
+	auto lock_entry = take_lock_entry(s, nullptr);
+	s.locked_keys.insert(std::make_pair(*id, lock_entry));
+}
+
+void dnet_sharded_request_queue::unlock_key(const dnet_id *id)
+{
+	release_key(nullptr, id);
+	notify();
+}
+
+void dnet_sharded_request_queue::release_key(dnet_work_io *wio, const dnet_id *id)
+{
+	shard &s = *m_shards[key_shard_index(id)];
+
+	std::unique_lock<std::mutex> lock(s.lock);
+	auto it = s.locked_keys.find(*id);
+	if (it == s.locked_keys.end())
+		return;
+
+	auto lock_entry = it->second;
+	const dnet_work_io *owner = lock_entry->owner;
+	/*
+	 * The same as in dnet_request_queue::release_key():
+	 * key locked by pool thread stays locked while there are requests with this key in its request_list.
+	 */
+	if (owner && !list_empty(&owner->request_list))
+		return;
+
+	s.locked_keys.erase(it);
+	put_lock_entry(s, lock_entry);
+	lock_entry->unlock_event.notify_one();
+
+	if (wio && owner == wio)
+		m_owned_shards[wio->thread_index] = -1;
+}
+
+dnet_locks_entry *dnet_sharded_request_queue::take_lock_entry(shard &s, dnet_work_io *wio)
+{
+	if (s.lock_pool.empty()) {
+		auto entry = new(std::nothrow) dnet_locks_entry;
+		s.lock_pool.push_back(entry);
+	}
+	auto entry = s.lock_pool.front();
+	s.lock_pool.pop_front();
+	entry->owner = wio;
+	return entry;
+}
+
+void dnet_sharded_request_queue::put_lock_entry(shard &s, dnet_locks_entry *entry)
+{
+	s.lock_pool.push_back(entry);
+}
+
+void dnet_sharded_request_queue::notify()
+{
+	++m_generation;
+
+	/*
+	 * Both m_generation and m_waiters are sequentially consistent, so either we see the waiter here
+	 * or the waiter sees changed generation and does not go to sleep.
+	 */
+	if (m_waiters != 0) {
+		std::unique_lock<std::mutex> lock(m_wait_mutex);
+		m_wait.notify_one();
+	}
+}
+
+void dnet_sharded_request_queue::wait(unsigned long long generation)
+{
+	std::unique_lock<std::mutex> lock(m_wait_mutex);
+
+	++m_waiters;
+	if (m_generation == generation)
+		m_wait.wait_for(lock, std::chrono::seconds(1));
+	--m_waiters;
+}
+
+void dnet_sharded_request_queue::get_list_stats(list_stat *stats) const
+{
+	stats->list_size = m_queue_size;
+}
+
+
 void dnet_push_request(struct dnet_work_pool *pool, struct dnet_io_req *req)
 {
-	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(pool->request_queue);
 	queue->push_request(req);
 }
 
-struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *thread_stat_id)
+struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio)
 {
 	struct dnet_work_pool *pool = wio->pool;
-	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
-	return queue->pop_request(wio, thread_stat_id);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(pool->request_queue);
+	return queue->pop_request(wio);
 }
 
 void dnet_release_request(struct dnet_work_io *wio, const struct dnet_io_req *req)
 {
-	auto queue = reinterpret_cast<dnet_request_queue*>(wio->pool->request_queue);
-	queue->release_request(req);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(wio->pool->request_queue);
+	queue->release_request(wio, req);
 }
 
 void dnet_oplock(struct dnet_backend_io *backend, const struct dnet_id *id)
 {
 	auto pool = backend->pool.recv_pool.pool;
-	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(pool->request_queue);
 	queue->lock_key(id);
 }
 
 void dnet_opunlock(struct dnet_backend_io *backend, const struct dnet_id *id)
 {
 	auto pool = backend->pool.recv_pool.pool;
-	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(pool->request_queue);
 	queue->unlock_key(id);
 }
 
 void dnet_get_pool_list_stats(struct dnet_work_pool *pool, struct list_stat *stats)
 {
-	auto queue = reinterpret_cast<dnet_request_queue*>(pool->request_queue);
+	auto queue = reinterpret_cast<dnet_request_queue_base*>(pool->request_queue);
 	queue->get_list_stats(stats);
 }
 
-void *dnet_request_queue_create(int has_backend)
+void *dnet_request_queue_create(int has_backend, int sharded, int num_threads)
 {
-	return new(std::nothrow) dnet_request_queue(has_backend != 0);
+	dnet_request_queue_base *queue;
+
+	if (sharded)
+		queue = new(std::nothrow) dnet_sharded_request_queue(has_backend != 0, num_threads);
+	else
+		queue = new(std::nothrow) dnet_request_queue(has_backend != 0);
+
+	return queue;
 }
 
 void dnet_request_queue_destroy(void *queue)
 {
-	delete reinterpret_cast<dnet_request_queue*>(queue);
+	delete reinterpret_cast<dnet_request_queue_base*>(queue);
 }
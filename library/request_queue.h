@@ -7,7 +7,10 @@
 #ifdef __cplusplus
 #include <unordered_map>
 #include <condition_variable>
+#include <list>
+#include <memory>
 #include <mutex>
+#include <vector>
 #if __GNUC__ == 4 && __GNUC_MINOR__ < 5
 #  include <cstdatomic>
 #else
@@ -21,12 +24,50 @@ struct dnet_locks_entry
 	dnet_work_io *owner;
 };
 
+typedef std::unordered_map<dnet_id, dnet_locks_entry *, size_t(*)(const dnet_id&), bool(*)(const dnet_id&, const dnet_id&)> dnet_locked_keys_t;
+
 /*
- * dnet_request_queue is queue of requests with specific key locking semantics: its pop_request()
- * lookups first request with non-locked key in queue, locks this key and returns the request.
+ * dnet_request_queue_base is an interface of queue of requests with specific key locking semantics:
+ * its pop_request() lookups first request with non-locked key in queue, locks this key and returns the request.
  * Also it provides methods for specific key lock/unlock mechanism and provides internal statistics.
  */
-class dnet_request_queue
+class dnet_request_queue_base
+{
+public:
+	virtual ~dnet_request_queue_base() {}
+
+	/*!
+	 * Puts request \a req into queue
+	 */
+	virtual void push_request(dnet_io_req *req) = 0;
+	/*!
+	 * Tries to take first available request with non-locked key and removes it from queue
+	 */
+	virtual dnet_io_req *pop_request(dnet_work_io *wio) = 0;
+	/*!
+	 * Releases request's \a req key (or transaction) previously taken by \a wio
+	 */
+	virtual void release_request(dnet_work_io *wio, const dnet_io_req *req) = 0;
+
+	/*!
+	 * Locks key identified by \a id or waits until key will be unlocked (by calling release_request() or unlock_key())
+	 */
+	virtual void lock_key(const dnet_id *id) = 0;
+	/*!
+	 * Unlocks key identified by \a id and notifies waiting threads
+	 */
+	virtual void unlock_key(const dnet_id *id) = 0;
+
+	/*!
+	 * Returns internal queue statistics
+	 */
+	virtual void get_list_stats(list_stat *stats) const = 0;
+};
+
+/*
+ * dnet_request_queue keeps all requests in the single list protected by one mutex.
+ */
+class dnet_request_queue : public dnet_request_queue_base
 {
 public:
 	/*!
@@ -45,11 +86,11 @@ public:
 	/*!
 	 * Tries to take first available request with non-locked key and removes it from /a m_queue
 	 */
-	dnet_io_req *pop_request(dnet_work_io *wio, const char *thread_stat_id);
+	dnet_io_req *pop_request(dnet_work_io *wio);
 	/*!
 	 * Releases request's /a req key from /a m_locked_keys
 	 */
-	void release_request(const dnet_io_req *req);
+	void release_request(dnet_work_io *wio, const dnet_io_req *req);
 
 	/*!
 	 * Saves key identified by /a id into /a m_locked_keys or waits until key will be unlocked (by calling release_request() or unlock_key())
@@ -70,7 +111,7 @@ private:
 	/*
 	 * Returns first available request with non-locked key from /a m_queue and saves request's key into /a m_locked_keys
 	 */
-	dnet_io_req *take_request(dnet_work_io *wio, const char *thread_stat_id);
+	dnet_io_req *take_request(dnet_work_io *wio);
 	/*!
 	 * Removes key identified by /a id from /a m_locked_keys
 	 */
@@ -91,20 +132,125 @@ private:
 
 	std::atomic_ullong m_queue_size;
 
-	typedef std::unordered_map<dnet_id, dnet_locks_entry *, size_t(*)(const dnet_id&), bool(*)(const dnet_id&, const dnet_id&)> locked_keys_t;
+	typedef dnet_locked_keys_t locked_keys_t;
 	locked_keys_t m_locked_keys;
 	std::list<dnet_locks_entry *> m_lock_pool;
 	std::mutex m_locks_mutex;
 };
 
+/*
+ * dnet_sharded_request_queue splits requests into shards by hash of the key (or transaction number for replies).
+ * Every shard has its own lock, list of requests and table of locked keys and claimed transactions,
+ * so pushing and popping requests with different keys do not contend on the single mutex and
+ * take_request() scans only requests of one shard at a time.
+ *
+ * Per-key serialization is the same as in dnet_request_queue: request with key locked by other pool thread
+ * is moved to request_list of the owner thread, reply for transaction processed by other thread
+ * is moved to reply_list of that thread. Those lists are protected by lock of the shard which the key
+ * (or transaction) belongs to.
+ */
+class dnet_sharded_request_queue : public dnet_request_queue_base
+{
+public:
+	/*!
+	 * Constructor: allocates shards for pool with \a num_threads IO threads
+	 */
+	dnet_sharded_request_queue(bool has_backend, int num_threads);
+	/*!
+	 * Destructor: destroys all requests and lock entries of all shards
+	 */
+	~dnet_sharded_request_queue();
+
+	void push_request(dnet_io_req *req);
+	dnet_io_req *pop_request(dnet_work_io *wio);
+	void release_request(dnet_work_io *wio, const dnet_io_req *req);
+
+	void lock_key(const dnet_id *id);
+	void unlock_key(const dnet_id *id);
+
+	void get_list_stats(list_stat *stats) const;
+
+private:
+	struct shard
+	{
+		shard(bool has_backend);
+
+		std::mutex lock;
+		struct list_head queue;
+		std::atomic_ullong size;
+
+		dnet_locked_keys_t locked_keys;
+		std::unordered_map<uint64_t, dnet_work_io *> claimed_trans;
+		std::list<dnet_locks_entry *> lock_pool;
+	};
+
+	/*!
+	 * Returns index of the shard request \a req belongs to
+	 */
+	size_t shard_index(const dnet_io_req *req) const;
+	/*!
+	 * Returns index of the shard key identified by \a id belongs to
+	 */
+	size_t key_shard_index(const dnet_id *id) const;
+
+	/*!
+	 * Returns first pending request from reply_list or request_list of \a wio
+	 */
+	dnet_io_req *take_owned_request(dnet_work_io *wio);
+	/*!
+	 * Returns first available request from \a shard_idx shard, locks its key or claims its transaction
+	 */
+	dnet_io_req *take_shard_request(size_t shard_idx, dnet_work_io *wio);
+	/*!
+	 * Scans shards starting from the one specific for \a wio and returns first available request
+	 */
+	dnet_io_req *take_request(dnet_work_io *wio);
+
+	/*!
+	 * Removes key identified by \a id from locked keys of its shard
+	 */
+	void release_key(dnet_work_io *wio, const dnet_id *id);
+
+	dnet_locks_entry *take_lock_entry(shard &s, dnet_work_io *wio);
+	void put_lock_entry(shard &s, dnet_locks_entry *entry);
+
+	/*!
+	 * Wakes up one of threads sleeping in pop_request()
+	 */
+	void notify();
+	/*!
+	 * Waits for new requests if nothing was pushed since \a generation
+	 */
+	void wait(unsigned long long generation);
+
+private:
+	const bool m_has_backend;
+	size_t m_shards_mask;
+	std::vector<std::unique_ptr<shard>> m_shards;
+
+	/*
+	 * Index of the shard whose lock protects reply_list and request_list of the pool thread,
+	 * i.e. the shard of the key locked or transaction claimed by the thread, or -1.
+	 * Every element is accessed only by its own thread.
+	 */
+	std::vector<ssize_t> m_owned_shards;
+
+	std::atomic_ullong m_queue_size;
+
+	std::mutex m_wait_mutex;
+	std::condition_variable m_wait;
+	std::atomic_ullong m_generation;
+	std::atomic_int m_waiters;
+};
+
 extern "C" {
 #endif // __cplusplus
 
-void *dnet_request_queue_create(int has_backend);
+void *dnet_request_queue_create(int has_backend, int sharded, int num_threads);
 void dnet_request_queue_destroy(void *queue);
 
 void dnet_push_request(struct dnet_work_pool *pool, struct dnet_io_req *req);
-struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio, const char *thread_stat_id);
+struct dnet_io_req *dnet_pop_request(struct dnet_work_io *wio);
 void dnet_release_request(struct dnet_work_io *wio, const struct dnet_io_req *req);
 
 void dnet_get_pool_list_stats(struct dnet_work_pool *pool, struct list_stat *stats);
@@ -112,6 +258,16 @@ void dnet_get_pool_list_stats(struct dnet_work_pool *pool, struct list_stat *sta
 void dnet_oplock(struct dnet_backend_io *backend, const struct dnet_id *id);
 void dnet_opunlock(struct dnet_backend_io *backend, const struct dnet_id *id);
 
+/*
+ * Whether queue locks key of the request while it is being processed.
+ * BULK_WRITE handler locks every record on its own instead: holding its first key while waiting
+ * for the other ones would deadlock two threads writing overlapping batches in different order.
+ */
+static inline int dnet_request_locks_key(const struct dnet_cmd *cmd)
+{
+	return !(cmd->flags & DNET_FLAGS_NOLOCK) && cmd->cmd != DNET_CMD_BULK_WRITE;
+}
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -146,6 +146,7 @@ static int dnet_cmd_join_client(struct dnet_net_state *st, struct dnet_cmd *cmd,
 			pthread_mutex_lock(&n->state_lock);
 			dnet_idc_destroy_nolock(st);
 			pthread_mutex_unlock(&n->state_lock);
+			dnet_route_table_reclaim(n);
 
 			goto err_out_move_back;
 		}
@@ -279,6 +280,7 @@ int dnet_route_list::disable_backend(size_t backend_id)
 		dnet_pthread_lock_guard guard(m_node->state_lock);
 		dnet_idc_remove_backend_nolock(m_node->st, backend_id);
 	}
+	dnet_route_table_reclaim(m_node);
 
 	dnet_backend_update_cmd cmd;
 	memset(&cmd, 0, sizeof(cmd));
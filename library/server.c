@@ -247,5 +247,6 @@ void dnet_server_node_destroy(struct dnet_node *n)
 	if (n->config_data)
 		n->config_data->destroy_config_data(n->config_data);
 
+	dnet_trans_cache_destroy(n);
 	free(n);
 }
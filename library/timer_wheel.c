@@ -0,0 +1,219 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "timer_wheel.h"
+
+#define DNET_TIMER_WHEEL_MASK		(DNET_TIMER_WHEEL_SLOTS - 1)
+#define DNET_TIMER_WHEEL_MAX_DELTA	((1ULL << (DNET_TIMER_WHEEL_LEVELS * DNET_TIMER_WHEEL_BITS)) - 1)
+
+static inline unsigned int dnet_timer_wheel_shift(int level)
+{
+	return level * DNET_TIMER_WHEEL_BITS;
+}
+
+void dnet_timer_wheel_init(struct dnet_timer_wheel *w, uint64_t now)
+{
+	int level, i;
+
+	for (level = 0; level < DNET_TIMER_WHEEL_LEVELS; ++level) {
+		for (i = 0; i < DNET_TIMER_WHEEL_SLOTS; ++i)
+			INIT_LIST_HEAD(&w->slots[level][i]);
+		w->occupied[level] = 0;
+	}
+
+	INIT_LIST_HEAD(&w->expired);
+	w->next = now + 1;
+	w->size = 0;
+}
+
+static void dnet_timer_wheel_insert(struct dnet_timer_wheel *w, struct dnet_timer_wheel_entry *e)
+{
+	uint64_t deadline = e->deadline;
+	int level = 0, slot;
+
+	if (deadline < w->next) {
+		list_add_tail(&e->entry, &w->expired);
+		return;
+	}
+
+	if (deadline - w->next > DNET_TIMER_WHEEL_MAX_DELTA)
+		deadline = w->next + DNET_TIMER_WHEEL_MAX_DELTA;
+
+	while (level + 1 < DNET_TIMER_WHEEL_LEVELS &&
+			deadline - w->next >= (1ULL << dnet_timer_wheel_shift(level + 1)))
+		++level;
+
+	slot = (deadline >> dnet_timer_wheel_shift(level)) & DNET_TIMER_WHEEL_MASK;
+	list_add_tail(&e->entry, &w->slots[level][slot]);
+	w->occupied[level] |= 1ULL << slot;
+}
+
+void dnet_timer_wheel_schedule(struct dnet_timer_wheel *w, struct dnet_timer_wheel_entry *e, uint64_t deadline)
+{
+	e->deadline = deadline;
+	dnet_timer_wheel_insert(w, e);
+	w->size++;
+}
+
+void dnet_timer_wheel_cancel(struct dnet_timer_wheel *w, struct dnet_timer_wheel_entry *e)
+{
+	if (list_empty(&e->entry))
+		return;
+
+	list_del_init(&e->entry);
+	w->size--;
+}
+
+/* moves entries of the current slot of @level to the lower levels, returns index of the slot */
+static int dnet_timer_wheel_cascade(struct dnet_timer_wheel *w, int level)
+{
+	int slot = (w->next >> dnet_timer_wheel_shift(level)) & DNET_TIMER_WHEEL_MASK;
+	struct dnet_timer_wheel_entry *e, *tmp;
+	LIST_HEAD(entries);
+
+	list_splice_init(&w->slots[level][slot], &entries);
+	w->occupied[level] &= ~(1ULL << slot);
+
+	list_for_each_entry_safe(e, tmp, &entries, entry) {
+		list_del_init(&e->entry);
+		dnet_timer_wheel_insert(w, e);
+	}
+
+	return slot;
+}
+
+static void dnet_timer_wheel_run_tick(struct dnet_timer_wheel *w)
+{
+	int slot = w->next & DNET_TIMER_WHEEL_MASK;
+	int level;
+
+	if (!slot) {
+		for (level = 1; level < DNET_TIMER_WHEEL_LEVELS && !dnet_timer_wheel_cascade(w, level); ++level) {
+		}
+	}
+
+	/* splicing after the last entry appends slot to the tail of expired list */
+	list_splice_init(&w->slots[0][slot], w->expired.prev);
+	w->occupied[0] &= ~(1ULL << slot);
+	w->next++;
+}
+
+static inline uint64_t dnet_timer_wheel_round_up(uint64_t tick, unsigned int shift)
+{
+	return ((tick + (1ULL << shift) - 1) >> shift) << shift;
+}
+
+/* checks whether @tick, which starts slot of @level, cascades any non-empty slot, see dnet_timer_wheel_run_tick() */
+static int dnet_timer_wheel_cascade_due(struct dnet_timer_wheel *w, uint64_t tick, int level)
+{
+	int slot;
+
+	for (; level < DNET_TIMER_WHEEL_LEVELS; ++level) {
+		slot = (tick >> dnet_timer_wheel_shift(level)) & DNET_TIMER_WHEEL_MASK;
+		if (w->occupied[level] & (1ULL << slot))
+			return 1;
+		if (slot)
+			break;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns the first tick starting from @w->next whose slot of the first level has entries
+ * or which cascades non-empty slot of an upper level. Slot of the upper level is cascaded
+ * at the tick which starts it, so upper level is looked at only from the boundary of its slot.
+ */
+static uint64_t dnet_timer_wheel_next_event(struct dnet_timer_wheel *w)
+{
+	uint64_t tick = w->next, bits;
+	unsigned int shift;
+	int level, slot;
+
+	for (level = 0; level < DNET_TIMER_WHEEL_LEVELS; ++level) {
+		shift = dnet_timer_wheel_shift(level);
+		slot = (tick >> shift) & DNET_TIMER_WHEEL_MASK;
+
+		/* the first slot of the level starts slot of the next one, which may be cascaded first */
+		if (!slot && dnet_timer_wheel_cascade_due(w, tick, level + 1))
+			return tick;
+
+		/* slots before the current one belong to the next turn of the level */
+		bits = w->occupied[level] >> slot;
+		if (bits)
+			return tick + ((uint64_t)__builtin_ctzll(bits) << shift);
+
+		tick = dnet_timer_wheel_round_up(tick, shift + DNET_TIMER_WHEEL_BITS);
+		if (w->occupied[level])
+			return tick;
+	}
+
+	return tick;
+}
+
+static struct dnet_timer_wheel_entry *dnet_timer_wheel_pop(struct dnet_timer_wheel *w, struct list_head *list)
+{
+	struct dnet_timer_wheel_entry *e;
+
+	e = list_first_entry(list, struct dnet_timer_wheel_entry, entry);
+	list_del_init(&e->entry);
+	w->size--;
+
+	return e;
+}
+
+struct dnet_timer_wheel_entry *dnet_timer_wheel_pop_expired(struct dnet_timer_wheel *w, uint64_t now)
+{
+	uint64_t tick;
+
+	while (list_empty(&w->expired) && w->next <= now) {
+		/* ticks without entries to expire or cascade are skipped */
+		tick = w->size ? dnet_timer_wheel_next_event(w) : now + 1;
+		if (tick > now) {
+			w->next = now + 1;
+			break;
+		}
+
+		w->next = tick;
+		dnet_timer_wheel_run_tick(w);
+	}
+
+	if (list_empty(&w->expired))
+		return NULL;
+
+	return dnet_timer_wheel_pop(w, &w->expired);
+}
+
+struct dnet_timer_wheel_entry *dnet_timer_wheel_pop_any(struct dnet_timer_wheel *w)
+{
+	int level, i;
+
+	if (!w->size)
+		return NULL;
+
+	if (!list_empty(&w->expired))
+		return dnet_timer_wheel_pop(w, &w->expired);
+
+	for (level = 0; level < DNET_TIMER_WHEEL_LEVELS; ++level) {
+		for (i = 0; i < DNET_TIMER_WHEEL_SLOTS; ++i) {
+			if (!list_empty(&w->slots[level][i]))
+				return dnet_timer_wheel_pop(w, &w->slots[level][i]);
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_TIMER_WHEEL_H
+#define __DNET_TIMER_WHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "elliptics/core.h"
+#include "list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hierarchical timing wheel of entries scheduled at absolute ticks (milliseconds).
+ *
+ * Every level has 64 slots, slot of the first level covers one tick and slot of every next level
+ * covers the whole previous level: 64 ms, 4 s, 4.5 min and 4.6 hours. When the first level wraps around,
+ * slot of the next level is cascaded down, so every entry is moved at most once per level.
+ * Deadlines which do not fit into the last level are clamped to its end and are rescheduled
+ * when they are cascaded.
+ *
+ * Scheduling and cancelling are O(1), expired entries are returned in order of ticks.
+ * Every level keeps bitmap of its non-empty slots, so time moves straight to the next slot
+ * which has to be expired or cascaded instead of stepping through empty ticks.
+ * Wheel is not synchronized, its owner protects it by its own lock.
+ */
+#define DNET_TIMER_WHEEL_LEVELS		4
+#define DNET_TIMER_WHEEL_BITS		6
+#define DNET_TIMER_WHEEL_SLOTS		(1 << DNET_TIMER_WHEEL_BITS)
+
+struct dnet_timer_wheel_entry {
+	/* empty if entry is not scheduled */
+	struct list_head	entry;
+	uint64_t		deadline;
+};
+
+struct dnet_timer_wheel {
+	struct list_head	slots[DNET_TIMER_WHEEL_LEVELS][DNET_TIMER_WHEEL_SLOTS];
+	/* bit is set when entry is added into the slot, cancelled entries leave it set until slot is processed */
+	uint64_t		occupied[DNET_TIMER_WHEEL_LEVELS];
+	struct list_head	expired;
+	/* the first tick which is not processed yet */
+	uint64_t		next;
+	size_t			size;
+};
+
+static inline uint64_t dnet_timer_wheel_tick(const struct timeval *tv)
+{
+	return (uint64_t)tv->tv_sec * 1000 + tv->tv_usec / 1000;
+}
+
+static inline void dnet_timer_wheel_entry_init(struct dnet_timer_wheel_entry *e)
+{
+	INIT_LIST_HEAD(&e->entry);
+	e->deadline = 0;
+}
+
+static inline int dnet_timer_wheel_entry_scheduled(const struct dnet_timer_wheel_entry *e)
+{
+	return !list_empty(&e->entry);
+}
+
+void dnet_timer_wheel_init(struct dnet_timer_wheel *w, uint64_t now);
+
+/* schedules @e at @deadline, entry must not be scheduled */
+void dnet_timer_wheel_schedule(struct dnet_timer_wheel *w, struct dnet_timer_wheel_entry *e, uint64_t deadline);
+
+/* it is safe to cancel entry which is not scheduled */
+void dnet_timer_wheel_cancel(struct dnet_timer_wheel *w, struct dnet_timer_wheel_entry *e);
+
+/*
+ * Returns entry whose deadline is not later than @now and removes it from the wheel,
+ * returns NULL if there are no such entries.
+ */
+struct dnet_timer_wheel_entry *dnet_timer_wheel_pop_expired(struct dnet_timer_wheel *w, uint64_t now);
+
+/* returns any scheduled entry regardless of its deadline and removes it from the wheel */
+struct dnet_timer_wheel_entry *dnet_timer_wheel_pop_any(struct dnet_timer_wheel *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_TIMER_WHEEL_H */
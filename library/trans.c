@@ -30,34 +30,55 @@
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
 
-/*
- * Ascending transaction order
- */
-static inline int dnet_trans_cmp(uint64_t t2, uint64_t t1)
+/* number of expired transactions taken from the timer wheel of the state per lock hold */
+#define DNET_TRANS_TIMEOUT_BATCH	64
+
+static int dnet_trans_table_resize(struct dnet_trans_table *table, size_t size)
 {
-	if (t1 > t2)
-		return 1;
-	if (t1 < t2)
-		return -1;
+	struct dnet_trans **slots;
+	size_t i, pos, mask = size - 1;
+
+	slots = calloc(size, sizeof(struct dnet_trans *));
+	if (!slots)
+		return -ENOMEM;
+
+	for (i = 0; table->slots && i <= table->mask; ++i) {
+		struct dnet_trans *t = table->slots[i];
+
+		if (!t)
+			continue;
+
+		for (pos = dnet_trans_hash(t->trans, mask); slots[pos]; pos = (pos + 1) & mask) {
+		}
+
+		slots[pos] = t;
+	}
+
+	free(table->slots);
+	table->slots = slots;
+	table->mask = mask;
 	return 0;
 }
 
+void dnet_trans_table_destroy(struct dnet_trans_table *table)
+{
+	free(table->slots);
+	table->slots = NULL;
+	table->mask = 0;
+	table->size = 0;
+}
+
 struct dnet_trans *dnet_trans_search(struct dnet_net_state *st, uint64_t trans)
 {
-	struct rb_root *root = &st->trans_root;
-	struct rb_node *n = root->rb_node;
-	struct dnet_trans *t = NULL;
-	int cmp = 1;
+	struct dnet_trans_table *table = &st->trans_table;
+	struct dnet_trans *t;
+	size_t pos;
 
-	while (n) {
-		t = rb_entry(n, struct dnet_trans, trans_entry);
+	if (!table->size)
+		return NULL;
 
-		cmp = dnet_trans_cmp(t->trans, trans);
-		if (cmp < 0)
-			n = n->rb_left;
-		else if (cmp > 0)
-			n = n->rb_right;
-		else
+	for (pos = dnet_trans_hash(trans, table->mask); (t = table->slots[pos]); pos = (pos + 1) & table->mask) {
+		if (t->trans == trans)
 			return dnet_trans_get(t);
 	}
 
@@ -66,22 +87,19 @@ struct dnet_trans *dnet_trans_search(struct dnet_net_state *st, uint64_t trans)
 
 int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a)
 {
-	struct rb_root *root = &st->trans_root;
-	struct rb_node **n = &root->rb_node, *parent = NULL;
+	struct dnet_trans_table *table = &st->trans_table;
 	struct dnet_trans *t;
-	int cmp;
-
-	while (*n) {
-		parent = *n;
+	size_t pos;
+	int err;
 
-		t = rb_entry(parent, struct dnet_trans, trans_entry);
+	if (!table->slots || (table->size + 1) * 2 > table->mask + 1) {
+		err = dnet_trans_table_resize(table, table->slots ? (table->mask + 1) * 2 : DNET_TRANS_TABLE_MIN_SIZE);
+		if (err)
+			return err;
+	}
 
-		cmp = dnet_trans_cmp(t->trans, a->trans);
-		if (cmp < 0)
-			n = &parent->rb_left;
-		else if (cmp > 0)
-			n = &parent->rb_right;
-		else
+	for (pos = dnet_trans_hash(a->trans, table->mask); (t = table->slots[pos]); pos = (pos + 1) & table->mask) {
+		if (t->trans == a->trans)
 			return -EEXIST;
 	}
 
@@ -90,112 +108,100 @@ int dnet_trans_insert_nolock(struct dnet_net_state *st, struct dnet_trans *a)
 			dnet_dump_id(&a->cmd.id), dnet_cmd_string(a->cmd.cmd), (unsigned long long)a->trans,
 			dnet_addr_string(&a->st->addr), a->cmd.backend_id);
 
-	rb_link_node(&a->trans_entry, parent, n);
-	rb_insert_color(&a->trans_entry, root);
+	table->slots[pos] = a;
+	table->size++;
+	a->hashed = 1;
 	return 0;
 }
 
-/**
- * Timer functinos are used for timeout check.
- * We insert transaction into timer tree ordered/indexed by time-to-timeout-death.
- *
- * Checking thread periodically looks at the begining of the timer tree and kills
- * those transactions which are past the deadline. When transaction reply has been
- * received transaction is removed from the timer tree, its time-to-timeout-death
- * is updated and transaction inserted into the timer tree again.
- *
- * It is possible, that multiple transaction were created at the same time with
- * the same time-to-timeout-death, in this case we compare them additionaly using
- * transaction number, which is unique for node.
- *
- * This particular trans2,trans1 order of arguments is very significant - argument order plus
- * the way they are compared below ends up with ascending timeout order, i.e. the smaller
- * timeout (the closer death-time) the closer transaction is to the begining of the timer tree
- * (do not confuse it with the tree root).
+/*
+ * Removes transaction from the table and shifts the following entries of its probe run back,
+ * every entry is moved into the hole unless its home slot lies cyclically between the hole and the entry.
  */
-static inline int dnet_trans_cmp_timer(struct dnet_trans *trans2, struct dnet_trans *trans1)
+static void dnet_trans_table_remove(struct dnet_trans_table *table, struct dnet_trans *t)
 {
-	struct timeval *t1 = &trans1->time;
-	struct timeval *t2 = &trans2->time;
+	size_t hole, pos, home;
 
-	if (t1->tv_sec > t2->tv_sec)
-		return 1;
-	if (t1->tv_sec < t2->tv_sec)
-		return -1;
-	if (t1->tv_usec > t2->tv_usec)
-		return 1;
-	if (t1->tv_usec < t2->tv_usec)
-		return -1;
+	for (hole = dnet_trans_hash(t->trans, table->mask); table->slots[hole] != t; hole = (hole + 1) & table->mask) {
+	}
 
-	return dnet_trans_cmp(trans2->trans, trans1->trans);
+	for (pos = (hole + 1) & table->mask; table->slots[pos]; pos = (pos + 1) & table->mask) {
+		home = dnet_trans_hash(table->slots[pos]->trans, table->mask);
+
+		if (((pos - home) & table->mask) >= ((pos - hole) & table->mask)) {
+			table->slots[hole] = table->slots[pos];
+			hole = pos;
+		}
+	}
+
+	table->slots[hole] = NULL;
+	table->size--;
+
+	/* failed shrink leaves table as it is */
+	if (table->mask + 1 > DNET_TRANS_TABLE_MIN_SIZE && table->size * 8 < table->mask + 1)
+		dnet_trans_table_resize(table, (table->mask + 1) / 2);
 }
 
-struct dnet_trans *dnet_trans_search_timer(struct dnet_net_state *st, struct dnet_trans *trans)
+struct dnet_trans *dnet_trans_first_nolock(struct dnet_net_state *st, size_t *pos)
 {
-	struct rb_root *root = &st->timer_root;
-	struct rb_node *n = root->rb_node;
-	struct dnet_trans *t = NULL;
-	int cmp = 1;
+	struct dnet_trans_table *table = &st->trans_table;
+	size_t i, idx;
 
-	while (n) {
-		t = rb_entry(n, struct dnet_trans, timer_entry);
+	if (!table->size)
+		return NULL;
 
-		cmp = dnet_trans_cmp_timer(t, trans);
-		if (cmp < 0)
-			n = n->rb_left;
-		else if (cmp > 0)
-			n = n->rb_right;
-		else
-			return dnet_trans_get(t);
+	for (i = 0; i <= table->mask; ++i) {
+		idx = (*pos + i) & table->mask;
+
+		if (table->slots[idx]) {
+			*pos = idx;
+			return table->slots[idx];
+		}
 	}
 
 	return NULL;
 }
 
+/**
+ * Timer functions are used for timeout check.
+ * We schedule transaction in the state's timer wheel at its time-to-timeout-death,
+ * rounded up to milliseconds, so transaction never expires before its deadline.
+ *
+ * Checking thread periodically takes those transactions from the wheel which are past
+ * the deadline and kills them. When transaction reply has been received transaction is removed
+ * from the timer wheel, its time-to-timeout-death is updated and transaction is scheduled again.
+ * Both scheduling and removal are O(1) regardless of number of transactions in flight.
+ */
 int dnet_trans_insert_timer_nolock(struct dnet_net_state *st, struct dnet_trans *a)
 {
-	struct rb_root *root = &st->timer_root;
-	struct rb_node **n = &root->rb_node, *parent = NULL;
-	struct dnet_trans *t;
-	int cmp;
+	uint64_t deadline;
 
-	while (*n) {
-		parent = *n;
+	if (dnet_timer_wheel_entry_scheduled(&a->timer_entry))
+		return -EEXIST;
 
-		t = rb_entry(parent, struct dnet_trans, timer_entry);
+	deadline = dnet_timer_wheel_tick(&a->time);
+	if (a->time.tv_usec % 1000)
+		deadline++;
 
-		cmp = dnet_trans_cmp_timer(t, a);
-		if (cmp < 0)
-			n = &parent->rb_left;
-		else if (cmp > 0)
-			n = &parent->rb_right;
-		else
-			return -EEXIST;
-	}
-
-	rb_link_node(&a->timer_entry, parent, n);
-	rb_insert_color(&a->timer_entry, root);
+	dnet_timer_wheel_schedule(&st->timer_wheel, &a->timer_entry, deadline);
 	return 0;
 }
 
 void dnet_trans_remove_timer_nolock(struct dnet_net_state *st, struct dnet_trans *t)
 {
-	if (t->timer_entry.rb_parent_color) {
-		rb_erase(&t->timer_entry, &st->timer_root);
-		t->timer_entry.rb_parent_color = 0;
-	}
+	dnet_timer_wheel_cancel(&st->timer_wheel, &t->timer_entry);
 }
 
 void dnet_trans_remove_nolock(struct dnet_net_state *st, struct dnet_trans *t)
 {
-	if (!t->trans_entry.rb_parent_color) {
-		dnet_log(st->n, DNET_LOG_ERROR, "%s: trying to remove out-of-trans-tree transaction %llu.",
+	if (!t->hashed) {
+		dnet_log(st->n, DNET_LOG_ERROR, "%s: trying to remove out-of-trans-table transaction %llu.",
 			dnet_dump_id(&t->cmd.id), (unsigned long long)t->trans);
 		return;
 	}
 
-	rb_erase(&t->trans_entry, &st->trans_root);
-	t->trans_entry.rb_parent_color = 0;
+	dnet_trans_table_remove(&st->trans_table, t);
+	t->hashed = 0;
 
 	dnet_trans_remove_timer_nolock(st, t);
 }
@@ -211,11 +217,137 @@ void dnet_trans_remove(struct dnet_trans *t)
 	pthread_mutex_unlock(&st->trans_lock);
 }
 
+int dnet_trans_cache_init(struct dnet_node *n)
+{
+	struct dnet_trans_cache *cache;
+	int i, j, err;
+
+	for (i = 0; i < DNET_TRANS_CACHES; ++i) {
+		cache = &n->trans_cache[i];
+
+		err = pthread_mutex_init(&cache->lock, NULL);
+		if (err) {
+			err = -err;
+			goto err_out_destroy;
+		}
+
+		cache->need_exit = 0;
+		for (j = 0; j < DNET_TRANS_CLASSES; ++j) {
+			INIT_LIST_HEAD(&cache->free_list[j]);
+			cache->free_num[j] = 0;
+		}
+	}
+
+	return 0;
+
+err_out_destroy:
+	while (--i >= 0)
+		pthread_mutex_destroy(&n->trans_cache[i].lock);
+	return err;
+}
+
+/*
+ * Frees cached transactions, transactions which are destroyed after this call are freed to heap.
+ * Locks are not destroyed since such transactions still take them.
+ */
+void dnet_trans_cache_cleanup(struct dnet_node *n)
+{
+	struct dnet_trans_cache *cache;
+	struct dnet_trans *t, *tmp;
+	int i, j;
+
+	for (i = 0; i < DNET_TRANS_CACHES; ++i) {
+		cache = &n->trans_cache[i];
+
+		pthread_mutex_lock(&cache->lock);
+		cache->need_exit = 1;
+		for (j = 0; j < DNET_TRANS_CLASSES; ++j) {
+			list_for_each_entry_safe(t, tmp, &cache->free_list[j], trans_list_entry) {
+				list_del(&t->trans_list_entry);
+				free(t);
+			}
+			cache->free_num[j] = 0;
+		}
+		pthread_mutex_unlock(&cache->lock);
+	}
+}
+
+/*
+ * Destroys cache locks, it is called right before node is freed, when no transaction is left.
+ */
+void dnet_trans_cache_destroy(struct dnet_node *n)
+{
+	int i;
+
+	for (i = 0; i < DNET_TRANS_CACHES; ++i)
+		pthread_mutex_destroy(&n->trans_cache[i].lock);
+}
+
+static struct dnet_trans_cache *dnet_trans_thread_cache(struct dnet_node *n)
+{
+	uint64_t self = (uint64_t)pthread_self();
+
+	return &n->trans_cache[((self * 0x9e3779b97f4a7c15ULL) >> 32) % DNET_TRANS_CACHES];
+}
+
+static struct dnet_trans *dnet_trans_mem_alloc(struct dnet_node *n, size_t size)
+{
+	struct dnet_trans_cache *cache;
+	struct dnet_trans *t = NULL;
+	int cls = 0;
+
+	while (cls < DNET_TRANS_CLASSES && size > (1UL << (DNET_TRANS_MIN_SHIFT + cls)))
+		++cls;
+
+	if (cls == DNET_TRANS_CLASSES)
+		return calloc(1, size);
+
+	cache = dnet_trans_thread_cache(n);
+
+	pthread_mutex_lock(&cache->lock);
+	if (!list_empty(&cache->free_list[cls])) {
+		t = list_first_entry(&cache->free_list[cls], struct dnet_trans, trans_list_entry);
+		list_del(&t->trans_list_entry);
+		cache->free_num[cls]--;
+	}
+	pthread_mutex_unlock(&cache->lock);
+
+	if (!t) {
+		t = malloc(1UL << (DNET_TRANS_MIN_SHIFT + cls));
+		if (!t)
+			return NULL;
+	}
+
+	memset(t, 0, size);
+	t->cache = cache;
+	t->cache_class = cls;
+	return t;
+}
+
+static void dnet_trans_mem_free(struct dnet_trans *t)
+{
+	struct dnet_trans_cache *cache = t->cache;
+	int cls = t->cache_class;
+
+	if (cache) {
+		pthread_mutex_lock(&cache->lock);
+		if (!cache->need_exit &&
+				cache->free_num[cls] < (DNET_TRANS_CACHE_SIZE >> (DNET_TRANS_MIN_SHIFT + cls))) {
+			list_add(&t->trans_list_entry, &cache->free_list[cls]);
+			cache->free_num[cls]++;
+			t = NULL;
+		}
+		pthread_mutex_unlock(&cache->lock);
+	}
+
+	free(t);
+}
+
 struct dnet_trans *dnet_trans_alloc(struct dnet_node *n, uint64_t size)
 {
 	struct dnet_trans *t;
 
-	t = calloc(1, sizeof(struct dnet_trans) + size);
+	t = dnet_trans_mem_alloc(n, sizeof(struct dnet_trans) + size);
 	if (!t)
 		goto err_out_exit;
 
@@ -225,6 +357,7 @@ struct dnet_trans *dnet_trans_alloc(struct dnet_node *n, uint64_t size)
 
 	atomic_init(&t->refcnt, 1);
 	INIT_LIST_HEAD(&t->trans_list_entry);
+	dnet_timer_wheel_entry_init(&t->timer_entry);
 
 	gettimeofday(&t->start, NULL);
 
@@ -254,7 +387,7 @@ void dnet_trans_destroy(struct dnet_trans *t)
 		pthread_mutex_lock(&st->trans_lock);
 		list_del_init(&t->trans_list_entry);
 
-		if (t->trans_entry.rb_parent_color) {
+		if (t->hashed) {
 			dnet_trans_remove_nolock(st, t);
 		}
 
@@ -312,7 +445,7 @@ void dnet_trans_destroy(struct dnet_trans *t)
 	dnet_state_put(t->orig);
 
 	dnet_node_unset_trace_id();
-	free(t);
+	dnet_trans_mem_free(t);
 }
 
 static void dnet_trans_control_fill_cmd(struct dnet_session *s, const struct dnet_trans_control *ctl, struct dnet_cmd *cmd)
@@ -505,91 +638,87 @@ void dnet_update_stall_backend_weights(struct list_head *stall_transactions)
 	}
 }
 
+/*
+ * Moves transactions whose deadline has passed into @head, all transactions are moved if state is being reset.
+ *
+ * Transactions are taken from the timer wheel by batches, lock is released after every batch
+ * to give IO threads a chance to process other transactions without being stalled for too long
+ * waiting for this checking thread to complete.
+ */
 int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_head *head)
 {
+	struct dnet_timer_wheel_entry *entry;
 	struct dnet_trans *t;
-	struct rb_node *rb_node;
 	struct timeval tv;
+	uint64_t now;
 	int trans_moved = 0;
+	int batch;
 	char str[64];
 	struct tm tm;
 
 	gettimeofday(&tv, NULL);
+	now = dnet_timer_wheel_tick(&tv);
 
-	while (1) {
-		/* lock is being locked/unlocked to get a chance for IO thread to process other transactions
-		 * without being stalled for too long waiting for this checking thread to complete
-		 */
+	do {
 		pthread_mutex_lock(&st->trans_lock);
 
-		t = NULL;
-		rb_node = rb_first(&st->timer_root);
-		if (!rb_node) {
-			pthread_mutex_unlock(&st->trans_lock);
-			break;
-		}
+		for (batch = 0; batch < DNET_TRANS_TIMEOUT_BATCH; ++batch) {
+			if (st->__need_exit)
+				entry = dnet_timer_wheel_pop_any(&st->timer_wheel);
+			else
+				entry = dnet_timer_wheel_pop_expired(&st->timer_wheel, now);
 
-		t = rb_entry(rb_node, struct dnet_trans, timer_entry);
-		if (!st->__need_exit) {
-			int has_timeouted;
-			if (t->time.tv_sec < tv.tv_sec) {
-				has_timeouted = 1;
-			} else if (t->time.tv_sec == tv.tv_sec) {
-				has_timeouted = (t->time.tv_usec <= tv.tv_usec);
-			} else {
-				has_timeouted = 0;
-			}
-			if (!has_timeouted) {
-				pthread_mutex_unlock(&st->trans_lock);
+			if (!entry)
 				break;
-			}
-		}
 
-		localtime_r((time_t *)&t->start.tv_sec, &tm);
-		strftime(str, sizeof(str), "%F %R:%S", &tm);
+			t = container_of(entry, struct dnet_trans, timer_entry);
+
+			localtime_r((time_t *)&t->start.tv_sec, &tm);
+			strftime(str, sizeof(str), "%F %R:%S", &tm);
 
-		// TODO: We may use dnet_log_record_set_request_id here,
-		// but blackhole currently has higher priority for scoped attributes =(
-		dnet_node_set_trace_id(st->n->log, t->cmd.trace_id, t->cmd.flags & DNET_FLAGS_TRACE_BIT, -1);
-
-		dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit %s, "
-				"need-exit: %d, started: %s.%06lu",
-				dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
-				dnet_print_trans(t),
-				st->__need_exit,
-				str, t->start.tv_usec);
-
-		trans_moved++;
-
-		/*
-		 * Remove transaction from every tree/list, so it could not be accessed and found while we deal with it.
-		 * In particular, we will call ->complete() callback, which must ensure that no other thread calls it.
-		 *
-		 * Memory allocation for every transaction is handled by reference counters, but callbacks must ensure,
-		 * that no calls are made after 'final' callback has been invoked. 'Final' means is_trans_destroyed() returns true.
-		 *
-		 * We can not destroy transaction right here since route table is locked above this function and transaction
-		 * destruction can lead to state destruction which in turn may kill state and remove it from route table,
-		 * which will deadlock.
-		 */
-		dnet_trans_remove_nolock(st, t);
-
-		if (!list_empty(&t->trans_list_entry)) {
-			list_del(&t->trans_list_entry);
-			dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit: stall %s, "
-					"it was moved into some timeout list, but yet it exists in timer tree, "
+			// TODO: We may use dnet_log_record_set_request_id here,
+			// but blackhole currently has higher priority for scoped attributes =(
+			dnet_node_set_trace_id(st->n->log, t->cmd.trace_id, t->cmd.flags & DNET_FLAGS_TRACE_BIT, -1);
+
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit %s, "
 					"need-exit: %d, started: %s.%06lu",
 					dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
 					dnet_print_trans(t),
 					st->__need_exit,
 					str, t->start.tv_usec);
-		}
 
-		list_add_tail(&t->trans_list_entry, head);
-		dnet_node_unset_trace_id();
+			trans_moved++;
+
+			/*
+			 * Remove transaction from the trans table, timer wheel and lists, so it could not be accessed and found while we deal with it.
+			 * In particular, we will call ->complete() callback, which must ensure that no other thread calls it.
+			 *
+			 * Memory allocation for every transaction is handled by reference counters, but callbacks must ensure,
+			 * that no calls are made after 'final' callback has been invoked. 'Final' means is_trans_destroyed() returns true.
+			 *
+			 * We can not destroy transaction right here since route table is locked above this function and transaction
+			 * destruction can lead to state destruction which in turn may kill state and remove it from route table,
+			 * which will deadlock.
+			 */
+			dnet_trans_remove_nolock(st, t);
+
+			if (!list_empty(&t->trans_list_entry)) {
+				list_del(&t->trans_list_entry);
+				dnet_log(st->n, DNET_LOG_ERROR, "%s: %s: TIMEOUT/need-exit: stall %s, "
+						"it was moved into some timeout list, but yet it exists in timer wheel, "
+						"need-exit: %d, started: %s.%06lu",
+						dnet_dump_id(&t->cmd.id), dnet_cmd_string(t->cmd.cmd),
+						dnet_print_trans(t),
+						st->__need_exit,
+						str, t->start.tv_usec);
+			}
+
+			list_add_tail(&t->trans_list_entry, head);
+			dnet_node_unset_trace_id();
+		}
 
 		pthread_mutex_unlock(&st->trans_lock);
-	}
+	} while (batch == DNET_TRANS_TIMEOUT_BATCH);
 
 	return trans_moved;
 }
@@ -679,54 +808,79 @@ static int dnet_trans_check_stall(struct dnet_net_state *st, struct list_head *h
 	return is_stall_state;
 }
 
+/*
+ * States are only referenced under @state_lock, their timer wheels are checked after it is released,
+ * so timeouts of many transactions do not block route table and connection handling.
+ */
 static void dnet_check_all_states(struct dnet_node *n)
 {
 	struct dnet_net_state *st, *tmp;
 	int i, err;
 	int num_stall_state = 0;
 	int max_state_count = 0;
-	struct dnet_net_state **stall_states = NULL;
+	struct dnet_net_state **states = NULL;
 	LIST_HEAD(head);
 
 	pthread_mutex_lock(&n->state_lock);
-	/*
-	 * It isn't possible to send a ping transaction while checking stall transactions within dnet_trans_check_stall(),
-	 * because it may invoke callback directly, where dnet_state_reset() is called that will deadlock on state_lock mutex.
-	 */
 	list_for_each_entry_safe(st, tmp, &n->dht_state_list, node_entry) {
 		++max_state_count;
 	}
+	/* lanes are not in the route table, but their transactions time out as well */
+	list_for_each_entry_safe(st, tmp, &n->empty_state_list, node_entry) {
+		if (st->primary)
+			++max_state_count;
+	}
 
 	if (max_state_count > 0) {
-		stall_states = malloc(max_state_count * sizeof(struct dnet_net_state *));
-		if (!stall_states) {
-			dnet_log(n, DNET_LOG_ERROR, "dnet_check_all_states: malloc failed for stall_states: %d", max_state_count);
+		states = malloc(max_state_count * sizeof(struct dnet_net_state *));
+		if (!states) {
+			dnet_log(n, DNET_LOG_ERROR, "dnet_check_all_states: malloc failed for states: %d", max_state_count);
 			pthread_mutex_unlock(&n->state_lock);
 			return;
 		}
 	}
 
+	i = 0;
 	list_for_each_entry_safe(st, tmp, &n->dht_state_list, node_entry) {
+		states[i++] = dnet_state_get(st);
+	}
+	list_for_each_entry_safe(st, tmp, &n->empty_state_list, node_entry) {
+		/* lane could have been attached to its primary state after it was counted */
+		if (st->primary && i < max_state_count)
+			states[i++] = dnet_state_get(st);
+	}
+	max_state_count = i;
+	pthread_mutex_unlock(&n->state_lock);
+
+	/*
+	 * It isn't possible to send a ping transaction while checking stall transactions within dnet_trans_check_stall(),
+	 * because it may invoke callback directly, where dnet_state_reset() is called, so stall states are
+	 * gathered at the beginning of @states and pinged after all states are checked.
+	 */
+	for (i = 0; i < max_state_count; ++i) {
+		st = states[i];
 		if (dnet_trans_check_stall(st, &head)) {
-			dnet_state_get(st);
-			stall_states[num_stall_state++] = st;
+			states[i] = states[num_stall_state];
+			states[num_stall_state++] = st;
 		}
 	}
-	pthread_mutex_unlock(&n->state_lock);
 
 	dnet_update_stall_backend_weights(&head);
 
 	for (i = 0; i < num_stall_state; ++i) {
-		st = stall_states[i];
+		st = states[i];
 		st->stall = 0;
 		err = dnet_ping_stall_node(st);
 		if (err)
 			dnet_log(st->n, DNET_LOG_ERROR, "dnet_ping_stall_node failed: %s [%d]", strerror(-err), err);
-		dnet_state_put(st);
 	}
 
 	dnet_trans_clean_list(&head, -ETIMEDOUT);
-	free(stall_states);
+
+	for (i = 0; i < max_state_count; ++i) {
+		dnet_state_put(states[i]);
+	}
+	free(states);
 }
 
 static void *dnet_reconnect_process(void *data)
@@ -748,6 +902,7 @@ static void *dnet_reconnect_process(void *data)
 
 		dnet_log(n, DNET_LOG_INFO, "Started reconnection process");
 		dnet_reconnect_and_check_route_table(n);
+		dnet_reconnect_lanes(n);
 		dnet_log(n, DNET_LOG_INFO, "Finished reconnection process");
 
 		gettimeofday(&tv2, NULL);
@@ -759,6 +914,13 @@ static void *dnet_reconnect_process(void *data)
 				break;
 
 			sleep(1);
+
+			dnet_route_table_check(n);
+
+			if (atomic_read(&n->lanes_pending)) {
+				atomic_set(&n->lanes_pending, 0);
+				dnet_reconnect_lanes(n);
+			}
 		}
 	}
 
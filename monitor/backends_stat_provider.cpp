@@ -84,6 +84,19 @@ static void fill_backend_io(rapidjson::Value &stat_value,
 	dump_list_stats(nonblocking_stat, stats, allocator);
 	io_value.AddMember("nonblocking", nonblocking_stat, allocator);
 
+	if (backend.cb && backend.cb->read_queue_stat) {
+		struct dnet_backend_read_queue_stat read_stats;
+		backend.cb->read_queue_stat(backend.cb->command_private, &read_stats);
+
+		rapidjson::Value read_queue_stat(rapidjson::kObjectType);
+		read_queue_stat.AddMember("queue_depth", read_stats.queue_depth, allocator);
+		read_queue_stat.AddMember("threads", read_stats.threads, allocator);
+		read_queue_stat.AddMember("in_flight", read_stats.in_flight, allocator);
+		read_queue_stat.AddMember("completed", read_stats.completed, allocator);
+		read_queue_stat.AddMember("queue_full", read_stats.queue_full, allocator);
+		io_value.AddMember("read_queue", read_queue_stat, allocator);
+	}
+
 	stat_value.AddMember("io", io_value, allocator);
 }
 
@@ -129,6 +142,18 @@ static void fill_backend_status(rapidjson::Value &stat_value,
 	status_value.AddMember("read_only", status.read_only == 1, allocator);
 	status_value.AddMember("delay", status.delay, allocator);
 
+	if (status.state == DNET_BACKEND_ENABLED && node->io && node->io->backends[backend_id].cache) {
+		const ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager *)node->io->backends[backend_id].cache;
+		const ioremap::cache::snapshot_stats &restore_stats = cache->restore_stats();
+
+		rapidjson::Value cache_restore(rapidjson::kObjectType);
+		cache_restore.AddMember("objects", restore_stats.restored_objects, allocator);
+		cache_restore.AddMember("size", restore_stats.restored_size, allocator);
+		cache_restore.AddMember("skipped_objects", restore_stats.skipped_objects, allocator);
+		cache_restore.AddMember("time", static_cast<int64_t>(restore_stats.restore_time), allocator);
+		status_value.AddMember("cache_restore", cache_restore, allocator);
+	}
+
 	stat_value.AddMember("status", status_value, allocator);
 }
 
@@ -25,6 +25,8 @@
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
+#include <string>
+
 namespace ioremap { namespace monitor {
 
 void dump_list_stats(rapidjson::Value &stat, list_stat &list_stats, rapidjson::Document::AllocatorType &allocator) {
@@ -38,12 +40,20 @@ void dump_states_stats(rapidjson::Value &stat, struct dnet_node *n, rapidjson::D
 	list_for_each_entry(st, &n->empty_state_list, node_entry) {
 		rapidjson::Value state_value(rapidjson::kObjectType);
 		state_value.AddMember("send_queue_size", (uint64_t)atomic_read(&st->send_queue_size), allocator)
+		           .AddMember("send_syscalls", (uint64_t)atomic_read(&st->send_syscalls), allocator)
+		           .AddMember("send_requests", (uint64_t)atomic_read(&st->send_requests), allocator)
 		           .AddMember("la", st->la, allocator)
 		           .AddMember("free", (uint64_t)st->free, allocator)
 		           .AddMember("stall", st->stall, allocator)
-		           .AddMember("join_state", st->__join_state, allocator);
+		           .AddMember("join_state", st->__join_state, allocator)
+		           .AddMember("lane", st->lane, allocator);
+
+		// lanes share address with their primary state, so their number is appended to the key
+		std::string key = dnet_addr_string(&st->addr);
+		if (st->lane)
+			key += "/lane-" + std::to_string(st->lane);
 
-		rapidjson::Value addr(dnet_addr_string(&st->addr), allocator);
+		rapidjson::Value addr(key.c_str(), allocator);
 		stat.AddMember(addr, state_value, allocator);
 	}
 	pthread_mutex_unlock(&n->state_lock);
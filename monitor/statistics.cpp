@@ -19,6 +19,8 @@
 
 #include "statistics.hpp"
 
+#include <algorithm>
+
 #include "monitor.hpp"
 #include "cache/cache.hpp"
 #include "elliptics/backends.h"
@@ -128,9 +130,33 @@ static void clients_stat_json(dnet_node *n, rapidjson::Value &stat_value,
 }
 
 
+/*
+ * Number of threads which update the same shard is about
+ * number of processing threads divided by this limit.
+ */
+#define DNET_COMMAND_STATS_SHARDS_MAX	16
+
+/*
+ * Shard index of the current thread, threads are spread over shards in round-robin order
+ */
+static std::atomic<size_t> command_stats_thread_counter(0);
+static __thread size_t command_stats_thread_index;
+static __thread bool command_stats_thread_index_set;
+
 command_stats::command_stats()
+: m_shards_num(std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), DNET_COMMAND_STATS_SHARDS_MAX))
+, m_shards(new shard[m_shards_num]())
 {
-	m_cmd_stats.resize(__DNET_CMD_MAX);
+}
+
+command_stats::shard &command_stats::current_shard()
+{
+	if (!command_stats_thread_index_set) {
+		command_stats_thread_index = command_stats_thread_counter.fetch_add(1, std::memory_order_relaxed);
+		command_stats_thread_index_set = true;
+	}
+
+	return m_shards[command_stats_thread_index % m_shards_num];
 }
 
 void command_stats::command_counter(const int orig_cmd,
@@ -145,21 +171,42 @@ void command_stats::command_counter(const int orig_cmd,
 	if (cmd >= __DNET_CMD_MAX || cmd <= 0)
 		cmd = DNET_CMD_UNKNOWN;
 
-	std::unique_lock<std::mutex> guard(m_cmd_stats_mutex);
-	auto &place = cache ? m_cmd_stats[cmd].cache : m_cmd_stats[cmd].disk;
-	auto &source = trans ? place.outside : place.internal;
-	auto &counter = err ? source.counter.failures : source.counter.successes;
+	auto &source = current_shard().counters[cmd][!!cache][!!trans];
+
+	source[err ? counter_failures : counter_successes].fetch_add(1, std::memory_order_relaxed);
+	source[counter_size].fetch_add(size, std::memory_order_relaxed);
+	source[counter_time].fetch_add(time, std::memory_order_relaxed);
+}
+
+void command_stats::collect(std::vector<command_counters> &stats) const
+{
+	stats.assign(__DNET_CMD_MAX, command_counters());
+
+	for (size_t i = 0; i < m_shards_num; ++i) {
+		const shard &sh = m_shards[i];
+
+		for (int cmd = 0; cmd < __DNET_CMD_MAX; ++cmd) {
+			for (int cache = 0; cache < 2; ++cache) {
+				auto &place = cache ? stats[cmd].cache : stats[cmd].disk;
+
+				for (int outside = 0; outside < 2; ++outside) {
+					auto &source = outside ? place.outside : place.internal;
+					auto &counters = sh.counters[cmd][cache][outside];
 
-	++counter;
-	source.size += size;
-	source.time += time;
+					source.counter.successes += counters[counter_successes].load(std::memory_order_relaxed);
+					source.counter.failures += counters[counter_failures].load(std::memory_order_relaxed);
+					source.size += counters[counter_size].load(std::memory_order_relaxed);
+					source.time += counters[counter_time].load(std::memory_order_relaxed);
+				}
+			}
+		}
+	}
 }
 
 rapidjson::Value& command_stats::commands_report(dnet_node *node, rapidjson::Value &stat_value,
 		rapidjson::Document::AllocatorType &allocator) const {
-	std::unique_lock<std::mutex> guard(m_cmd_stats_mutex);
-	std::vector<command_counters> tmp_stats = m_cmd_stats;
-	guard.unlock();
+	std::vector<command_counters> tmp_stats;
+	collect(tmp_stats);
 
 	for (int i = 1; i < __DNET_CMD_MAX; ++i) {
 		if (tmp_stats[i].has_data()) {
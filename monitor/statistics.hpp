@@ -25,6 +25,7 @@
 #else
 #  include <atomic>
 #endif
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <thread>
@@ -137,6 +138,9 @@ struct command_counters {
  * This structure can be embedded into each backend and also into @statistics class
  * to maintain global command counters.
  *
+ * Counters are split into shards, every thread updates its own shard with relaxed
+ * atomic increments, so no lock is taken on command's hot path. Shards are summed
+ * only when report is requested.
  */
 class command_stats {
 public:
@@ -165,16 +169,48 @@ private:
 	/*!
 	 * \internal
 	 *
-	 * Lock for controlling access to commands statistics
+	 * Counters of one ext_counter: successes, failures, size and time
 	 */
-	mutable std::mutex m_cmd_stats_mutex;
+	enum {
+		counter_successes = 0,
+		counter_failures,
+		counter_size,
+		counter_time,
+		counter_max
+	};
 
 	/*!
 	 * \internal
 	 *
-	 * Commands statistics
+	 * Per-thread part of commands statistics indexed by [cmd][cache][outside][counter],
+	 * padded to keep neighbour shards out of the same cache line
 	 */
-	std::vector<command_counters> m_cmd_stats;
+	struct shard {
+		std::atomic<uint64_t>	counters[__DNET_CMD_MAX][2][2][counter_max];
+		char			pad[64];
+	};
+
+	/*!
+	 * \internal
+	 *
+	 * Returns shard which should be updated by the calling thread
+	 */
+	shard &current_shard();
+
+	/*!
+	 * \internal
+	 *
+	 * Sums all shards into \a stats
+	 */
+	void collect(std::vector<command_counters> &stats) const;
+
+	/*!
+	 * \internal
+	 *
+	 * Commands statistics shards
+	 */
+	size_t				m_shards_num;
+	std::unique_ptr<shard[]>	m_shards;
 };
 
 /*!
@@ -17,8 +17,14 @@
 #include "test_base.hpp"
 #include "../cache/cache.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <list>
+#include <map>
 #include <stdexcept>
+#include <thread>
+
+#include <unistd.h>
 
 #define BOOST_TEST_NO_MAIN
 #include <boost/test/included/unit_test.hpp>
@@ -44,6 +50,10 @@ static void configure_nodes(const std::string &path)
 			("group", 5)
 			("cache_size", 100000)
 			("cache_shards", 1)
+			("cache_slab_allocator", true)
+			("cache_sync_timeout", 1)
+			("cache_sync_threads", 2)
+			("cache_sync_batch", 4)
 		)
 	}), path);
 
@@ -81,6 +91,33 @@ static void test_cache_timestamp(session &sess)
 	BOOST_REQUIRE_EQUAL(io->timestamp.tnsec, ctl.io.timestamp.tnsec);
 }
 
+/*!
+ * Checks that dirty objects of all shards are written to the backend by write-behind
+ * when their sync time comes, objects are written by several threads in batches.
+ */
+static void test_cache_write_behind(session &sess)
+{
+	const size_t objects_number = 32;
+
+	for (size_t i = 0; i < objects_number; ++i) {
+		const std::string id = "write behind test key " + boost::lexical_cast<std::string>(i);
+		const std::string data = "write behind data " + id;
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(key(id), data, 0));
+	}
+
+	// sync timeout of test node is 1 second, write-behind pass is run every second
+	sleep(4);
+
+	session disk_sess = sess.clone();
+	disk_sess.set_ioflags(DNET_IO_FLAGS_NOCACHE);
+
+	for (size_t i = 0; i < objects_number; ++i) {
+		const std::string id = "write behind test key " + boost::lexical_cast<std::string>(i);
+		ELLIPTICS_REQUIRE(read_result, disk_sess.read_data(key(id), 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), "write behind data " + id);
+	}
+}
+
 static void test_cache_records_sizes(session &sess)
 {
 	dnet_node *node = global_data->nodes[0].get_native();
@@ -282,6 +319,377 @@ static void test_cache_lru_eviction(session &sess)
 
 /*! \} */ //test_cache_lru_eviction group
 
+/*!
+ * Cache hits are sent without copying cached buffer, so this test checks that
+ * overwrites issued while replies are still queued do not change data of those replies:
+ * every read must return either the whole old or the whole new record.
+ */
+static void test_cache_overwrite_during_read(session &sess)
+{
+	const std::string first_data(4 * 1024, 'a');
+	const std::string second_data(4 * 1024, 'b');
+	const size_t reads_number = 64;
+	key id("this is a cache overwrite during read test key");
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_cache(id, first_data, 3000));
+
+	std::vector<async_read_result> reads;
+	for (size_t i = 0; i < reads_number; ++i) {
+		reads.emplace_back(sess.read_data(id, 0, 0));
+		if (i == reads_number / 2)
+			ELLIPTICS_REQUIRE(second_write_result, sess.write_cache(id, second_data, 3000));
+	}
+
+	for (auto it = reads.begin(); it != reads.end(); ++it) {
+		it->wait();
+		BOOST_REQUIRE_EQUAL(it->error().code(), 0);
+
+		const std::string data = it->get_one().file().to_string();
+		BOOST_REQUIRE(data == first_data || data == second_data);
+	}
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_data(id, 0, 0));
+	BOOST_REQUIRE(read_result.get_one().file().to_string() == second_data);
+}
+
+/*!
+ * Checks that hash index of cache shard finds exactly the objects which were inserted and not erased,
+ * IDs share their first word to produce collisions and long probe sequences.
+ */
+static void test_cache_hash_index()
+{
+	using ioremap::cache::data_t;
+
+	const size_t num_iter = 100000;
+	const size_t num_keys = 4096;
+
+	ioremap::cache::hash_index_t index;
+	std::map<size_t, data_t *> objects;
+
+	for (size_t i = 0; i < num_iter; ++i) {
+		const size_t key = rand() % num_keys;
+
+		dnet_raw_id id;
+		memset(&id, 0, sizeof(id));
+		memcpy(id.id + sizeof(uint64_t), &key, sizeof(key));
+		id.id[sizeof(uint64_t)] &= 0xf;
+		id.id[DNET_ID_SIZE - 1] = key >> 4;
+
+		data_t *found = index.find(id.id);
+		auto it = objects.find(key);
+
+		BOOST_REQUIRE_EQUAL(found, it == objects.end() ? NULL : it->second);
+
+		if (rand() & 1) {
+			if (!found) {
+				data_t *obj = new data_t(id.id);
+				index.insert(obj);
+				objects.insert(std::make_pair(key, obj));
+			}
+		} else if (found) {
+			index.erase(found);
+			objects.erase(it);
+			delete found;
+		}
+
+		BOOST_REQUIRE_EQUAL(index.size(), objects.size());
+	}
+
+	for (auto it = objects.begin(); it != objects.end(); ++it) {
+		index.erase(it->second);
+		delete it->second;
+	}
+
+	BOOST_REQUIRE(index.empty());
+}
+
+/*!
+ * Checks that slab allocator rounds allocations up to its size classes,
+ * accounts used and wasted bytes of every class and gives away pages which are not used anymore.
+ */
+static void test_cache_slab_allocator()
+{
+	using ioremap::cache::slab_allocator_t;
+	using ioremap::cache::slab_stats;
+
+	const size_t page_size = 64 * 1024;
+	slab_allocator_t slab(page_size);
+	std::vector<std::pair<void *, size_t>> allocations;
+
+	for (size_t size = 1; size < 2 * page_size; size = size * 3 / 2 + 1) {
+		void *ptr = slab.allocate(size);
+		memset(ptr, 0xff, size);
+		allocations.emplace_back(ptr, size);
+
+		BOOST_REQUIRE_GE(slab.real_size(size), size);
+		if (size <= page_size) {
+			BOOST_REQUIRE_LE(slab.real_size(size), std::max<size_t>(64, size + size / 4 + 16));
+		}
+	}
+
+	slab_stats stats = slab.stats();
+	size_t used_size = 0, wasted_size = 0, large_size = 0;
+	for (auto it = allocations.begin(); it != allocations.end(); ++it) {
+		if (it->second > page_size) {
+			large_size += it->second;
+		} else {
+			used_size += it->second;
+			wasted_size += slab.real_size(it->second) - it->second;
+		}
+	}
+
+	size_t stats_used_size = 0, stats_wasted_size = 0;
+	for (auto it = stats.classes.begin(); it != stats.classes.end(); ++it) {
+		stats_used_size += it->used_size;
+		stats_wasted_size += it->wasted_size();
+	}
+
+	BOOST_REQUIRE_EQUAL(stats_used_size, used_size);
+	BOOST_REQUIRE_EQUAL(stats_wasted_size, wasted_size);
+	BOOST_REQUIRE_EQUAL(stats.large_size, large_size);
+
+	for (auto it = allocations.begin(); it != allocations.end(); ++it) {
+		slab.deallocate(it->first, it->second);
+	}
+
+	stats = slab.stats();
+	for (auto it = stats.classes.begin(); it != stats.classes.end(); ++it) {
+		BOOST_REQUIRE_EQUAL(it->used_slots, 0);
+		BOOST_REQUIRE_EQUAL(it->used_size, 0);
+		BOOST_REQUIRE_EQUAL(it->slots, 0);
+	}
+	BOOST_REQUIRE_EQUAL(stats.large_number, 0);
+
+	// only a few empty pages are kept for reuse
+	const size_t pages_size = stats.pages_size;
+	BOOST_REQUIRE_LE(pages_size, 4 * page_size);
+
+	// memory freed by small objects is reused when object sizes shift
+	const size_t small_size = 100, large_size_step = page_size / 4;
+	for (size_t i = 0; i < 2; ++i) {
+		const size_t size = i ? large_size_step : small_size;
+		const size_t number = 16 * (page_size / slab.real_size(size));
+
+		allocations.clear();
+		for (size_t j = 0; j < number; ++j) {
+			allocations.emplace_back(slab.allocate(size), size);
+		}
+
+		BOOST_REQUIRE_EQUAL(slab.stats().pages_size, 16 * page_size);
+
+		for (auto it = allocations.begin(); it != allocations.end(); ++it) {
+			slab.deallocate(it->first, it->second);
+		}
+
+		BOOST_REQUIRE_LE(slab.stats().pages_size, 4 * page_size);
+	}
+}
+
+/*!
+ * Checks that TinyLFU admission prefers frequently used objects
+ * and that old history fades out after the sketch is aged.
+ */
+static void test_cache_tinylfu_admission()
+{
+	using ioremap::cache::tinylfu_admission_t;
+
+	const size_t width = 1024;
+	tinylfu_admission_t admission(width);
+
+	auto make_id = [] (unsigned char seed) {
+		dnet_raw_id id;
+		for (size_t i = 0; i < sizeof(id.id); ++i) {
+			id.id[i] = seed + i * 31;
+		}
+		return id;
+	};
+
+	dnet_raw_id hot = make_id(1);
+	dnet_raw_id cold = make_id(2);
+
+	for (size_t i = 0; i < 10; ++i) {
+		admission.record(hot.id);
+	}
+	admission.record(cold.id);
+
+	BOOST_REQUIRE_EQUAL(admission.frequency(hot.id), 10);
+	BOOST_REQUIRE_EQUAL(admission.frequency(cold.id), 1);
+	BOOST_REQUIRE(admission.admit(hot.id, cold.id));
+	BOOST_REQUIRE(!admission.admit(cold.id, hot.id));
+	BOOST_REQUIRE(!admission.admit(cold.id, cold.id));
+
+	// the rest of the sample is taken by the cold object, so it saturates and then all counters are halved
+	for (size_t i = 11; i < 10 * width; ++i) {
+		admission.record(cold.id);
+	}
+
+	BOOST_REQUIRE_EQUAL(admission.frequency(hot.id), 5);
+	BOOST_REQUIRE_EQUAL(admission.frequency(cold.id), 7);
+	BOOST_REQUIRE(admission.admit(cold.id, hot.id));
+}
+
+/*!
+ * Checks that timer wheel returns objects exactly when their deadlines come,
+ * including deadlines cascaded from the upper levels and rescheduled or cancelled ones.
+ */
+static void test_cache_timer_wheel()
+{
+	using ioremap::cache::data_t;
+
+	const size_t start = 1000000;
+	const size_t num_objects = 4096;
+
+	ioremap::cache::timer_wheel_t wheel(start);
+	std::vector<std::unique_ptr<data_t>> objects;
+	std::map<data_t *, size_t> deadlines;
+
+	for (size_t i = 0; i < num_objects; ++i) {
+		dnet_raw_id id;
+		memset(&id, 0, sizeof(id));
+		memcpy(id.id, &i, sizeof(i));
+		objects.emplace_back(new data_t(id.id));
+	}
+
+	// deadlines spread over all levels of the wheel, some of them are already expired
+	for (size_t i = 0; i < num_objects; ++i) {
+		const size_t deadline = start - 10 + (size_t(1) << (i % 24)) + rand() % 300;
+		wheel.schedule(objects[i].get(), deadline);
+		deadlines[objects[i].get()] = deadline;
+	}
+
+	for (size_t i = 0; i < num_objects; i += 7) {
+		if (i % 2) {
+			wheel.cancel(objects[i].get());
+			deadlines.erase(objects[i].get());
+		} else {
+			const size_t deadline = start + rand() % 1000;
+			wheel.schedule(objects[i].get(), deadline);
+			deadlines[objects[i].get()] = deadline;
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(wheel.size(), deadlines.size());
+
+	// time goes by seconds first, and then it jumps like after a long stall
+	for (size_t now = start, step = 0; !deadlines.empty(); now += (++step < 2000) ? 1 : 1000 + rand() % 100000) {
+		while (data_t *obj = wheel.pop_expired(now)) {
+			auto it = deadlines.find(obj);
+			BOOST_REQUIRE(it != deadlines.end());
+			BOOST_REQUIRE_LE(it->second, now);
+			deadlines.erase(it);
+		}
+
+		for (auto it = deadlines.begin(); it != deadlines.end(); ++it) {
+			BOOST_REQUIRE_GT(it->second, now);
+		}
+		BOOST_REQUIRE_EQUAL(wheel.size(), deadlines.size());
+	}
+
+	BOOST_REQUIRE(wheel.empty());
+}
+
+/*!
+ * Checks chunked object data against plain string: appends, writes with offset
+ * and truncations must give the same contents, while copy taken before them stays unchanged.
+ */
+static void test_cache_raw_data_chunks()
+{
+	using ioremap::cache::raw_data_t;
+
+	const size_t chunk_size = raw_data_t::chunk_size;
+
+	raw_data_t data(NULL, 0);
+	std::string expected;
+
+	for (size_t i = 0; i < 500; ++i) {
+		const raw_data_t pinned(data);
+		const std::string pinned_expected = expected;
+
+		const std::string part(rand() % (2 * chunk_size), 'a' + i % 26);
+
+		switch (rand() % 3) {
+		case 0:
+			data.append(part.data(), part.size());
+			expected += part;
+			break;
+		case 1: {
+			const size_t offset = rand() % (expected.size() + 1);
+			data.write(offset, part.data(), part.size());
+			expected.resize(offset);
+			expected += part;
+			break;
+		}
+		case 2: {
+			const size_t size = rand() % (expected.size() + chunk_size);
+			data.resize(size);
+			expected.resize(size, '\0');
+			break;
+		}
+		}
+
+		if (expected.size() > 32 * chunk_size) {
+			data.resize(chunk_size / 2);
+			expected.resize(chunk_size / 2);
+		}
+
+		const std::vector<char> result = data.flatten();
+		BOOST_REQUIRE_EQUAL(data.size(), expected.size());
+		BOOST_REQUIRE(std::string(result.begin(), result.end()) == expected);
+
+		const std::vector<char> pinned_result = pinned.flatten();
+		BOOST_REQUIRE(std::string(pinned_result.begin(), pinned_result.end()) == pinned_expected);
+
+		if (!expected.empty()) {
+			const size_t offset = rand() % expected.size();
+			const size_t size = 1 + rand() % (expected.size() - offset);
+
+			std::string slice(size, '\0');
+			data.read(offset, size, &slice[0]);
+			BOOST_REQUIRE(slice == expected.substr(offset, size));
+
+			const char *contiguous = data.contiguous(offset, size);
+			BOOST_REQUIRE_EQUAL(contiguous == NULL, offset / chunk_size != (offset + size - 1) / chunk_size);
+			if (contiguous) {
+				BOOST_REQUIRE(!memcmp(contiguous, expected.data() + offset, size));
+			}
+		}
+	}
+}
+
+/*!
+ * Checks that compression codec restores original data
+ * and that repetitive data really becomes smaller.
+ */
+static void test_cache_compression_codec()
+{
+	using namespace ioremap::cache;
+
+	BOOST_REQUIRE(!create_compression_codec("none"));
+	BOOST_REQUIRE_THROW(create_compression_codec("unknown"), std::invalid_argument);
+
+	std::unique_ptr<compression_codec_t> codec = create_compression_codec("zlib");
+	BOOST_REQUIRE(codec);
+
+	std::string text;
+	for (size_t i = 0; i < 1000; ++i) {
+		text += "{\"key\": " + boost::lexical_cast<std::string>(i % 10) + ", \"value\": \"some text\"}\n";
+	}
+
+	std::vector<std::string> samples({ std::string(), std::string("x"), text, std::string(70000, '\0') });
+	for (auto it = samples.begin(); it != samples.end(); ++it) {
+		raw_data_t data(it->data(), it->size()), compressed(NULL, 0), decompressed(NULL, 0);
+		codec->compress(data, compressed);
+		codec->decompress(compressed, decompressed);
+
+		const std::vector<char> result = decompressed.flatten();
+		BOOST_REQUIRE_EQUAL(std::string(result.begin(), result.end()), *it);
+	}
+
+	raw_data_t compressed(NULL, 0);
+	codec->compress(raw_data_t(text.data(), text.size()), compressed);
+	BOOST_REQUIRE_LT(compressed.size() * 3, text.size());
+}
+
 std::string generate_data(size_t length)
 {
 	std::string data;
@@ -292,13 +700,178 @@ std::string generate_data(size_t length)
 	return data;
 }
 
+/*!
+ * Checks that objects written into cache snapshot are read back
+ * section by section in the same order and that broken snapshot is rejected.
+ */
+static void test_cache_snapshot_file(const std::string &path)
+{
+	using namespace ioremap::cache;
+
+	std::vector<snapshot_section_t> sections(3);
+	for (size_t i = 0; i < 100; ++i) {
+		snapshot_object object;
+		for (size_t j = 0; j < sizeof(object.id.id); ++j) {
+			object.id.id[j] = rand();
+		}
+		object.page = i % 2;
+		object.timestamp.tsec = i;
+		object.timestamp.tnsec = i * 1000;
+		object.user_flags = i * 7;
+
+		const std::string data = generate_data(i * 13);
+		object.data = std::make_shared<raw_data_t>(data.c_str(), data.size());
+
+		sections[i % 2].push_back(object);
+	}
+
+	write_snapshot(path, sections);
+
+	{
+		snapshot_reader reader(path);
+		BOOST_REQUIRE_EQUAL(reader.sections(), sections.size());
+
+		for (size_t i = 0; i < sections.size(); ++i) {
+			size_t index = 0;
+			reader.read_section(i, [&] (const snapshot_entry &entry, const char *data) {
+				BOOST_REQUIRE_LT(index, sections[i].size());
+				const snapshot_object &object = sections[i][index++];
+
+				BOOST_REQUIRE(!memcmp(entry.id.id, object.id.id, DNET_ID_SIZE));
+				// fields of packed entry are copied, they can not be bound to references
+				BOOST_REQUIRE_EQUAL(static_cast<size_t>(entry.page), object.page);
+				BOOST_REQUIRE_EQUAL(static_cast<uint64_t>(entry.timestamp.tsec), object.timestamp.tsec);
+				BOOST_REQUIRE_EQUAL(static_cast<uint64_t>(entry.timestamp.tnsec), object.timestamp.tnsec);
+				BOOST_REQUIRE_EQUAL(static_cast<uint64_t>(entry.user_flags), object.user_flags);
+				BOOST_REQUIRE_EQUAL(static_cast<size_t>(entry.size), object.data->size());
+				BOOST_REQUIRE(!memcmp(data, object.data->flatten().data(), entry.size));
+			});
+			BOOST_REQUIRE_EQUAL(index, sections[i].size());
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(truncate(path.c_str(), 1000), 0);
+	BOOST_REQUIRE_THROW(snapshot_reader reader(path), std::runtime_error);
+
+	BOOST_REQUIRE_EQUAL(unlink(path.c_str()), 0);
+}
+
+/*!
+ * Benchmark of reads of cached objects by many threads for different numbers of shards.
+ * Objects are put into cache from snapshot, so all reads are hits served under shared locks of shards.
+ */
+static void test_cache_shards_contention(session &sess)
+{
+	using namespace ioremap::cache;
+
+	dnet_node *node = global_data->nodes[0].get_native();
+	dnet_backend_io *backend = &node->io->backends[0];
+	const std::string path = global_data->directory.path() + "/cache_contention.snapshot";
+
+	const size_t objects_number = 1024;
+	const size_t threads_number = std::max(4u, std::thread::hardware_concurrency());
+	const size_t reads_number = (1 << 20) / threads_number;
+
+	// objects are restored from snapshot only if they exist on disk
+	session disk_sess = sess.clone();
+	disk_sess.set_ioflags(DNET_IO_FLAGS_NOCACHE);
+
+	std::vector<snapshot_section_t> sections(1);
+	for (size_t i = 0; i < objects_number; ++i) {
+		key k("cache contention test key " + boost::lexical_cast<std::string>(i));
+		disk_sess.transform(k);
+
+		const std::string data = generate_data(256);
+		ELLIPTICS_REQUIRE(write_result, disk_sess.write_data(k, data, 0));
+
+		snapshot_object object;
+		memcpy(object.id.id, k.id().id, DNET_ID_SIZE);
+		object.page = 0;
+		dnet_current_time(&object.timestamp);
+		object.user_flags = 0;
+		object.data = std::make_shared<raw_data_t>(data.data(), data.size());
+		sections[0].push_back(object);
+	}
+
+	write_snapshot(path, sections);
+
+	for (size_t shards = 1; shards <= 256; shards *= 16) {
+		cache_config config;
+		config.size = 64 * 1024 * 1024;
+		config.count = shards;
+		config.sync_timeout = 30;
+		config.sync_threads = 1;
+		config.sync_batch = 1;
+		config.sync_rate = 0;
+		config.pages_proportions = std::vector<size_t>(1, 1);
+		config.slab_allocator = false;
+		config.admission = "none";
+		config.compression = "none";
+		config.compressed_pages = 1;
+		config.snapshot = true;
+		config.snapshot_interval = 0;
+		config.snapshot_path = path;
+
+		cache_manager cache(backend, node, config);
+		BOOST_REQUIRE_EQUAL(cache.shards_number(), shards);
+		BOOST_REQUIRE_EQUAL(cache.restore_stats().restored_objects, objects_number);
+
+		std::atomic<size_t> hits(0);
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i < threads_number; ++i) {
+			threads.emplace_back([&, i] () {
+				unsigned int seed = i;
+				size_t thread_hits = 0;
+
+				for (size_t j = 0; j < reads_number; ++j) {
+					const snapshot_object &object = sections[0][rand_r(&seed) % objects_number];
+
+					dnet_cmd cmd;
+					memset(&cmd, 0, sizeof(cmd));
+					dnet_io_attr io;
+					memset(&io, 0, sizeof(io));
+
+					if (cache.read(object.id.id, &cmd, &io))
+						++thread_hits;
+				}
+
+				hits += thread_hits;
+			});
+		}
+		for (auto it = threads.begin(); it != threads.end(); ++it) {
+			it->join();
+		}
+
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		BOOST_REQUIRE_EQUAL(hits.load(), reads_number * threads_number);
+
+		BOOST_TEST_MESSAGE("cache shards: " << shards
+				<< ", threads: " << threads_number
+				<< ", reads: " << static_cast<uint64_t>(hits / elapsed.count()) << " reads/s");
+	}
+
+	BOOST_REQUIRE_EQUAL(unlink(path.c_str()), 0);
+}
+
 bool register_tests(test_suite *suite, node n)
 {
 	ELLIPTICS_TEST_CASE(test_cache_timestamp, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_write_behind, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
 	ELLIPTICS_TEST_CASE(test_cache_records_sizes, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
 	ELLIPTICS_TEST_CASE(test_cache_lru_eviction, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
+	ELLIPTICS_TEST_CASE(test_cache_overwrite_during_read, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_hash_index);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_slab_allocator);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_tinylfu_admission);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_timer_wheel);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_raw_data_chunks);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_compression_codec);
+	ELLIPTICS_TEST_CASE(test_cache_snapshot_file, global_data->directory.path() + "/cache_test.snapshot");
+	ELLIPTICS_TEST_CASE(test_cache_shards_contention, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
 
 	return true;
 }
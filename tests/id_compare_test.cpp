@@ -0,0 +1,260 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "test_base.hpp"
+#include <elliptics/id_compare.h>
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+/*
+ * Byte-wise comparison which was used by dnet_id_cmp_str() before,
+ * it is the reference for correctness checks and the baseline for benchmarks.
+ */
+static int legacy_id_cmp(const unsigned char *id1, const unsigned char *id2)
+{
+	for (unsigned int i = 0; i < DNET_ID_SIZE; ++i) {
+		if (id1[i] < id2[i])
+			return -1;
+		if (id1[i] > id2[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Route lookup as it was implemented over array of full IDs,
+ * returns position of the largest ID not greater than @id or -1.
+ */
+static int legacy_search(const std::vector<dnet_raw_id> &ids, const unsigned char *id)
+{
+	int low, high, i, cmp;
+
+	for (low = -1, high = ids.size(); high - low > 1; ) {
+		i = low + (high - low) / 2;
+
+		cmp = legacy_id_cmp(ids[i].id, id);
+		if (cmp < 0)
+			low = i;
+		else if (cmp > 0)
+			high = i;
+		else
+			return i;
+	}
+
+	return high - 1;
+}
+
+static void random_id(dnet_raw_id &id)
+{
+	for (size_t i = 0; i < sizeof(id.id); ++i)
+		id.id[i] = rand();
+}
+
+static int sign(int value)
+{
+	return (value > 0) - (value < 0);
+}
+
+/*
+ * Compares IDs which differ at every possible position (and equal ones)
+ * with both vectorized and reference comparators.
+ */
+static void test_id_cmp()
+{
+	const size_t num_iter = 10000;
+	dnet_raw_id a, b;
+
+	for (size_t i = 0; i < num_iter; ++i) {
+		random_id(a);
+		b = a;
+
+		BOOST_REQUIRE_EQUAL(dnet_id_cmp_raw(a.id, b.id), 0);
+		BOOST_REQUIRE(dnet_id_equal_raw(a.id, b.id));
+
+		const size_t pos = rand() % DNET_ID_SIZE;
+		b.id[pos] = rand();
+
+		BOOST_REQUIRE_EQUAL(dnet_id_cmp_raw(a.id, b.id), sign(legacy_id_cmp(a.id, b.id)));
+		BOOST_REQUIRE_EQUAL(dnet_id_cmp_raw(b.id, a.id), sign(legacy_id_cmp(b.id, a.id)));
+		BOOST_REQUIRE_EQUAL(!!dnet_id_equal_raw(a.id, b.id), a.id[pos] == b.id[pos]);
+		BOOST_REQUIRE_EQUAL(dnet_id_prefix(a.id) != dnet_id_prefix(b.id), pos < 8 && a.id[pos] != b.id[pos]);
+	}
+}
+
+struct route_entry {
+	dnet_raw_id	raw;
+	void		*st;
+	int		backend_id;
+};
+
+struct route_table {
+	std::vector<dnet_raw_id> ids;
+	std::vector<uint64_t> prefixes;
+	std::vector<route_entry> entries;
+};
+
+/*
+ * Generates sorted route table of @num IDs, every @shared_prefix'th ID shares
+ * its 8-byte prefix with the previous one to exercise full ID comparison.
+ */
+static route_table make_route_table(size_t num, size_t shared_prefix)
+{
+	route_table table;
+
+	table.ids.resize(num);
+	for (size_t i = 0; i < num; ++i) {
+		random_id(table.ids[i]);
+		if (i && shared_prefix && (i % shared_prefix == 0))
+			memcpy(table.ids[i].id, table.ids[i - 1].id, 8);
+	}
+
+	std::sort(table.ids.begin(), table.ids.end(), dnet_raw_id_less_than<skip_data>());
+
+	for (size_t i = 0; i < num; ++i) {
+		route_entry entry;
+		entry.raw = table.ids[i];
+		entry.st = nullptr;
+		entry.backend_id = i;
+
+		table.entries.push_back(entry);
+		table.prefixes.push_back(dnet_id_prefix(table.ids[i].id));
+	}
+
+	return table;
+}
+
+static int prefix_search(const route_table &table, const unsigned char *id)
+{
+	return dnet_id_prefix_search(table.prefixes.data(), table.entries.data(), sizeof(route_entry),
+			table.entries.size(), id);
+}
+
+static void test_prefix_search()
+{
+	const size_t num_iter = 100000;
+	route_table table = make_route_table(4096, 16);
+	dnet_raw_id id;
+
+	for (size_t i = 0; i < num_iter; ++i) {
+		if (i & 1) {
+			random_id(id);
+		} else {
+			/* hit existing ID or its prefix */
+			id = table.ids[rand() % table.ids.size()];
+			if (i & 2)
+				id.id[DNET_ID_SIZE - 1] ^= 1;
+		}
+
+		BOOST_REQUIRE_EQUAL(prefix_search(table, id.id), legacy_search(table.ids, id.id));
+	}
+}
+
+template <typename Search>
+static double lookups_per_second(const std::vector<dnet_raw_id> &keys, size_t num_iter, Search search, long &checksum)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < num_iter; ++i)
+		checksum += search(keys[i % keys.size()].id);
+
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	return num_iter / elapsed.count();
+}
+
+/*
+ * Microbenchmark: route lookups per second with byte-wise comparison over array of full IDs
+ * against prefix search with vectorized comparison, results are printed as test messages.
+ */
+static void test_lookup_benchmark(size_t table_size)
+{
+	const size_t num_keys = 1 << 16;
+	const size_t num_iter = 4000000;
+	route_table table = make_route_table(table_size, 0);
+	std::vector<dnet_raw_id> keys(num_keys);
+	long legacy_checksum = 0, checksum = 0;
+
+	for (auto it = keys.begin(); it != keys.end(); ++it)
+		random_id(*it);
+
+	const double legacy = lookups_per_second(keys, num_iter, [&] (const unsigned char *id) {
+		return legacy_search(table.ids, id);
+	}, legacy_checksum);
+
+	const double current = lookups_per_second(keys, num_iter, [&] (const unsigned char *id) {
+		return prefix_search(table, id);
+	}, checksum);
+
+	BOOST_REQUIRE_EQUAL(legacy_checksum, checksum);
+
+	BOOST_TEST_MESSAGE("route table size: " << table_size
+			<< ", byte-wise search: " << static_cast<uint64_t>(legacy) << " lookups/s"
+			<< ", prefix search: " << static_cast<uint64_t>(current) << " lookups/s"
+			<< ", speedup: " << current / legacy);
+}
+
+bool register_tests(test_suite *suite)
+{
+	ELLIPTICS_TEST_CASE_NOARGS(test_id_cmp);
+	ELLIPTICS_TEST_CASE_NOARGS(test_prefix_search);
+	ELLIPTICS_TEST_CASE(test_lookup_benchmark, 256);
+	ELLIPTICS_TEST_CASE(test_lookup_benchmark, 16384);
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return nullptr;
+	}
+
+	test_suite *suite = new ELLIPTICS_MAKE_TEST_SUITE("ID comparison test suite");
+	register_tests(suite);
+
+	return suite;
+}
+
+} // namespace tests
+
+int main(int argc, char *argv[])
+{
+	srand(time(nullptr));
+	return unit_test_main(tests::register_tests, argc, argv);
+}
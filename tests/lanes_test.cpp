@@ -0,0 +1,169 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include "test_base.hpp"
+#include "../library/elliptics.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+static std::shared_ptr<nodes_data> global_data;
+
+static int net_lanes = 3;
+static int check_timeout = 1;
+
+static server_config default_value()
+{
+	server_config server = server_config::default_value();
+	server.backends[0]("enable", true)("group", 1);
+
+	return server;
+}
+
+static void configure_nodes(const std::string &path)
+{
+	std::vector<server_config> servers;
+	servers.push_back(default_value());
+
+	start_nodes_config start_config(results_reporter::get_stream(), std::move(servers), path);
+	start_config.fork = true;
+	start_config.client_check_timeout = check_timeout;
+	start_config.client_net_lanes = net_lanes;
+
+	global_data = start_nodes(start_config);
+}
+
+/* waits until reconnection thread makes number of lanes to @addr equal to @expected */
+static int wait_lanes(session &sess, const address &addr, int expected)
+{
+	int lanes = sess.state_lanes(addr);
+
+	for (int i = 0; i < 10 * (check_timeout + 1) && lanes != expected; ++i) {
+		::usleep(100 * 1000);
+		lanes = sess.state_lanes(addr);
+	}
+
+	return lanes;
+}
+
+/* shuts down the first live lane to @addr, network thread resets it as any other broken connection */
+static void kill_lane(session &sess, const address &addr)
+{
+	dnet_net_state *st = dnet_state_search_by_addr(sess.get_native_node(), &addr.to_raw());
+	BOOST_REQUIRE(st != NULL);
+
+	pthread_mutex_lock(&st->trans_lock);
+	for (int i = 0; i < net_lanes - 1; ++i) {
+		if (st->lanes[i] && !st->lanes[i]->__need_exit) {
+			shutdown(st->lanes[i]->read_s, SHUT_RDWR);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&st->trans_lock);
+
+	dnet_state_put(st);
+}
+
+static void test_routes_lanes(session &sess)
+{
+	std::vector<dnet_route_entry> routes = sess.get_routes();
+	BOOST_REQUIRE(!routes.empty());
+
+	for (auto it = routes.begin(); it != routes.end(); ++it)
+		BOOST_REQUIRE_EQUAL(wait_lanes(sess, address(it->addr), net_lanes), net_lanes);
+}
+
+static void test_read_after_lane_reset(session &sess)
+{
+	const server_node &node = global_data->nodes[0];
+	const std::string id = "lanes_test_key";
+	const std::string data(1024 * 1024, 'x');
+
+	BOOST_REQUIRE_EQUAL(wait_lanes(sess, node.remote(), net_lanes), net_lanes);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+	ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(id, 0, data.size()), data);
+
+	kill_lane(sess, node.remote());
+	BOOST_REQUIRE_EQUAL(wait_lanes(sess, node.remote(), net_lanes - 1), net_lanes - 1);
+
+	// bulk reads are striped over the lanes which are left and the primary state is alive
+	for (int i = 0; i < net_lanes; ++i) {
+		ELLIPTICS_COMPARE_REQUIRE(read_reset_result, sess.read_data(id, 0, data.size()), data);
+	}
+	BOOST_REQUIRE_EQUAL(sess.state_num(), 1);
+
+	// reconnection thread opens the lane again
+	BOOST_REQUIRE_EQUAL(wait_lanes(sess, node.remote(), net_lanes), net_lanes);
+	ELLIPTICS_COMPARE_REQUIRE(read_refill_result, sess.read_data(id, 0, data.size()), data);
+}
+
+bool register_tests(test_suite *suite, node n)
+{
+	ELLIPTICS_TEST_CASE(test_routes_lanes, create_session(n, { 1 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_read_after_lane_reset, create_session(n, { 1 }, 0, 0));
+
+	return true;
+}
+
+static void destroy_global_data()
+{
+	global_data.reset();
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return NULL;
+	}
+
+	test_suite *suite = new ELLIPTICS_MAKE_TEST_SUITE("Local Test Suite");
+
+	configure_nodes(path);
+
+	register_tests(suite, *global_data->node);
+
+	return suite;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	atexit(tests::destroy_global_data);
+
+	srand(time(0));
+	return unit_test_main(tests::register_tests, argc, argv);
+}
@@ -29,7 +29,10 @@ namespace tests {
 
 static std::shared_ptr<nodes_data> global_data;
 
-static size_t groups_count = 1;
+/*
+ * Group 1 runs with default request queue, group 2 - with sharded one (DNET_CFG_SHARDED_REQUEST_QUEUE)
+ */
+static size_t groups_count = 2;
 static size_t nodes_count = 1;
 static size_t backends_count = 1;
 static int cache_sync_timeout = 1;
@@ -47,6 +50,9 @@ static server_config default_value(int group)
 		("cache_sync_timeout", cache_sync_timeout)
 	;
 
+	if (group == 2)
+		server.options("flags", 4 | DNET_CFG_SHARDED_REQUEST_QUEUE);
+
 	server.backends[0]("enable", true)("group", group);
 
 	server.backends.resize(backends_count, server.backends.front());
@@ -168,6 +174,9 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_write_order_execution, create_session(n, { 1 }, 0, 0));
 	ELLIPTICS_TEST_CASE(test_oplock, create_session(n, { 1 }, 0, 0));
 
+	ELLIPTICS_TEST_CASE(test_write_order_execution, create_session(n, { 2 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_oplock, create_session(n, { 2 }, 0, 0));
+
 	return true;
 }
 
@@ -140,6 +140,8 @@ class MonitorStatsChecker:
         for state in io['states']:
             state_io = io['states'][state]
             assert state_io['send_queue_size'] >= 0
+            assert state_io['send_syscalls'] >= 0
+            assert state_io['send_requests'] >= 0
             assert state_io['la'] >= 0
             assert state_io['free'] >= 0
             assert state_io['stall'] >= 0
@@ -149,6 +151,12 @@ class MonitorStatsChecker:
             io = self.json_stat['backends'][backend_id]['io']
             check_queue(io['blocking'])
             check_queue(io['nonblocking'])
+            read_queue = io['read_queue']
+            assert read_queue['queue_depth'] >= 0
+            assert read_queue['threads'] <= read_queue['queue_depth']
+            assert 0 <= read_queue['in_flight'] <= read_queue['queue_depth']
+            assert read_queue['completed'] >= 0
+            assert read_queue['queue_full'] >= 0
 
     def __check_commands_stat(self):
         '''full check of commands statistics in json'''
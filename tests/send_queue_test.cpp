@@ -0,0 +1,266 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include <numeric>
+#include <memory>
+#include <vector>
+#include "test_base.hpp"
+#include "../library/elliptics.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+struct request {
+	dnet_io_req	req;
+	dnet_cmd	cmd;
+	/* position of the reply in its transaction */
+	size_t		seq;
+};
+
+/* send queue of the state without network behind it, requests are "sent" by the test itself */
+class send_queue {
+public:
+	send_queue() {
+		memset(&m_st, 0, sizeof(m_st));
+
+		for (int i = 0; i < DNET_SEND_CLASSES; ++i)
+			INIT_LIST_HEAD(&m_st.send_list[i]);
+		m_st.send_class = DNET_SEND_CLASS_CONTROL;
+		m_st.write_s = 1;
+		m_st.read_s = 1;
+		m_st.accept_s = -1;
+	}
+
+	/* queues command of @size bytes, replies also carry @flags */
+	request *queue(int command, uint64_t trans, uint64_t flags, size_t size, size_t seq) {
+		m_requests.emplace_back(new request);
+		request *r = m_requests.back().get();
+
+		memset(r, 0, sizeof(request));
+		r->cmd.cmd = command;
+		r->cmd.trans = trans;
+		r->cmd.flags = flags;
+		r->cmd.size = size;
+		r->seq = seq;
+
+		r->req.header = &r->cmd;
+		r->req.hsize = sizeof(dnet_cmd);
+		r->req.dsize = size;
+		r->req.fd = -1;
+		INIT_LIST_HEAD(&r->req.req_entry);
+
+		dnet_send_list_add_nolock(&m_st, &r->req);
+		++m_queued;
+		return r;
+	}
+
+	/* sends the first request of the picked queue, returns NULL if nothing is queued */
+	request *send() {
+		list_head *send_list = dnet_send_list_pick_nolock(&m_st);
+		if (list_empty(send_list))
+			return nullptr;
+
+		dnet_io_req *r = list_first_entry(send_list, dnet_io_req, req_entry);
+		dnet_send_list_del_nolock(&m_st, r);
+		--m_queued;
+
+		return reinterpret_cast<request *>(reinterpret_cast<char *>(r) - offsetof(request, req));
+	}
+
+	size_t queued() const {
+		return m_queued;
+	}
+
+	const dnet_net_state &state() const {
+		return m_st;
+	}
+
+private:
+	dnet_net_state				m_st;
+	std::vector<std::unique_ptr<request>>	m_requests;
+	size_t					m_queued = 0;
+};
+
+/*
+ * Queues replies of more concurrent transactions than there are stream slots, so some of them
+ * are not tracked, their replies mix small, bulk and bare final ones and are interleaved with
+ * control commands. Requests are sent between queueing at random.
+ * Checks that replies of every transaction leave in order they were queued and stream slots are released.
+ */
+static void test_send_queue_stream_order()
+{
+	const size_t num_trans = DNET_SEND_STREAMS + DNET_SEND_STREAMS / 2;
+	const size_t max_replies = 16;
+
+	send_queue queue;
+	std::vector<size_t> queued(num_trans, 0), total(num_trans), sent(num_trans, 0);
+	size_t overflowed = 0, control_sent = 0, control_queued = 0;
+
+	for (size_t i = 0; i < num_trans; ++i)
+		total[i] = 1 + rand() % max_replies;
+
+	auto send_one = [&] () {
+		request *r = queue.send();
+		BOOST_REQUIRE(r != nullptr);
+
+		if (!(r->cmd.flags & DNET_FLAGS_REPLY)) {
+			++control_sent;
+			return;
+		}
+
+		BOOST_REQUIRE_LT(r->cmd.trans, num_trans);
+		BOOST_REQUIRE_EQUAL(r->seq, sent[r->cmd.trans]);
+		++sent[r->cmd.trans];
+	};
+
+	size_t left = std::accumulate(total.begin(), total.end(), size_t(0));
+	while (left) {
+		const uint64_t trans = rand() % num_trans;
+		if (queued[trans] == total[trans])
+			continue;
+
+		const size_t seq = queued[trans]++;
+		const bool last = (seq + 1 == total[trans]);
+		size_t size;
+
+		if (last)
+			size = 0;
+		else if (rand() % 4 == 0)
+			size = DNET_NET_LANE_BULK_SIZE + rand() % (4 * DNET_NET_LANE_BULK_SIZE);
+		else
+			size = rand() % 4096;
+
+		queue.queue(DNET_CMD_READ, trans, DNET_FLAGS_REPLY | (last ? 0 : DNET_FLAGS_MORE), size, seq);
+		--left;
+
+		if (queue.state().send_streams_overflow)
+			++overflowed;
+
+		if (rand() % 8 == 0) {
+			queue.queue(DNET_CMD_STATUS, num_trans + control_queued, 0, 64, 0);
+			++control_queued;
+		}
+
+		if (rand() % 3 == 0)
+			send_one();
+	}
+
+	while (queue.queued())
+		send_one();
+
+	BOOST_REQUIRE(queue.send() == nullptr);
+	BOOST_REQUIRE_EQUAL(control_sent, control_queued);
+	for (size_t i = 0; i < num_trans; ++i)
+		BOOST_REQUIRE_EQUAL(sent[i], total[i]);
+
+	/* there were more live transactions than slots, so some replies went untracked */
+	BOOST_REQUIRE_GT(overflowed, 0);
+	BOOST_REQUIRE_EQUAL(queue.state().send_streams_overflow, 0);
+	for (size_t i = 0; i < DNET_SEND_STREAMS; ++i)
+		BOOST_REQUIRE_EQUAL(queue.state().send_streams[i].num, 0);
+}
+
+/*
+ * Fills small and bulk queues and checks that control command queued after them
+ * is sent as soon as the class being served runs out of its quantum.
+ */
+static void test_send_queue_control_not_starved()
+{
+	const size_t small_size = 4096;
+	const size_t bulk_size = 1024 * 1024;
+	/* the whole quantum of the small class plus one request of the bulk class */
+	const size_t max_before_control = (DNET_SEND_QUANTUM << (DNET_SEND_CLASS_BULK - DNET_SEND_CLASS_SMALL)) / small_size + 2;
+
+	send_queue queue;
+	uint64_t trans = 0;
+
+	for (int round = 0; round < 10; ++round) {
+		for (size_t i = 0; i < 1000; ++i) {
+			queue.queue(DNET_CMD_WRITE, trans++, 0, small_size, 0);
+			queue.queue(DNET_CMD_WRITE, trans++, 0, bulk_size, 0);
+		}
+
+		for (int i = rand() % 100; i > 0; --i)
+			BOOST_REQUIRE(queue.send() != nullptr);
+
+		request *control = queue.queue(DNET_CMD_STATUS, trans++, 0, 64, 0);
+
+		size_t before = 0;
+		request *r;
+		while ((r = queue.send()) != control) {
+			BOOST_REQUIRE(r != nullptr);
+			++before;
+		}
+
+		BOOST_REQUIRE_LE(before, max_before_control);
+	}
+
+	/* bulk class keeps moving too, one 1 MiB request takes 16 rounds of its 64 KiB quantum */
+	size_t bulk_sent = 0;
+	for (size_t i = 0; i < 1000; ++i) {
+		request *r = queue.send();
+		BOOST_REQUIRE(r != nullptr);
+		bulk_sent += (r->req.dsize == bulk_size);
+	}
+	BOOST_REQUIRE_GT(bulk_sent, 0);
+}
+
+bool register_tests(test_suite *suite)
+{
+	ELLIPTICS_TEST_CASE_NOARGS(test_send_queue_stream_order);
+	ELLIPTICS_TEST_CASE_NOARGS(test_send_queue_control_not_starved);
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return nullptr;
+	}
+
+	test_suite *suite = new ELLIPTICS_MAKE_TEST_SUITE("Send queue test suite");
+	register_tests(suite);
+
+	return suite;
+}
+
+} // namespace tests
+
+int main(int argc, char *argv[])
+{
+	srand(time(nullptr));
+	return unit_test_main(tests::register_tests, argc, argv);
+}
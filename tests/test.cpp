@@ -616,6 +616,73 @@ static void test_bulk_write(session &sess, size_t test_count)
 	}
 }
 
+/*
+ * One record of the batch fails compare-and-swap check, other records must be written anyway,
+ * while final acknowledgement of the batch must carry the error.
+ */
+static void test_bulk_write_error(session &sess, size_t test_count)
+{
+	const std::string failed_key = "bulk_write_error_cas";
+	const std::string failed_data = "bulk write error data";
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(failed_key, failed_data, 0));
+
+	std::vector<struct dnet_io_attr> ios;
+	std::vector<std::string> data;
+
+	for (size_t i = 0; i <= test_count; ++i) {
+		struct dnet_io_attr io;
+		struct dnet_id id;
+
+		std::ostringstream os;
+		if (i == test_count / 2)
+			os << failed_key;
+		else
+			os << "bulk_write_error" << i;
+
+		memset(&io, 0, sizeof(io));
+		memset(&id, 0, sizeof(id));
+
+		sess.transform(os.str(), id);
+		memcpy(io.id, id.id, DNET_ID_SIZE);
+		io.size = os.str().size();
+		io.timestamp.tsec = -1;
+		io.timestamp.tnsec = -1;
+
+		/* zero parent checksum does not match data stored under the key */
+		if (i == test_count / 2)
+			io.flags |= DNET_IO_FLAGS_COMPARE_AND_SWAP;
+
+		ios.push_back(io);
+		data.push_back(os.str());
+	}
+
+	session s = sess.clone();
+	s.set_checker(checkers::no_check);
+	s.set_filter(filters::all_with_ack);
+	s.set_exceptions_policy(session::no_exceptions);
+
+	sync_write_result result = s.bulk_write(ios, data).get();
+
+	size_t failed_acks = 0;
+	for (auto it = result.begin(); it != result.end(); ++it) {
+		if (it->is_ack() && it->command()->cmd == DNET_CMD_BULK_WRITE && it->status() != 0) {
+			BOOST_REQUIRE_EQUAL(it->status(), -EBADFD);
+			++failed_acks;
+		}
+	}
+
+	/* failed key gets into one batch per group */
+	BOOST_REQUIRE_EQUAL(failed_acks, sess.get_groups().size());
+
+	for (size_t i = 0; i <= test_count; ++i) {
+		const std::string expected = (i == test_count / 2) ? failed_data : data[i];
+
+		ELLIPTICS_REQUIRE(read_result, sess.read_data(data[i], 0, 0));
+		BOOST_REQUIRE_EQUAL(read_result.get_one().file().to_string(), expected);
+	}
+}
+
 static void test_bulk_read(session &sess, size_t test_count)
 {
 	std::vector<std::string> keys;
@@ -1500,6 +1567,9 @@ bool register_tests(test_suite *suite, node n)
 	ELLIPTICS_TEST_CASE(test_prepare_commit, create_session(n, {1, 2}, 0, 0), "prepare-commit-test-4", 1, 1);
 	ELLIPTICS_TEST_CASE(test_prepare_commit_simultaneously, create_session(n, {1, 2}, 0, 0));
 	ELLIPTICS_TEST_CASE(test_bulk_write, create_session(n, {1, 2}, 0, 0), 1000);
+	/* records of one backend are split into several BULK_WRITE batches */
+	ELLIPTICS_TEST_CASE(test_bulk_write, create_session(n, {1, 2}, 0, 0), 3 * 1024);
+	ELLIPTICS_TEST_CASE(test_bulk_write_error, create_session(n, {1, 2}, 0, 0), 100);
 	ELLIPTICS_TEST_CASE(test_bulk_read, create_session(n, {1, 2}, 0, 0), 1000);
 	ELLIPTICS_TEST_CASE(test_bulk_remove, create_session(n, {1, 2}, 0, 0), 1000);
 	ELLIPTICS_TEST_CASE(test_range_request, create_session(n, {2}, 0, 0), 0, 255, 2);
@@ -231,7 +231,8 @@ server_config server_config::default_value()
 			("blob_size", "10M")
 			("records_in_blob", 10000000)
 			("defrag_timeout", 3600)
-			("defrag_percentage", 25);
+			("defrag_percentage", 25)
+			("read_queue_depth", 64);
 	return data;
 }
 
@@ -730,6 +731,7 @@ start_nodes_config::start_nodes_config(std::ostream &debug_stream, const std::ve
 , client_node_flags(0)
 , client_wait_timeout(0)
 , client_stall_count(0)
+, client_net_lanes(0)
 {}
 
 nodes_data::ptr start_nodes(start_nodes_config &start_config) {
@@ -1012,6 +1014,7 @@ static void start_client_nodes(const start_nodes_config &start_config, const nod
 	config.wait_timeout = start_config.client_wait_timeout;
 	config.check_timeout = start_config.client_check_timeout;
 	config.stall_count = start_config.client_stall_count;
+	config.net_lanes = start_config.client_net_lanes;
 
 	data->node.reset(new node(logger(*data->logger, blackhole::log::attributes_t()), config));
 	for (size_t i = 0; i < remotes.size(); ++i) {
@@ -0,0 +1,200 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include <chrono>
+#include <vector>
+#include "test_base.hpp"
+#include "../library/timer_wheel.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+struct timer {
+	dnet_timer_wheel_entry	entry;
+	uint64_t		deadline;
+	bool			scheduled;
+	bool			fired;
+};
+
+/*
+ * Schedules and cancels timers with deadlines spread over all levels of the wheel
+ * (and beyond the last one) while time moves forward by random steps,
+ * checks that every timer fires not earlier than its deadline and not later than the first poll after it.
+ */
+static void test_timer_wheel_expire()
+{
+	const size_t num_timers = 10000;
+	const uint64_t start = 1000000;
+	std::vector<timer> timers(num_timers);
+	dnet_timer_wheel wheel;
+	uint64_t now = start;
+
+	dnet_timer_wheel_init(&wheel, now);
+
+	for (auto it = timers.begin(); it != timers.end(); ++it) {
+		dnet_timer_wheel_entry_init(&it->entry);
+
+		const int range = rand() % 5;
+		it->deadline = now + rand() % (1ULL << (range * 7));
+		it->scheduled = true;
+		it->fired = false;
+
+		dnet_timer_wheel_schedule(&wheel, &it->entry, it->deadline);
+	}
+
+	for (size_t i = 0; i < num_timers / 10; ++i) {
+		timer &t = timers[rand() % num_timers];
+		dnet_timer_wheel_cancel(&wheel, &t.entry);
+		BOOST_REQUIRE(!dnet_timer_wheel_entry_scheduled(&t.entry));
+		t.scheduled = false;
+	}
+
+	uint64_t prev = now - 1;
+	while (wheel.size) {
+		/* large jumps now and then let the idle parts of the wheel cascade at once */
+		now += (rand() % 16) ? rand() % 100 : rand() % (1 << 22);
+
+		dnet_timer_wheel_entry *e;
+		while ((e = dnet_timer_wheel_pop_expired(&wheel, now))) {
+			timer *t = reinterpret_cast<timer *>(reinterpret_cast<char *>(e) - offsetof(timer, entry));
+
+			BOOST_REQUIRE(t->scheduled);
+			BOOST_REQUIRE(!t->fired);
+			BOOST_REQUIRE_LE(t->deadline, now);
+			BOOST_REQUIRE_GT(t->deadline, prev);
+			t->fired = true;
+		}
+
+		for (auto it = timers.begin(); it != timers.end(); ++it) {
+			if (it->scheduled && !it->fired)
+				BOOST_REQUIRE_GT(it->deadline, now);
+		}
+
+		prev = now;
+	}
+
+	for (auto it = timers.begin(); it != timers.end(); ++it)
+		BOOST_REQUIRE_EQUAL(it->scheduled, it->fired);
+
+	BOOST_REQUIRE(dnet_timer_wheel_pop_any(&wheel) == NULL);
+}
+
+/*
+ * Entries which are not expired yet are still returned by dnet_timer_wheel_pop_any(),
+ * it is used to drain all transactions of the state being reset.
+ */
+static void test_timer_wheel_pop_any()
+{
+	const size_t num_timers = 1000;
+	std::vector<dnet_timer_wheel_entry> entries(num_timers);
+	dnet_timer_wheel wheel;
+
+	dnet_timer_wheel_init(&wheel, 0);
+
+	for (size_t i = 0; i < num_timers; ++i) {
+		dnet_timer_wheel_entry_init(&entries[i]);
+		dnet_timer_wheel_schedule(&wheel, &entries[i], i * i * 100);
+	}
+
+	size_t popped = 0;
+	while (dnet_timer_wheel_pop_any(&wheel))
+		++popped;
+
+	BOOST_REQUIRE_EQUAL(popped, num_timers);
+	BOOST_REQUIRE_EQUAL(wheel.size, 0);
+
+	for (size_t i = 0; i < num_timers; ++i)
+		BOOST_REQUIRE(!dnet_timer_wheel_entry_scheduled(&entries[i]));
+}
+
+/*
+ * Microbenchmark: schedule + cancel pairs per second, the way transactions arm and disarm their timeouts,
+ * result is printed as test message.
+ */
+static void test_timer_wheel_benchmark()
+{
+	const size_t num_entries = 1 << 16;
+	const size_t num_iter = 4000000;
+	std::vector<dnet_timer_wheel_entry> entries(num_entries);
+	dnet_timer_wheel wheel;
+
+	dnet_timer_wheel_init(&wheel, 0);
+
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		dnet_timer_wheel_entry_init(&*it);
+		dnet_timer_wheel_schedule(&wheel, &*it, rand() % 60000);
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < num_iter; ++i) {
+		dnet_timer_wheel_entry *e = &entries[i & (num_entries - 1)];
+		dnet_timer_wheel_cancel(&wheel, e);
+		dnet_timer_wheel_schedule(&wheel, e, (i * 7919) % 60000);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	BOOST_REQUIRE_EQUAL(wheel.size, num_entries);
+	BOOST_TEST_MESSAGE("timers: " << num_entries
+			<< ", cancel + schedule: " << static_cast<uint64_t>(num_iter / elapsed.count()) << " ops/s");
+}
+
+bool register_tests(test_suite *suite)
+{
+	ELLIPTICS_TEST_CASE_NOARGS(test_timer_wheel_expire);
+	ELLIPTICS_TEST_CASE_NOARGS(test_timer_wheel_pop_any);
+	ELLIPTICS_TEST_CASE_NOARGS(test_timer_wheel_benchmark);
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return nullptr;
+	}
+
+	test_suite *suite = new ELLIPTICS_MAKE_TEST_SUITE("Timer wheel test suite");
+	register_tests(suite);
+
+	return suite;
+}
+
+} // namespace tests
+
+int main(int argc, char *argv[])
+{
+	srand(time(nullptr));
+	return unit_test_main(tests::register_tests, argc, argv);
+}
@@ -0,0 +1,262 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "test_base.hpp"
+#include "../library/elliptics.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+/* trans table of the state without network behind it, contents are mirrored in the reference set */
+class trans_table {
+public:
+	trans_table() {
+		memset(&m_st, 0, sizeof(m_st));
+		dnet_timer_wheel_init(&m_st.timer_wheel, 0);
+	}
+
+	~trans_table() {
+		dnet_trans_table_destroy(&m_st.trans_table);
+	}
+
+	void insert(uint64_t trans) {
+		m_trans.emplace_back(new dnet_trans);
+		dnet_trans *t = m_trans.back().get();
+
+		memset(t, 0, sizeof(dnet_trans));
+		t->trans = trans;
+		atomic_init(&t->refcnt, 1);
+		INIT_LIST_HEAD(&t->trans_list_entry);
+		dnet_timer_wheel_entry_init(&t->timer_entry);
+
+		BOOST_REQUIRE_EQUAL(dnet_trans_insert_nolock(&m_st, t), 0);
+		BOOST_REQUIRE(t->hashed);
+		m_ref[trans] = std::make_pair(t, m_keys.size());
+		m_keys.push_back(trans);
+	}
+
+	/* inserts another transaction with the number already in the table */
+	void insert_existing(uint64_t trans) {
+		dnet_trans t;
+
+		memset(&t, 0, sizeof(dnet_trans));
+		t.trans = trans;
+
+		BOOST_REQUIRE_EQUAL(dnet_trans_insert_nolock(&m_st, &t), -EEXIST);
+		BOOST_REQUIRE(!t.hashed);
+	}
+
+	void remove(uint64_t trans) {
+		auto it = m_ref.find(trans);
+		dnet_trans *t = it->second.first;
+		const size_t idx = it->second.second;
+
+		dnet_trans_remove_nolock(&m_st, t);
+		BOOST_REQUIRE(!t->hashed);
+
+		m_keys[idx] = m_keys.back();
+		m_ref[m_keys[idx]].second = idx;
+		m_keys.pop_back();
+		m_ref.erase(it);
+	}
+
+	/* searches @trans and checks that result matches the reference */
+	void search(uint64_t trans) {
+		auto it = m_ref.find(trans);
+		dnet_trans *t = dnet_trans_search(&m_st, trans);
+
+		if (it == m_ref.end()) {
+			BOOST_REQUIRE(t == NULL);
+			return;
+		}
+
+		BOOST_REQUIRE(t == it->second.first);
+		BOOST_REQUIRE_EQUAL(atomic_read(&t->refcnt), 2);
+		atomic_dec(&t->refcnt);
+	}
+
+	/*
+	 * Checks the table layout: it holds exactly the reference transactions, it is not more than half full
+	 * and every slot between home slot of transaction and its slot is occupied.
+	 * Returns number of transactions whose probe run wraps around the end of the table.
+	 */
+	size_t check() const {
+		const dnet_trans_table &table = m_st.trans_table;
+		size_t num = 0, wrapped = 0;
+
+		BOOST_REQUIRE_EQUAL(table.size, m_ref.size());
+		if (!table.slots)
+			return 0;
+
+		BOOST_REQUIRE_LE(table.size * 2, table.mask + 1);
+		BOOST_REQUIRE(table.mask + 1 == DNET_TRANS_TABLE_MIN_SIZE || table.size * 8 >= table.mask + 1);
+
+		for (size_t pos = 0; pos <= table.mask; ++pos) {
+			dnet_trans *t = table.slots[pos];
+			if (!t)
+				continue;
+
+			auto it = m_ref.find(t->trans);
+			BOOST_REQUIRE(it != m_ref.end());
+			BOOST_REQUIRE(it->second.first == t);
+			++num;
+
+			const size_t home = dnet_trans_hash(t->trans, table.mask);
+			for (size_t i = home; i != pos; i = (i + 1) & table.mask)
+				BOOST_REQUIRE(table.slots[i] != NULL);
+
+			if (pos < home)
+				++wrapped;
+		}
+
+		BOOST_REQUIRE_EQUAL(num, m_ref.size());
+		return wrapped;
+	}
+
+	size_t slots() const {
+		return m_st.trans_table.slots ? m_st.trans_table.mask + 1 : 0;
+	}
+
+	size_t size() const {
+		return m_keys.size();
+	}
+
+	bool contains(uint64_t trans) const {
+		return m_ref.count(trans) != 0;
+	}
+
+	uint64_t random_key() const {
+		return m_keys[rand() % m_keys.size()];
+	}
+
+private:
+	typedef std::pair<dnet_trans *, size_t> ref_entry;
+
+	dnet_net_state					m_st;
+	std::vector<std::unique_ptr<dnet_trans>>	m_trans;
+	/* transaction and its index in @m_keys */
+	std::unordered_map<uint64_t, ref_entry>	m_ref;
+	std::vector<uint64_t>				m_keys;
+};
+
+static uint64_t random_trans()
+{
+	return ((uint64_t)rand() << 32) ^ (uint64_t)rand();
+}
+
+/*
+ * Grows the table to several thousands of transactions and shrinks it back a few times,
+ * inserting, searching and removing transactions at random. Transaction numbers are both random
+ * and taken with a stride, as they come from the node-wide counter.
+ * Table is compared against the reference set as it changes.
+ */
+static void test_trans_table_random()
+{
+	const size_t max_size = 5000;
+	const int cycles = 4;
+
+	trans_table table;
+	uint64_t counter = 0;
+	size_t wrapped = 0, max_slots = 0;
+
+	for (int cycle = 0; cycle < cycles; ++cycle) {
+		/* grow phase mostly inserts transactions, shrink phase mostly removes them */
+		for (int grow = 1; grow >= 0; --grow) {
+			while (grow ? table.size() < max_size : table.size()) {
+				const int op = rand() % 8;
+
+				if (!table.size() || op < (grow ? 6 : 2)) {
+					uint64_t trans;
+
+					do {
+						trans = (rand() % 2) ? random_trans() : (counter += 1 + rand() % 16);
+					} while (table.contains(trans));
+
+					table.insert(trans);
+				} else if (op == 6) {
+					table.search(table.random_key());
+					table.search(random_trans());
+					table.insert_existing(table.random_key());
+				} else {
+					table.remove(table.random_key());
+				}
+
+				if (table.slots() > max_slots)
+					max_slots = table.slots();
+
+				if (table.size() % 64 == 0 || table.size() < 64)
+					wrapped += table.check();
+			}
+
+			wrapped += table.check();
+		}
+
+		/* table shrinks back as transactions are removed */
+		BOOST_REQUIRE_EQUAL(table.slots(), DNET_TRANS_TABLE_MIN_SIZE);
+	}
+
+	BOOST_REQUIRE_GE(max_slots, max_size * 2);
+	BOOST_REQUIRE_GT(wrapped, 0);
+}
+
+bool register_tests(test_suite *suite)
+{
+	ELLIPTICS_TEST_CASE_NOARGS(test_trans_table_random);
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return nullptr;
+	}
+
+	test_suite *suite = new ELLIPTICS_MAKE_TEST_SUITE("Transaction table test suite");
+	register_tests(suite);
+
+	return suite;
+}
+
+} // namespace tests
+
+int main(int argc, char *argv[])
+{
+	srand(time(nullptr));
+	return unit_test_main(tests::register_tests, argc, argv);
+}